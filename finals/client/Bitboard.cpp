@@ -0,0 +1,138 @@
+#include "Bitboard.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+Bitboard::Row Bitboard::Span(int x0, int x1) {
+	x0 = std::max(x0, 0);
+	x1 = std::min(x1, MaxSide - 1);
+	if (x0 > x1) {
+		return 0;
+	}
+	Row upto = x1 == MaxSide - 1 ? ~Row(0) : (Row(1) << (x1 + 1)) - 1;
+	return upto & ~((Row(1) << x0) - 1);
+}
+
+int Bitboard::LowestBit(Row bits) {
+	assert(bits != 0);
+#if defined(__GNUC__)
+	return __builtin_ctzll(bits);
+#else
+	int x = 0;
+	while (!(bits & 1)) {
+		bits >>= 1;
+		++x;
+	}
+	return x;
+#endif
+}
+
+Bitboard& Bitboard::operator&=(const Bitboard& o) {
+	for (int y = 0; y < MaxSide; ++y) {
+		mRows[y] &= o.mRows[y];
+	}
+	return *this;
+}
+
+Bitboard& Bitboard::operator|=(const Bitboard& o) {
+	for (int y = 0; y < MaxSide; ++y) {
+		mRows[y] |= o.mRows[y];
+	}
+	return *this;
+}
+
+Bitboard& Bitboard::AndNot(const Bitboard& o) {
+	for (int y = 0; y < MaxSide; ++y) {
+		mRows[y] &= ~o.mRows[y];
+	}
+	return *this;
+}
+
+bool Bitboard::Any() const {
+	Row any = 0;
+	for (int y = 0; y < MaxSide; ++y) {
+		any |= mRows[y];
+	}
+	return any != 0;
+}
+
+int Bitboard::Count() const {
+	int count = 0;
+	for (int y = 0; y < MaxSide; ++y) {
+		count += static_cast<int>(std::bitset<MaxSide>(mRows[y]).count());
+	}
+	return count;
+}
+
+bool RangeMasks::InGrownCircle(int dx, int dy, int rangeSq) {
+	// the nearest cell of the 3x3 block around the offset
+	int nx = std::max(std::abs(dx) - 1, 0);
+	int ny = std::max(std::abs(dy) - 1, 0);
+	return nx * nx + ny * ny <= rangeSq;
+}
+
+RangeMasks::RangeMasks(int rangeSq, int width, int height) :
+	mRangeSq(rangeSq), mWidth(width), mHeight(height)
+{
+	assert(rangeSq >= 0 && Bitboard::Fits(width, height));
+	mReach = static_cast<int>(std::sqrt(double(rangeSq))) + 1;
+	int span = 2 * mReach + 1;
+	mRows.assign(std::size_t(width) * span, 0);
+	for (int x = 0; x < width; ++x) {
+		for (int dy = -mReach; dy <= mReach; ++dy) {
+			auto& row = mRows[x * span + dy + mReach];
+			for (int dx = -mReach; dx <= mReach; ++dx) {
+				if (x + dx >= 0 && x + dx < width && InGrownCircle(dx, dy, rangeSq)) {
+					row |= Bitboard::Row(1) << (x + dx);
+				}
+			}
+		}
+	}
+}
+
+Bitboard::Row RangeMasks::GetRow(const Position& center, int y) const {
+	int dy = y - center.y;
+	if (y < 0 || y >= mHeight || dy < -mReach || dy > mReach ||
+		center.x < 0 || center.x >= mWidth)
+	{
+		return 0;
+	}
+	return mRows[center.x * (2 * mReach + 1) + dy + mReach];
+}
+
+bool RangeMasks::Contains(const Position& center, const Position& pos) const {
+	if (pos.x < 0 || pos.x >= mWidth) {
+		return false;
+	}
+	return (GetRow(center, pos.y) >> pos.x) & 1;
+}
+
+bool RangeMasks::Intersects(const Position& center, const Bitboard& board) const {
+	int y0 = std::max(center.y - mReach, 0);
+	int y1 = std::min(center.y + mReach, LastRow());
+	for (int y = y0; y <= y1; ++y) {
+		if (GetRow(center, y) & board.GetRow(y)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int RangeMasks::Count(const Position& center, const Bitboard& board) const {
+	int y0 = std::max(center.y - mReach, 0);
+	int y1 = std::min(center.y + mReach, LastRow());
+	int count = 0;
+	for (int y = y0; y <= y1; ++y) {
+		count += static_cast<int>(std::bitset<Bitboard::MaxSide>(
+			GetRow(center, y) & board.GetRow(y)).count());
+	}
+	return count;
+}
+
+void RangeMasks::OrInto(Bitboard& board, const Position& center) const {
+	int y0 = std::max(center.y - mReach, 0);
+	int y1 = std::min(center.y + mReach, LastRow());
+	for (int y = y0; y <= y1; ++y) {
+		board.GetRow(y) |= GetRow(center, y);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "Position.h"
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <vector>
+#include <cstdint>
+
+// One bit per cell of the arena: bit x of row y, rows in y order. Set-style
+// questions ("is any enemy minion in range", "which neighbours are
+// walkable") become AND/OR over a handful of words. Arenas up to 64x64 fit,
+// the game's is 39x39.
+class Bitboard {
+public:
+	static const int MaxSide = 64;
+	using Row = std::uint64_t;
+
+	Bitboard() { Clear(); }
+
+	static bool Fits(int width, int height) {
+		return width > 0 && height > 0 && width <= MaxSide && height <= MaxSide;
+	}
+	static bool Inside(const Position& pos) {
+		return pos.x >= 0 && pos.x < MaxSide && pos.y >= 0 && pos.y < MaxSide;
+	}
+	// bits x0..x1 of a row, clipped to the board
+	static Row Span(int x0, int x1);
+	// index of the lowest set bit, bits must not be 0
+	static int LowestBit(Row bits);
+
+	void Clear() { mRows.fill(0); }
+	void Set(const Position& pos) { mRows[pos.y] |= Row(1) << pos.x; }
+	bool Test(const Position& pos) const { return (mRows[pos.y] >> pos.x) & 1; }
+	Row GetRow(int y) const { return mRows[y]; }
+	Row& GetRow(int y) { return mRows[y]; }
+
+	Bitboard& operator&=(const Bitboard& o);
+	Bitboard& operator|=(const Bitboard& o);
+	Bitboard& AndNot(const Bitboard& o); // clears the cells set in o
+	bool Any() const;
+	int Count() const;
+
+private:
+	std::array<Row, MaxSide> mRows;
+};
+
+inline Bitboard operator&(Bitboard lhs, const Bitboard& rhs) { return lhs &= rhs; }
+inline Bitboard operator|(Bitboard lhs, const Bitboard& rhs) { return lhs |= rhs; }
+
+// The cells an attack of rangeSq reaches from every center, grown by one
+// step: exactly what Hypno::IsNeighbourOfCircle accepts. The shape only
+// depends on the offset, so rows are kept per column and row offset and
+// clipped to the arena width; a center's mask is Reach() rows either side.
+class RangeMasks {
+public:
+	RangeMasks() = default;
+	RangeMasks(int rangeSq, int width, int height);
+
+	int GetRangeSq() const { return mRangeSq; }
+	int Reach() const { return mReach; }
+
+	// row y of the mask around center; 0 outside the arena or the reach
+	Bitboard::Row GetRow(const Position& center, int y) const;
+	bool Contains(const Position& center, const Position& pos) const;
+	bool Intersects(const Position& center, const Bitboard& board) const;
+	int Count(const Position& center, const Bitboard& board) const;
+	void OrInto(Bitboard& board, const Position& center) const;
+
+	// pos is within rangeSq of center, or one step from a cell that is
+	static bool InGrownCircle(int dx, int dy, int rangeSq);
+
+private:
+	int mRangeSq = 0;
+	int mReach = 0;
+	int mWidth = 0;
+	int mHeight = 0;
+	std::vector<Bitboard::Row> mRows; // [x][dy + reach]
+
+	// the rows of both the arena and the board
+	int LastRow() const { return std::min(mHeight, Bitboard::MaxSide) - 1; }
+};
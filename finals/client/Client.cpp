@@ -1,10 +1,90 @@
 #include "Client.h"
 #include "stdafx.h"
-#include <sstream>
+#include "alloctrack.h"
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/tcp.h>
 
 #define SERVER_PORT 4242
+#define CONNECT_TIMEOUT_MS 1000
+#define RECONNECT_DELAY_US 1000000
+
+void TICK_TIMING::Reset()
+{
+	ticks = slow_ticks = late_ticks = baseline_heroes = 0;
+	total_us_sum = total_us_max = 0;
+	io_us_sum = io_us_max = 0;
+}
+
+void TICK_TIMING::Add(int tick, int64_t total_us, int64_t io_us)
+{
+	ticks++;
+	if (io_us>IO_BUDGET_US)
+	{
+		if (slow_ticks == 0)
+		{
+			std::cout << "WARNING tick " << tick << " io overhead " << io_us << "us" << std::endl;
+		}
+		slow_ticks++;
+	}
+	total_us_sum += total_us;
+	io_us_sum += io_us;
+	if (total_us>total_us_max) total_us_max = total_us;
+	if (io_us>io_us_max) io_us_max = io_us;
+}
+
+void TICK_TIMING::AddLate(int tick, int heroes_on_baseline, int heroes)
+{
+	if (late_ticks == 0)
+	{
+		std::cout << "WARNING tick " << tick << " past deadline, "
+			<< heroes_on_baseline << " of " << heroes << " heroes on baseline" << std::endl;
+	}
+	late_ticks++;
+	baseline_heroes += heroes_on_baseline;
+}
+
+void TICK_TIMING::Print(std::ostream &os) const
+{
+	if (ticks == 0) return;
+	os << "tick latency: " << ticks << " ticks, total avg " << total_us_sum / ticks
+		<< "us max " << total_us_max << "us, io avg " << io_us_sum / ticks
+		<< "us max " << io_us_max << "us, " << slow_ticks << " ticks over "
+		<< IO_BUDGET_US << "us io, " << late_ticks << " past deadline with "
+		<< baseline_heroes << " heroes on baseline" << std::endl;
+}
+
+void TICK_ALLOCATIONS::Reset()
+{
+	ticks = allocating_ticks = 0;
+	allocations = 0;
+}
+
+void TICK_ALLOCATIONS::Add(int tick, uint64_t count)
+{
+	ticks++;
+	if (count == 0) return;
+	if (allocating_ticks == 0)
+	{
+		std::cout << "WARNING tick " << tick << " allocated " << count << " times" << std::endl;
+	}
+	allocating_ticks++;
+	allocations += count;
+}
+
+void TICK_ALLOCATIONS::Print(std::ostream &os) const
+{
+	if (ticks == 0) return;
+	os << "tick allocations: " << allocations << " in " << allocating_ticks
+		<< " of " << ticks << " steady state ticks" << std::endl;
+}
+
+static int64_t MicrosecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
 
 CLIENT::CLIENT()
 {
@@ -13,7 +93,20 @@ CLIENT::CLIENT()
 #else
 	mConnectionSocket = -1;
 #endif
-	mDistCache.LoadFromFile("distcache.bin");
+	mLoop = NULL;
+	mReconnectTimer = -1;
+	mConnectTimer = -1;
+	mConnecting = false;
+	mMatchTicks = 0;
+	mTickBudgetUs = DEFAULT_TICK_BUDGET_US;
+	mDebugLogFormat = ASYNC_LOG::FORMAT_TEXT;
+	mSlot = 1;
+	mStageParse = mLatency.AddStage("parse");
+	mStageProcess = mLatency.AddStage("process");
+	mStageSerialize = mLatency.AddStage("serialize");
+	mStageSend = mLatency.AddStage("send");
+	mDistCache = std::make_shared<DISTCACHE>(); // until the map arrives
+	mCommands.reserve(UNIT_TABLE::FIXED_ID_LIMIT);
 }
 
 CLIENT::~CLIENT()
@@ -62,29 +155,64 @@ bool CLIENT::Init()
 	ServerSocketAddress.sin_addr.s_addr = addr;
 	ServerSocketAddress.sin_family = AF_INET;
 	ServerSocketAddress.sin_port = htons( SERVER_PORT );
-	mConnectionSocket = socket( AF_INET, SOCK_STREAM, 0 );
-#ifdef WIN32
-	if( mConnectionSocket == INVALID_SOCKET )
-#else
+	mConnectionSocket = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
 	if (mConnectionSocket == -1 )
-#endif
 	{
 		std::cout << "Error: Cannot open a socket!" << std::endl;
 		return false;
 	}
+	mConnecting = false;
 	if ( connect( mConnectionSocket,(struct sockaddr*)&ServerSocketAddress, sizeof( ServerSocketAddress ) ) )
 	{
-		std::cout << "Error: Cannot connect to " << strIPAddress << "!" << std::endl;
-#ifdef WIN32
-		closesocket( mConnectionSocket );
-#else
-		close( mConnectionSocket );
-#endif
-		return false;
+		if (errno != EINPROGRESS)
+		{
+			std::cout << "Error: Cannot connect to " << strIPAddress << "!" << std::endl;
+			close( mConnectionSocket );
+			mConnectionSocket = -1;
+			return false;
+		}
+		// finished by the loop once the socket turns writable, see Connect
+		mConnecting = true;
+		return true;
 	}
+	Login();
+	return true;
+}
+
+void CLIENT::Login()
+{
+	int nodelay = 1;
+	setsockopt(mConnectionSocket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+	mSendQueue.clear();
 	SendMessage("login " + GetPassword()+" "+GetPreferredOpponents());
 	bReceivedFirstPing = false;
-	return true;
+}
+
+void CLIENT::FinishConnect(int connect_error)
+{
+	mConnecting = false;
+	if (mConnectTimer != -1)
+	{
+		mLoop->CancelTimer(mConnectTimer);
+		mConnectTimer = -1;
+	}
+	if (connect_error == 0)
+	{
+		socklen_t len = sizeof(connect_error);
+		getsockopt(mConnectionSocket, SOL_SOCKET, SO_ERROR, &connect_error, &len);
+	}
+	if (connect_error)
+	{
+		std::cout << "Error: Cannot connect to " << strIPAddress << "!" << std::endl;
+		mLoop->Remove(mConnectionSocket);
+		close( mConnectionSocket );
+		mConnectionSocket = -1;
+		ScheduleReconnect(RECONNECT_DELAY_US);
+		return;
+	}
+	Login();
+	if (LinkDead()) return;
+	mLoop->Modify(mConnectionSocket, EVENTLOOP::READABLE | (mSendQueue.empty() ? 0 : EVENTLOOP::WRITABLE));
 }
 
 void CLIENT::ConnectionClosed()
@@ -99,32 +227,66 @@ void CLIENT::ConnectionClosed()
 
 void CLIENT::SendMessage( std::string aMessage )
 {
-	if (LinkDead()) return;
 	if (aMessage.length()==0) return;
 	if (aMessage[aMessage.length()-1]!='\n') aMessage+="\n";
-	if (NeedDebugLog() && mDebugLog.is_open())
+	SendBytes(aMessage.data(), aMessage.size());
+}
+
+void CLIENT::SendBytes(const char *data, size_t length)
+{
+	if (LinkDead()) return;
+	if (NeedDebugLog() && mDebugLog.IsOpen())
 	{
-		mDebugLog<<"Sent: "<<aMessage;
+		mDebugLog.WriteSent(data, length);
 	}
-	int SentBytes = send( mConnectionSocket, aMessage.c_str(), int(aMessage.size()), 0 );
-	if (SentBytes!=aMessage.size())
+	if (!mSendQueue.empty())
 	{
-#ifdef WIN32
-		closesocket( mConnectionSocket );
-#else
-		close( mConnectionSocket );
-#endif
-		ConnectionClosed();
+		// keep the ordering, the loop flushes when the socket is writable
+		mSendQueue.append(data, length);
+		return;
+	}
+	ssize_t SentBytes = send( mConnectionSocket, data, length, MSG_NOSIGNAL );
+	if (SentBytes == (ssize_t)length) return;
+	if (SentBytes<0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+		CloseConnection();
+		return;
+	}
+	size_t sent = SentBytes>0 ? (size_t)SentBytes : 0;
+	mSendQueue.assign(data + sent, length - sent);
+	if (mLoop)
+	{
+		mLoop->Modify(mConnectionSocket, EVENTLOOP::READABLE | EVENTLOOP::WRITABLE);
+	}
+}
+
+void CLIENT::FlushSendQueue()
+{
+	while (!mSendQueue.empty())
+	{
+		ssize_t SentBytes = send( mConnectionSocket, mSendQueue.data(), mSendQueue.size(), MSG_NOSIGNAL );
+		if (SentBytes<0)
+		{
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+			CloseConnection();
+			return;
+		}
+		mSendQueue.erase(0, SentBytes);
+	}
+	if (mLoop)
+	{
+		mLoop->Modify(mConnectionSocket, EVENTLOOP::READABLE);
 	}
 }
 
-void SavePacket(std::vector<std::string> &Lines, const char *filename)
+void SavePacket(const std::vector<LINE_VIEW> &Lines, const char *filename)
 {
 	std::ofstream f;
 	f.open(filename, std::ofstream::trunc);
 	if (f.is_open())
 	{
-		for (std::vector<std::string>::const_iterator it = Lines.begin();
+		for (std::vector<LINE_VIEW>::const_iterator it = Lines.begin();
 			it != Lines.end(); ++it)
 		{
 			f << *it << std::endl;
@@ -133,153 +295,213 @@ void SavePacket(std::vector<std::string> &Lines, const char *filename)
 	}
 }
 
-bool LoadPacket(const char *filename, std::vector<std::string> &Lines)
+void CLIENT::CloseConnection()
 {
-	std::ifstream debug_file(filename);
-	if (debug_file.is_open())
+	if (LinkDead()) return;
+	if (mLoop)
 	{
-		std::string line;
-		while (std::getline(debug_file, line))
-		{
-			Lines.push_back(line);
-		}
-		debug_file.close();
-		return true;
+		mLoop->Remove(mConnectionSocket);
 	}
-	return false;
+	close( mConnectionSocket );
+	ConnectionClosed();
+	// reconnect from the loop, never from inside a socket handler
+	if (mLoop) ScheduleReconnect(0);
 }
 
-void CLIENT::Run()
+void CLIENT::ScheduleReconnect(int64_t delay_us)
 {
-	if (NeedDebugLog())
+	// a failed login of a connect that completed at once closes the
+	// connection inside Connect, which then must not arm a second timer
+	if (mReconnectTimer != -1) return;
+	mReconnectTimer = mLoop->AddTimer(delay_us, 0, [this]() { mReconnectTimer = -1; Connect(); });
+}
+
+void CLIENT::Connect()
+{
+	if (LinkDead())
 	{
-		mDebugLog.open("debug.log", std::ofstream::out | std::ofstream::app
-#ifdef WIN32
-		, SH_DENYWR
-#endif
-		);
+		mFramer.Reset();
+		Init();
 	}
+	if (LinkDead())
+	{
+		ScheduleReconnect(RECONNECT_DELAY_US);
+		return;
+	}
+	if (mConnecting)
+	{
+		// the other clients of the loop keep playing while this one waits
+		mLoop->Add(mConnectionSocket, EVENTLOOP::WRITABLE, [this](int ready) { OnSocketEvent(ready); });
+		mConnectTimer = mLoop->AddTimer(CONNECT_TIMEOUT_MS*1000, 0, [this]() { mConnectTimer = -1; FinishConnect(ETIMEDOUT); });
+		return;
+	}
+	int events = EVENTLOOP::READABLE;
+	if (!mSendQueue.empty()) events |= EVENTLOOP::WRITABLE;
+	mLoop->Add(mConnectionSocket, events, [this](int ready) { OnSocketEvent(ready); });
+}
 
-	std::string strLastLineRemaining;
-	std::vector<std::string> LastServerResponse;
+void CLIENT::Attach(EVENTLOOP &loop)
+{
+	const char *log_name = !mDebugLogFile.empty() ? mDebugLogFile.c_str() :
+		mDebugLogFormat == ASYNC_LOG::FORMAT_REPLAY ? "replay.bin" : "debug.log";
+	if (NeedDebugLog() && !mDebugLog.IsOpen() && !mDebugLog.Open(log_name, mDebugLogFormat))
+	{
+		std::cout << "WARNING cannot open " << log_name << std::endl;
+	}
+	mLoop = &loop;
+	Connect();
+}
+
+void CLIENT::UpdateDistCache(bool save_built)
+{
+	if (!mDistCache->IsValidFor(mParser))
+	{
+		// missing, or built for another map.txt
+		mDistCache = DISTCACHE::GetShared(mParser, "distcache.bin", save_built);
+	}
+}
 
+void CLIENT::Run()
+{
+	EVENTLOOP loop;
+	Attach(loop);
+	loop.Run();
+	mLoop = NULL;
+}
+
+void CLIENT::OnSocketEvent(int events)
+{
+	if (mConnecting)
+	{
+		// writable once connected, an error shows up as readable
+		FinishConnect(0);
+		return;
+	}
+	if (events & EVENTLOOP::WRITABLE)
+	{
+		FlushSendQueue();
+		if (LinkDead()) return;
+	}
+	if (!(events & EVENTLOOP::READABLE)) return;
 	for(;;)
 	{
-		if (LinkDead())
+		size_t free;
+		char *buffer = mFramer.GetWriteBuffer(4096, free);
+		ssize_t ReceivedBytesCount = recv( mConnectionSocket, buffer, free, 0 );
+		if (ReceivedBytesCount>0)
 		{
-			LastServerResponse.clear();
-			strLastLineRemaining = "";
-			Init();
-		}
-		if (LinkDead())
-		{
-#ifdef WIN32
-			Sleep(1000);
-#else
-			sleep(1);
-#endif
+			mFrameReadyTime = CLOCK::now();
+			mFramer.CommitWrite(ReceivedBytesCount);
+			ProcessReceivedLines();
+			if (LinkDead()) return;
 			continue;
 		}
-		const size_t ReceiveBufferSize = 1<<16;
-		char ReceiveBuffer[ ReceiveBufferSize+1 ] = {0};
+		if (ReceivedBytesCount<0 && errno == EINTR) continue;
+		if (ReceivedBytesCount<0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		// connection is closed or failed
+		CloseConnection();
+		return;
+	}
+}
+
+static std::vector<std::string> ToStrings(const std::vector<LINE_VIEW> &Lines)
+{
+	std::vector<std::string> result;
+	for (std::vector<LINE_VIEW>::const_iterator it = Lines.begin(); it != Lines.end(); ++it)
+	{
+		result.push_back(it->to_string());
+	}
+	return result;
+}
 
-		int ReceivedBytesCount = recv( mConnectionSocket, ReceiveBuffer, ReceiveBufferSize, 0 );
+void CLIENT::ProcessReceivedLines()
+{
+	LINE_VIEW line;
+	while (mFramer.NextLine(line))
+	{
+		ProcessLine(line);
+		if (LinkDead()) return;
+	}
+}
 
-		if( ReceivedBytesCount == 0 || ReceivedBytesCount == -1)
+void CLIENT::ProcessLine(const LINE_VIEW &alma)
+{
+	if (alma.empty())
+	{
+	} else
+	if (alma=="fail")
+	{
+		std::cout<<"Login failed :("<<std::endl;
+	} else
+	if (alma == "fail-reconnect")
+	{
+		std::cout << "Login failed, too many connections" << std::endl;
+	}
+	else
+	if (alma=="ping")
+	{
+		SendMessage(std::string("pong"));
+		if (!bReceivedFirstPing)
 		{
-			// connection is closed or failed
-#ifdef WIN32
-			closesocket( mConnectionSocket );
-#else
-			close( mConnectionSocket );
-#endif
-			ConnectionClosed();
-			continue;
+			std::cout<<"Login OK"<<std::endl;
+			bReceivedFirstPing = true;
+		} else
+		{
+			time_t tt;
+			time(&tt);
+			struct tm *tm = localtime(&tt);
+			char str[20];
+			sprintf(str, "%02d:%02d:%02d", tm->tm_hour, tm->tm_min, tm->tm_sec);
+			std::cout<<"PING "<<str<<std::endl;
 		}
-		ReceiveBuffer[ReceivedBytesCount]=0;
-		char *line_start = ReceiveBuffer;
-		for(;;)
+	} else if (alma[0]=='w' && alma.starts_with("warning"))
+	{
+		std::cout << "WARNING " << alma.substr(std::min<size_t>(8, alma.size())) << std::endl;
+	} else
+	{
+		mFramer.PushFrameLine(alma);
+		if (alma==".")
 		{
-			char *s = strchr(line_start, '\n');
-			if (!s)
+			const std::vector<LINE_VIEW> &LastServerResponse = mFramer.GetFrame();
+			if (LastServerResponse.front().starts_with("players"))
 			{
-				strLastLineRemaining = line_start;
-				break;
+				mParser.ParsePlayers(ToStrings(LastServerResponse));
+				SavePacket(LastServerResponse, "players.txt");
 			} else
+			if (LastServerResponse.front().starts_with("map"))
 			{
-				std::string alma=strLastLineRemaining;
-				*s=0;
-				alma+=line_start;
-				line_start = s+1;
-				strLastLineRemaining = "";
-				if (alma.empty())
-				{
-				} else
-				if (alma=="fail")
-				{
-					std::cout<<"Login failed :("<<std::endl;
-				} else
-				if (alma == "fail-reconnect")
+				mParser.ParseMap(ToStrings(LastServerResponse));
+				SavePacket(LastServerResponse, "map.txt");
+				UpdateDistCache(true);
+			} else
+			{
+				if (NeedDebugLog() && mDebugLog.IsOpen())
 				{
-					std::cout << "Login failed, too many connections" << std::endl;
+					mDebugLog.WriteLines(LastServerResponse);
 				}
-				else
-				if (alma=="ping")
+				CLOCK::time_point handle_start = CLOCK::now();
+				HandleServerResponse(LastServerResponse);
+				CLOCK::time_point handle_end = CLOCK::now();
+				if (mResponse.Size()>0)
 				{
-					SendMessage(std::string("pong"));
-					if (!bReceivedFirstPing)
-					{
-						std::cout<<"Login OK"<<std::endl;
-						bReceivedFirstPing = true;
-					} else
-					{
-						time_t tt;
-						time(&tt);
-						struct tm *tm = localtime(&tt);
-						char str[20];
-						sprintf(str, "%02d:%02d:%02d", tm->tm_hour, tm->tm_min, tm->tm_sec);
-						std::cout<<"PING "<<str<<std::endl;
-					}
-				} else if (alma[0]=='w' && alma.substr(0, 7)=="warning")
-				{
-					std::cout << "WARNING " << alma.substr(8) << std::endl;
-				} else
+					LATENCY_PROFILE::TIMER timer(mLatency, mStageSend);
+					SendBytes(mResponse.Data(), mResponse.Size());
+				}
+				CLOCK::time_point sent = CLOCK::now();
+				int64_t total_us = MicrosecondsBetween(mFrameReadyTime, sent);
+				int64_t io_us = total_us - MicrosecondsBetween(handle_start, handle_end);
+				mTickTiming.Add(mParser.tick, total_us, io_us);
+				if (mParser.match_result != PARSER::ONGOING)
 				{
-					LastServerResponse.push_back(alma);
-					if (alma==".")
+					mTickTiming.Print(std::cout);
+					mTickTiming.Reset();
+					if (mDebugLog.Dropped()>0)
 					{
-						if (LastServerResponse.front().substr(0, 7)=="players")
-						{
-							mParser.ParsePlayers(LastServerResponse);
-							SavePacket(LastServerResponse, "players.txt");
-						} else
-						if (LastServerResponse.front().substr(0, 3)=="map")
-						{
-							mParser.ParseMap(LastServerResponse);
-							SavePacket(LastServerResponse, "map.txt");
-							if (mDistCache.mDistMap.empty())
-							{
-								mDistCache.CreateFromParser(mParser);
-								mDistCache.SaveToFile("distcache.bin");
-							}
-						} else
-						{
-							if (NeedDebugLog() && mDebugLog.is_open())
-							{
-								for (std::vector<std::string>::const_iterator it = LastServerResponse.begin();
-									it != LastServerResponse.end(); ++it)
-									mDebugLog<<*it<<std::endl;
-							}
-							std::string strResponse = HandleServerResponse(LastServerResponse);
-							if (!strResponse.empty())
-							{
-								SendMessage(strResponse);
-							}
-						}
-						LastServerResponse.clear();
+						std::cout << "WARNING debug.log dropped " << mDebugLog.Dropped() << " records, the writer fell behind" << std::endl;
 					}
 				}
 			}
+			mFramer.ClearFrame();
 		}
 	}
 }
@@ -328,78 +550,95 @@ void CLIENT::PrintNewMatch()
 	}
 }
 
-std::string CLIENT::HandleServerResponse(std::vector<std::string> &ServerResponse)
+std::string CLIENT::DebugResponse(std::vector<std::string> &text)
+{
+	std::vector<LINE_VIEW> lines(text.begin(), text.end());
+	mFrameReadyTime = CLOCK::now(); // the budget counts from here
+	HandleServerResponse(lines);
+	// as SendMessage was given it before, without the final '\n'
+	return std::string(mResponse.Data(), mResponse.Size()>0 ? mResponse.Size() - 1 : 0);
+}
+
+void CLIENT::HandleServerResponse(const std::vector<LINE_VIEW> &ServerResponse)
 {
+	// nothing built from the arena in the previous tick is alive any more
+	mTickArena.Reset();
+	TICK_ARENA::SCOPE arena_scope(mTickArena);
+	uint64_t allocations_before = ALLOC_TRACKER::Count();
 	int prev_match_id = mParser.match_id;
-	mParser.Parse(ServerResponse);
+	{
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageParse);
+		mParser.Parse(ServerResponse);
+	}
 	if (prev_match_id!=mParser.match_id)
 	{
 		PrintNewMatch();
+		mMatchTicks = 0;
+		mTickAllocations.Reset();
 	}
-	std::stringstream ss;
 	if (mParser.match_result==PARSER::ONGOING)
 	{
-		ss << "tick "<<mParser.tick<<"\n";
-		Process();
-		ss<<command_buffer.str();
-		command_buffer.str(std::string());
-		ss<<".";
+		mTickDeadline = mFrameReadyTime + std::chrono::microseconds(mTickBudgetUs);
+		mCommands.clear();
+		{
+			LATENCY_PROFILE::TIMER timer(mLatency, mStageProcess);
+			Process();
+		}
+		if (ALLOC_TRACKER::Enabled() && ++mMatchTicks>TICK_ALLOCATIONS::WARMUP_TICKS)
+		{
+			mTickAllocations.Add(mParser.tick, ALLOC_TRACKER::Count() - allocations_before);
+		}
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageSerialize);
+		mResponse.Clear();
+		mResponse.Tick(mParser.tick);
+		for (size_t i = 0; i<mCommands.size(); i++)
+		{
+			const COMMAND &command = mCommands[i];
+			if (command.type==COMMAND::ATTACK)
+			{
+				mResponse.Attack(command.hero_id, command.target_id);
+			} else
+			{
+				mResponse.Move(command.hero_id, command.target_pos.x, command.target_pos.y);
+			}
+		}
+		mCommands.clear();
+		mResponse.End();
 	} else
 	{
 		MatchEnd();
-		ss<<".";
+		if (ALLOC_TRACKER::Enabled())
+		{
+			mTickAllocations.Print(std::cout);
+			mTickAllocations.Reset();
+		}
+		mLatency.Print(std::cout);
+		mLatency.Reset();
+		mResponse.Clear();
+		mResponse.End();
 	}
-	return ss.str();
 }
 
 void CLIENT::Attack(int hero_id, int target_id)
 {
-	command_buffer << "attack " << hero_id << " " << target_id << "\n";
+	COMMAND command;
+	command.type = COMMAND::ATTACK;
+	command.hero_id = hero_id;
+	command.target_id = target_id;
+	mCommands.push_back(command);
 }
 
 void CLIENT::Move(int hero_id, Position target_pos)
 {
-	command_buffer << "move " << hero_id << " " << target_pos.x << " " << target_pos.y << "\n";
+	COMMAND command;
+	command.type = COMMAND::MOVE;
+	command.hero_id = hero_id;
+	command.target_id = 0;
+	command.target_pos = target_pos;
+	mCommands.push_back(command);
 }
 
-int main(int argc, char* argv[])
+bool CLIENT::PastDeadline() const
 {
-	std::cout.sync_with_stdio(false);
-	std::string server_address = "172.22.22.239";
-	std::string preferredOpponents = "test";
-	if (argc>1)
-	{
-		preferredOpponents = argv[1];
-	}
-	std::cout<<"playing against " + preferredOpponents<<std::endl;
-	CLIENT *pClient = CreateClient(preferredOpponents);
-	/* for debugging:  */
-	std::vector<std::string> test_state;
-	if (LoadPacket("test.txt", test_state))
-	{
-		std::vector<std::string> players, map;
-		if (LoadPacket("players.txt", players) &&
-			LoadPacket("map.txt", map))
-		{
-			pClient->mParser.ParsePlayers(players);
-			pClient->mParser.ParseMap(map);
-
-			std::string resp = pClient->DebugResponse(test_state);
-			std::cout<<"response: "<<resp <<std::endl;
-		}
-	}
-	/**/
-
-	pClient->strIPAddress = server_address;
-	if (!pClient->Init())
-	{
-		std::cout<<"Connection failed"<<std::endl;
-	} else
-	{
-		pClient->Run();
-	}
-	delete pClient;
-	return 0;
+	return mTickBudgetUs>0 && CLOCK::now()>=mTickDeadline;
 }
-
-
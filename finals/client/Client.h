@@ -1,41 +1,146 @@
 #pragma once
 #include "parser.h"
 #include "distcache.h"
+#include "eventloop.h"
+#include "framing.h"
+#include "arena.h"
+#include "latency.h"
+#include "asynclog.h"
 #include <vector>
+#include <memory>
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <cstdint>
+
+// recv -> send latency of the tick frames, minus the time spent deciding,
+// and the ticks Process ran out of budget; only the first slow and the
+// first late tick of a match are reported right away
+struct TICK_TIMING
+{
+	static const int64_t IO_BUDGET_US = 1000;
+	int ticks;
+	int slow_ticks; // io overhead above IO_BUDGET_US
+	int late_ticks; // some heroes kept their baseline command
+	int baseline_heroes; // over the late ticks
+	int64_t total_us_sum, total_us_max;
+	int64_t io_us_sum, io_us_max;
+	TICK_TIMING() { Reset(); }
+	void Reset();
+	void Add(int tick, int64_t total_us, int64_t io_us);
+	void AddLate(int tick, int heroes_on_baseline, int heroes);
+	void Print(std::ostream &os) const;
+};
+
+// heap allocations while parsing and deciding, past the first ticks of a
+// match; only counted when ALLOC_TRACKER is enabled
+struct TICK_ALLOCATIONS
+{
+	static const int WARMUP_TICKS = 3; // the tick arena and buffers grow here
+	int ticks;
+	int allocating_ticks;
+	uint64_t allocations;
+	TICK_ALLOCATIONS() { Reset(); }
+	void Reset();
+	void Add(int tick, uint64_t count);
+	void Print(std::ostream &os) const;
+};
+
+// one order of the tick; the orders are sent in the order they were given
+struct COMMAND
+{
+	enum TYPE
+	{
+		ATTACK,
+		MOVE
+	};
+	TYPE type;
+	int hero_id;
+	int target_id; // ATTACK
+	Position target_pos; // MOVE
+};
 
 class CLIENT
 {
 public:
 	PARSER mParser;
-	std::stringstream command_buffer;
-	DISTCACHE mDistCache;
+	std::vector<COMMAND> mCommands; // given by Process this tick
+	std::shared_ptr<const DISTCACHE> mDistCache; // shared by every client of the process, never empty
+	mutable LATENCY_PROFILE mLatency; // stages of the tick, dumped when a match ends
 	CLIENT();
 	virtual ~CLIENT();
-	bool Init(); // connect
+	bool Init(); // starts connecting, the login goes out once connected
 	std::string strIPAddress;
 	bool bReceivedFirstPing;
 	bool LinkDead();
-	void Run();
+	void Run(); // runs its own event loop forever
+	void Attach(EVENTLOOP &loop); // drive this client from an external loop
 
-	std::string DebugResponse(std::vector<std::string> &text) { return HandleServerResponse(text); }
+	std::string DebugResponse(std::vector<std::string> &text);
+
+	// Process should be done this long after the frame arrived; 0 means no
+	// deadline. The server stops waiting for slow clients after ~125ms.
+	static const int64_t DEFAULT_TICK_BUDGET_US = 100000;
+	void SetTickBudget(int64_t budget_us) { mTickBudgetUs = budget_us; }
+	// FORMAT_REPLAY logs into replay.bin instead of debug.log, see replayfile.h
+	void SetDebugLogFormat(ASYNC_LOG::FORMAT format) { mDebugLogFormat = format; }
+	// several sessions of one process each need their own log
+	void SetDebugLogFile(const std::string &filename) { mDebugLogFile = filename; }
+	// which of the team's 5 connections this is, the "#n" of the password
+	void SetSlot(int slot) { mSlot = slot; }
+	int GetSlot() const { return mSlot; }
+	// point mDistCache at the table of mParser's map, see DISTCACHE::GetShared
+	void UpdateDistCache(bool save_built);
+	// of the match so far, reset when it ends
+	const TICK_ALLOCATIONS &GetTickAllocations() const { return mTickAllocations; }
 
 protected:
+	typedef std::chrono::steady_clock CLOCK;
 	void PrintNewMatch();
-	std::string HandleServerResponse(std::vector<std::string> &ServerResponse); // setup parser, call Process, handle mUnitTarget
+	void HandleServerResponse(const std::vector<LINE_VIEW> &ServerResponse); // setup parser, call Process, the answer into mResponse
 	void SendMessage( std::string aMessage );
+	void SendBytes(const char *data, size_t length); // a whole message, '\n' included
 
 	void Attack(int hero_id, int target_id);
 	void Move(int hero_id, Position target_pos);
+	bool PastDeadline() const; // of the tick being processed
 	virtual void Process() = 0;
 	virtual void MatchEnd() {}; // reset any data here which is persistent between ticks
 	virtual void ConnectionClosed();
 	virtual std::string GetPassword() = 0;
 	virtual std::string GetPreferredOpponents() = 0;
 	virtual bool NeedDebugLog() = 0;
-	std::ofstream mDebugLog;
+	ASYNC_LOG mDebugLog; // written by its own thread
+	ASYNC_LOG::FORMAT mDebugLogFormat;
+	std::string mDebugLogFile; // empty: debug.log or replay.bin
+	int mSlot;
+
+	EVENTLOOP *mLoop;
+	int mReconnectTimer;
+	int mConnectTimer; // gives up a connect in progress
+	bool mConnecting; // connect in progress, the socket is watched for writability
+	FRAMER mFramer; // receive arena, owns the lines of the frame being assembled
+	COMMAND_WRITER mResponse; // the answer to the last frame, sent as formatted
+	std::string mSendQueue; // bytes the socket did not take yet
+	CLOCK::time_point mFrameReadyTime; // when the last received chunk arrived
+	int64_t mTickBudgetUs;
+	CLOCK::time_point mTickDeadline;
+	TICK_TIMING mTickTiming;
+	TICK_ARENA mTickArena; // reset every tick, current while Process runs
+	TICK_ALLOCATIONS mTickAllocations;
+	int mMatchTicks; // ticks handled since the match started
+	LATENCY_PROFILE::STAGE mStageParse, mStageProcess, mStageSerialize, mStageSend;
+
+	void Connect();
+	void ScheduleReconnect(int64_t delay_us); // unless a reconnect is already due
+	void Login();
+	void FinishConnect(int connect_error); // ETIMEDOUT, or 0 to read the result from the socket
+	void CloseConnection();
+	void OnSocketEvent(int events);
+	void FlushSendQueue();
+	void ProcessReceivedLines();
+	void ProcessLine(const LINE_VIEW &line);
 #ifdef WIN32
 	SOCKET mConnectionSocket;
 #else
@@ -1,21 +1,49 @@
 #include "Hypno.h"
-#include <set>
 #include <map>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
 
 
 CLIENT* CreateClient(std::string preferredOpponents) {
 	return new Hypno(std::move(preferredOpponents));
 }
 
-Hypno::Hypno(std::string preferredOpponents) :
+Hypno::Hypno(std::string preferredOpponents, const HypnoParams& params) :
+	mParams(params),
 	mPreferredOpponents(std::move(preferredOpponents)) {
-	// nothing to see here
+	mStageUnitIndex = mLatency.AddStage("process/unit index");
+	mStageBaseline = mLatency.AddStage("process/baseline");
+	mStageBoards = mLatency.AddStage("process/boards");
+	mStageFields = mLatency.AddStage("process/fields");
+	mStageEnemyState = mLatency.AddStage("process/enemy state");
+	mStageDamageMap = mLatency.AddStage("GetDamageMap");
+	mStageLookahead = mLatency.AddStage("FightOrFlight/lookahead");
+	for (int i = 0; i < MaxControlledHeroes; ++i) {
+		mStageHero[i] = mLatency.AddStage("process/hero " + std::to_string(i + 1));
+	}
+	enemy_hp_map.reserve(UNIT_TABLE::RESERVED_UNITS);
+	mBaseline.reserve(MaxControlledHeroes);
+	mSuccesfulEnemyHeroes.reserve(UNIT_TABLE::FIXED_ID_LIMIT);
+
+	const int radius = 6;
+	const Position center{radius, radius};
+	mRangeStencils.resize(MaxStencilRangeSq + 1);
+	for (int range_sq = 0; range_sq <= MaxStencilRangeSq; ++range_sq) {
+		for (int y = 0; y <= 2 * radius; ++y) {
+			for (int x = 0; x <= 2 * radius; ++x) {
+				if (IsNeighbourOfCircle(Position{x, y}, center, range_sq)) {
+					mRangeStencils[range_sq].emplace_back(x - radius, y - radius);
+				}
+			}
+		}
+	}
 }
 
-Position Hypno::Retreat(const Matrix<double>& dmg_map, const MAP_OBJECT& hero) const {
+Position Hypno::Retreat(const Field& dmg_map, const MAP_OBJECT& hero) const {
 	auto neighbours = GetNeighbours(hero.pos);
 	auto target_pos = *std::min_element(begin(neighbours), end(neighbours),
 		[&](auto lhs, auto rhs) {
@@ -27,45 +55,63 @@ Position Hypno::Retreat(const Matrix<double>& dmg_map, const MAP_OBJECT& hero) c
 
 void Hypno::MatchEnd() {
 	mSuccesfulEnemyHeroes.clear();
-	mLastPositionOfMinions.clear();
+	mHistory.Reset();
+	if (mLookahead.Nodes() > 0) {
+		std::cout << "lookahead: " << mLookahead.Nodes() << " nodes in "
+			<< mLookahead.Milliseconds() << "ms, "
+			<< mLookahead.NodesPerMillisecond() << " nodes/ms" << std::endl;
+		mLookahead.ResetStats();
+	}
+}
+
+void Hypno::UpdateLookahead() {
+	mSimRootValid = false;
+	if (mParams.lookaheadDepth <= 0) {
+		return;
+	}
+	if (mSimMatchId != mParser.match_id || !mSimRoot) {
+		mSimMatchId = mParser.match_id;
+		mSimValid = mSim.Init(mParser);
+		if (!mSimRoot) {
+			mSimRoot.reset(new SIM_STATE);
+		}
+		mLookahead.Reserve(mParams.lookaheadBeam);
+	}
+	mSimRootValid = mSimValid && mSim.Load(mParser, *mSimRoot);
+}
+
+// The first action of the best line LOOKAHEAD finds: a step, or the hero's
+// own cell when it should stand and fight.
+bool Hypno::SearchAhead(const MAP_OBJECT& hero, Position& target_pos) {
+	if (!mSimRootValid) {
+		return false;
+	}
+	LATENCY_PROFILE::TIMER timer(mLatency, mStageLookahead);
+	COMMAND first;
+	if (!mLookahead.Search(mSim, *mSimRoot, hero.id, mParams.lookaheadDepth,
+			mParams.lookaheadBeam, [this]() { return PastDeadline(); }, first)) {
+		return false;
+	}
+	target_pos = first.type == COMMAND::MOVE ? first.target_pos : hero.pos;
+	return true;
 }
 
-Position Hypno::FightOrFlight(int hero_id) const {
+Position Hypno::FightOrFlight(int hero_id) {
 	auto hero = mParser.GetUnitByID(hero_id);
 	if (IsNearOurBase(*hero)) {
 		return hero->pos;
 	}
 
-	auto our_minion_map = GetDamageMap(GetOurMinions());
-	auto enemy_minion_map = GetDamageMap(GetEnemyMinions());
-
-	auto our_turret_map = GetDamageMap(GetOurTurrets());
-	auto enemy_turret_map = GetDamageMap(GetEnemyTurrets());
-
-	auto our_hero_map = GetDamageMap(GetOurHeroes());
-	auto enemy_hero_map = GetDamageMap(GetEnemyHeroes());
+	Position searched;
+	if (SearchAhead(*hero, searched)) {
+		return searched;
+	}
 
-	auto dmg_map =
-		our_minion_map + enemy_minion_map +
-		our_turret_map + enemy_turret_map +
-		our_hero_map + enemy_hero_map;
+	const auto& dmg_map = mFields.damage;
 
-	int minions_attacked = 0;
-	int minions_in_range = 0;
-	for (auto& minion : GetEnemyMinions()) {
-		if (IsNeighbourOfCircle(hero->pos, minion.pos, MINION_RANGE_SQ)) {
-		// if (hero->pos.DistSquare(minion.pos) <= MINION_RANGE_SQ) {
-			if (our_turret_map[minion.pos] != 0 || our_minion_map[minion.pos] != 0) {
-				++minions_attacked;
-			}
-			++minions_in_range;
-		}
-	}
-	auto hp_map = GetHPMap();
-	if (minions_in_range != minions_attacked) {
-		// std::cerr << hero->pos << ": minions "
-		// 	<< minions_attacked << "/" << minions_in_range << std::endl;
-		if (!(hp_map[hero->pos] <= 10*MINION_MAX_HP)) {
+	const auto& hp_map = mFields.hp;
+	if (HasUnattackedMinionNear(hero->pos)) {
+		if (!(hp_map[hero->pos] <= mParams.outnumberMinions*MINION_MAX_HP)) {
 			return Retreat(dmg_map, *hero);
 		}
 		// std::cerr << "Would retreat, but outnumber" << std::endl;
@@ -76,14 +122,14 @@ Position Hypno::FightOrFlight(int hero_id) const {
 	}
 	auto dmg_deficit = dmg_map[hero->pos];
 	auto hp_surplus = -hp_map[hero->pos];
-	if (hp_surplus > 2*dmg_deficit) {
+	if (hp_surplus > mParams.standTurns*dmg_deficit) {
 		// If we can last two turns in this position, stay and fight
 		return hero->pos;
 	}
 	return Retreat(dmg_map, *hero);
 }
 
-void Hypno::AttackMove(int hero_id, const Position& pos) {
+void Hypno::AttackMove(int hero_id, const FLOW_FIELD& field) {
 	auto hero = mParser.GetUnitByID(hero_id);
 	auto target_pos = FightOrFlight(hero_id);
 	if (target_pos != hero->pos) {
@@ -93,15 +139,32 @@ void Hypno::AttackMove(int hero_id, const Position& pos) {
 		if (!possible_targets.empty()) {
 			auto target_unit = GetPreferredEnemyToAttack(possible_targets);
 			Attack(hero_id, target_unit);
-			enemy_hp_map[target_unit] -= mParser.GetOurHeroDamage();
-		} else if (hero->pos != pos) {
-			Move(hero_id, mDistCache.GetNextTowards(hero->pos, pos));
+			EnemyHp(target_unit) -= mParser.GetOurHeroDamage();
+		} else if (field.Dist(hero->pos) > 0) {
+			Move(hero_id, field.Next(hero->pos));
 		}
 	}
 }
 
+void Hypno::AttackFallback(const MAP_OBJECT& hero,
+	const ObjectList& fallbacks, const Position& rally)
+{
+	if (fallbacks.size() < static_cast<std::size_t>(mParams.minFallbacks)) {
+		AttackMove(hero.id, mFlow.Toward(rally));
+	} else if (mParams.fallbackNearest) {
+		TICK_VECTOR<Position> goals;
+		for (auto& unit : fallbacks) {
+			goals.push_back(unit.pos);
+		}
+		AttackMove(hero.id, mFlow.TowardNearest(goals.data(), goals.size()));
+	} else {
+		// the one furthest forward; ties stay with the order std::sort leaves
+		AttackMove(hero.id, mFlow.Toward(OrderByDst(fallbacks)[0].pos));
+	}
+}
+
 void Hypno::AttackInside(const MAP_OBJECT& hero) {
-	std::vector<MAP_OBJECT> enemies;
+	ObjectList enemies;
 	for (auto& unit : GetEnemyHeroes()) {
 		if (IsNearOurBase(unit)) {
 			enemies.push_back(unit);
@@ -115,28 +178,23 @@ void Hypno::AttackInside(const MAP_OBJECT& hero) {
 	if (enemies.empty()) {
 		AttackMid(hero);
 	} else {
-		AttackMove(hero.id, enemies.front().pos);
+		AttackMove(hero.id, mFlow.Toward(enemies.front().pos));
 	}
 }
 
 void Hypno::AttackTop(const MAP_OBJECT& hero) {
 	if (IsNearOurBase(hero)) {
-		AttackMove(hero.id, {4, MaxY() - 4});
+		AttackMove(hero.id, mFlow.Toward({4, MaxY() - 4}));
 	} else {
-		auto fallbacks = OrderByDst(GetTopFallbackObjects());
-		if (fallbacks.size() < 2) {
-			AttackMove(hero.id, {1, 11});
-		} else {
-			AttackMove(hero.id, fallbacks[0].pos);
-		}
+		AttackFallback(hero, GetTopFallbackObjects(), {1, 11});
 
 #if 0
 		auto turrets = GetTopEnemyTurrets();
 		if (turrets.empty()) {
-			AttackMove(hero.id, {MaxX() - 1, MaxY() - 1});
+			AttackMove(hero.id, mFlow.Toward({MaxX() - 1, MaxY() - 1}));
 		} else {
 			auto target = turrets[0].pos;
-			AttackMove(hero.id, target);
+			AttackMove(hero.id, mFlow.Toward(target));
 		}
 #endif
 	}
@@ -144,21 +202,16 @@ void Hypno::AttackTop(const MAP_OBJECT& hero) {
 
 void Hypno::AttackDown(const MAP_OBJECT& hero) {
 	if (IsNearOurBase(hero)) {
-		AttackMove(hero.id, {MaxX() - 4, 4});
+		AttackMove(hero.id, mFlow.Toward({MaxX() - 4, 4}));
 	} else {
-		auto fallbacks = OrderByDst(GetDownFallbackObjects());
-		if (fallbacks.size() < 2) {
-			AttackMove(hero.id, {11, 1});
-		} else {
-			AttackMove(hero.id, fallbacks[0].pos);
-		}
+		AttackFallback(hero, GetDownFallbackObjects(), {11, 1});
 #if 0
 		auto turrets = GetRightEnemyTurrets();
 		if (turrets.empty()) {
-			AttackMove(hero.id, {MaxX() - 1, MaxY() - 1});
+			AttackMove(hero.id, mFlow.Toward({MaxX() - 1, MaxY() - 1}));
 		} else {
 			auto target = turrets[0].pos;
-			AttackMove(hero.id, target);
+			AttackMove(hero.id, mFlow.Toward(target));
 		}
 #endif
 	}
@@ -167,67 +220,47 @@ void Hypno::AttackDown(const MAP_OBJECT& hero) {
 void Hypno::AttackMid(const MAP_OBJECT& hero) {
 	auto turrets = GetMidEnemyTurrets();
 	if (turrets.empty()) {
-		AttackMove(hero.id, {MaxX() - 1, MaxY() - 1});
+		AttackMove(hero.id, mFlow.Toward({MaxX() - 1, MaxY() - 1}));
 	} else {
-		auto fallbacks = OrderByDst(GetMidFallbackObjects());
-		if (fallbacks.size() < 2) {
-			AttackMove(hero.id, {9, 9});
-		} else {
-			AttackMove(hero.id, fallbacks[0].pos);
-		}
+		AttackFallback(hero, GetMidFallbackObjects(), {9, 9});
 #if 0
 		auto target = turrets[0].pos;
-		AttackMove(hero.id, target);
+		AttackMove(hero.id, mFlow.Toward(target));
 #endif
 	}
 }
 
 void Hypno::UpdateEnemyHeroes() {
-	std::map<int, Position> newPositionOfMinions;
-	for (const auto& minion: GetOurMinions()) {
-		newPositionOfMinions.emplace(minion.id, minion.pos);
-	}
-
-	const auto& newHeroes = GetEnemyHeroes();
-	for (auto& oldHero: mSuccesfulEnemyHeroes) {
-		const auto& oldHeroId = oldHero.first;
-		auto newIt = std::find_if(newHeroes.begin(), newHeroes.end(),
-			[&oldHeroId](const MAP_OBJECT& o) {
-				return o.id == oldHeroId;
-			});
-		if (newIt == newHeroes.end()) {
-			oldHero.second = 0;
+	// a hero that is not on the map died, its count starts over
+	for (std::size_t id = 0; id < mSuccesfulEnemyHeroes.size(); ++id) {
+		if (mHistory.Length(static_cast<int>(id)) == 0 && mSuccesfulEnemyHeroes[id] > 0) {
+			mSuccesfulEnemyHeroes[id] = 0;
 		}
 	}
 
-	for (const auto& minionRecord: mLastPositionOfMinions) {
-		auto newIt = newPositionOfMinions.find(minionRecord.first);
-		if (newIt != newPositionOfMinions.end()) {
-			// Minion survived, nothing to do
+	for (const auto& gone: mParser.UnitTable.Removed()) {
+		if (gone.t != UNIT_TYPE::MINION || gone.side != 0) {
 			continue;
 		}
-		auto placeOfDeath = minionRecord.second;
-		auto objectsNearPlaceOfDeath =
-			GetEnemyObjectsNear(placeOfDeath, HERO_RANGE_SQ);
-		for (const auto& object: objectsNearPlaceOfDeath) {
+		for (const auto& object: GetEnemyObjectsNear(gone.pos, HERO_RANGE_SQ)) {
 			if (object.t == UNIT_TYPE::HERO) {
-				++mSuccesfulEnemyHeroes[object.id];
+				if (object.id >= static_cast<int>(mSuccesfulEnemyHeroes.size())) {
+					mSuccesfulEnemyHeroes.resize(object.id + 1, -1);
+				}
+				auto& count = mSuccesfulEnemyHeroes[object.id];
+				count = std::max(count, 0) + 1;
 			}
 		}
 	}
-
-	mLastPositionOfMinions = std::move(newPositionOfMinions);
 }
 
-std::map<int, int> Hypno::GetMostEvilEnemyHeroes() const {
-	std::map<int, int> result;
-	auto currentEnemyHeroes = GetEnemyHeroes();
-	for (const auto& enemyHero: mSuccesfulEnemyHeroes) {
-		auto heroId = enemyHero.first;
-		auto it = std::find_if(currentEnemyHeroes.begin(), currentEnemyHeroes.end(),
-				[heroId](const auto& o) { return o.id == heroId; });
-		if (it != currentEnemyHeroes.end()) {
-			result.emplace(enemyHero);
+// the tracked heroes on the map, those whose count started over included
+TICK_MAP<int, int> Hypno::GetMostEvilEnemyHeroes() const {
+	TICK_MAP<int, int> result;
+	for (const auto& hero: GetEnemyHeroes()) {
+		if (hero.id < static_cast<int>(mSuccesfulEnemyHeroes.size()) &&
+			mSuccesfulEnemyHeroes[hero.id] >= 0) {
+			result.emplace(hero.id, mSuccesfulEnemyHeroes[hero.id]);
 		}
 	}
 	return result;
@@ -248,124 +281,212 @@ void Hypno::Process() {
 	}
 #endif
 
-	enemy_hp_map.clear();
-	for (auto& enemy : GetEnemyObjects()) {
-		enemy_hp_map[enemy.id] = enemy.hp;
+	mFlow.BeginTick(mDistCache);
+	{
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageUnitIndex);
+		mUnitIndex.Rebuild(mParser.Units, mParser.Controllers,
+			[this](const MAP_OBJECT& unit) {
+				if (IsAtTop(unit)) {
+					return UnitIndex::LaneTop;
+				}
+				if (IsAtDown(unit)) {
+					return UnitIndex::LaneDown;
+				}
+				if (IsAtMid(unit)) {
+					return UnitIndex::LaneMid;
+				}
+				return UnitIndex::LaneNone;
+			});
+		// every tick, so no death is missed while refining is skipped
+		mHistory.Update(mParser);
+		UpdateEnemyHeroes();
+	}
+
+	// cheap commands first, so every hero has one if the deadline hits
+	{
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageBaseline);
+		mBaseline.clear();
+		int slot = 0;
+		for (auto& hero : GetControlledHeroes()) {
+			COMMAND command;
+			if (GetBaselineCommand(hero, command)) {
+				mBaseline.emplace_back(slot, command);
+			}
+			++slot;
+		}
+	}
+
+	bool refine = !PastDeadline();
+	if (refine) {
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageBoards);
+		UpdateBoards();
+	}
+	if (refine) {
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageFields);
+		UpdateFields();
+	}
+
+	if (refine) {
+		LATENCY_PROFILE::TIMER timer(mLatency, mStageEnemyState);
+		enemy_hp_map.clear();
+		for (auto& enemy : GetEnemyObjects()) {
+			enemy_hp_map.emplace_back(enemy.id, enemy.hp);
+		}
+		std::sort(enemy_hp_map.begin(), enemy_hp_map.end());
+	}
+	if (refine) {
+		UpdateLookahead();
 	}
-	UpdateEnemyHeroes();
 #if 0
 	for (const auto& enemyHero: GetMostEvilEnemyHeroes()) {
 		std::cerr << "Hero " << enemyHero.first << " has been near: "
 			<< enemyHero.second << " of our Minion's kills" << std::endl;
 	}
 #endif
+	// the full decision of each hero, while the budget lasts; heroes left
+	// over keep their baseline command
+	int refined = 0;
 	for (auto& hero : GetControlledHeroes()) {
-		if (IsNearOurBase(hero)) {
-			if (IsEnemyInside()) {
-				AttackInside(hero);
-			}
-			if (!HasTopHero()) {
-				AttackTop(hero);
-			} else if (!HasDownHero()) {
-				AttackDown(hero);
-			} else {
-				AttackMid(hero);
+		if (!refine || PastDeadline()) {
+			break;
+		}
+		LATENCY_PROFILE::TIMER timer(mLatency,
+			mStageHero[std::min(refined, MaxControlledHeroes - 1)]);
+		DecideHero(hero);
+		++refined;
+	}
+	int heroes = static_cast<int>(GetControlledHeroes().size());
+	if (refined < heroes) {
+		for (auto& baseline : mBaseline) {
+			if (baseline.first >= refined) {
+				mCommands.push_back(baseline.second);
 			}
+		}
+		mTickTiming.AddLate(mParser.tick, heroes - refined, heroes);
+	}
+}
+
+void Hypno::DecideHero(const MAP_OBJECT& hero) {
+	if (IsNearOurBase(hero)) {
+		if (IsEnemyInside()) {
+			AttackInside(hero);
+		}
+		if (!HasTopHero()) {
+			AttackTop(hero);
+		} else if (!HasDownHero()) {
+			AttackDown(hero);
 		} else {
-			if (IsAtTop(hero)) {
-				AttackTop(hero);
-			} else if (IsAtDown(hero)) {
-				AttackDown(hero);
-			} else {
-				if (IsGangOfFourHigh(hero)) {
-					if (!HasDownHero()) {
-						AttackDown(hero);
-					} else if (!HasTopHero()) {
-						AttackTop(hero);
-					} else {
-						AttackMid(hero);
-					}
+			AttackMid(hero);
+		}
+	} else {
+		if (IsAtTop(hero)) {
+			AttackTop(hero);
+		} else if (IsAtDown(hero)) {
+			AttackDown(hero);
+		} else {
+			if (IsGangOfFourHigh(hero)) {
+				if (!HasDownHero()) {
+					AttackDown(hero);
+				} else if (!HasTopHero()) {
+					AttackTop(hero);
 				} else {
 					AttackMid(hero);
 				}
+			} else {
+				AttackMid(hero);
 			}
 		}
 	}
 }
 
-std::vector<MAP_OBJECT> Hypno::GetControlledHeroes() const {
-	std::vector<MAP_OBJECT> vec;
-	std::set<int> ids;
-
-	for (auto& cc : mParser.Controllers) {
-		if (cc.controller_id == 0) {
-			ids.insert(cc.hero_id);
+// Nearest enemy in range, or one step toward the hero's lane target.
+bool Hypno::GetBaselineCommand(const MAP_OBJECT& hero, COMMAND& command) {
+	const MAP_OBJECT* target = nullptr;
+	TICK_VECTOR<int> nearUnits;
+	for (auto& unit : mParser.GetUnitsNear(hero.pos, HERO_RANGE_SQ, nearUnits)) {
+		if (unit.side == 0) {
+			continue;
+		}
+		if (!target || unit.pos.DistSquare(hero.pos) < target->pos.DistSquare(hero.pos)) {
+			target = &unit;
 		}
 	}
+	command.hero_id = hero.id;
+	if (target) {
+		command.type = COMMAND::ATTACK;
+		command.target_id = target->id;
+		return true;
+	}
+	Position goal{MaxX() - 1, MaxY() - 1};
+	if (IsAtTop(hero) && hero.pos.y < MaxY() - 4) {
+		goal = Position{4, MaxY() - 4};
+	} else if (IsAtDown(hero) && hero.pos.x < MaxX() - 4) {
+		goal = Position{MaxX() - 4, 4};
+	}
+	if (hero.pos == goal) {
+		return false;
+	}
+	command.type = COMMAND::MOVE;
+	command.target_id = 0;
+	command.target_pos = mDistCache->Empty() ? goal : mFlow.Toward(goal).Next(hero.pos);
+	return true;
+}
 
-	return GetObjects([&](const MAP_OBJECT& unit) {
-		return (unit.t == HERO && ids.count(unit.id) > 0);
-	});
+UnitIndex::Range Hypno::GetControlledHeroes() const {
+	return mUnitIndex.GetControlledHeroes();
 }
 
-std::vector<MAP_OBJECT> Hypno::GetHeroes(int side) const {
-	return GetObjects([&](const MAP_OBJECT& unit) {
-		return (unit.t == UNIT_TYPE::HERO && unit.side == side);
-	});
+UnitIndex::Range Hypno::GetHeroes(int side) const {
+	return mUnitIndex.Get(side, HERO);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetOurHeroes() const {
+UnitIndex::Range Hypno::GetOurHeroes() const {
 	return GetHeroes(0);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetEnemyHeroes() const {
+UnitIndex::Range Hypno::GetEnemyHeroes() const {
 	return GetHeroes(1);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetMinions(int side) const {
-	return GetObjects([&](const MAP_OBJECT& unit) {
-		return (unit.t == MINION && unit.side == side);
-	});
+UnitIndex::Range Hypno::GetMinions(int side) const {
+	return mUnitIndex.Get(side, MINION);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetOurMinions() const {
+UnitIndex::Range Hypno::GetOurMinions() const {
 	return GetMinions(0);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetEnemyMinions() const {
+UnitIndex::Range Hypno::GetEnemyMinions() const {
 	return GetMinions(1);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetOurTurrets() const {
-	return GetObjects([](const MAP_OBJECT& unit) {
-		return unit.t == TURRET && unit.side == 0;
-	});
+UnitIndex::Range Hypno::GetOurTurrets() const {
+	return mUnitIndex.Get(0, TURRET);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetEnemyTurrets() const {
-	return GetObjects([](const MAP_OBJECT& unit) {
-		return unit.t == TURRET && unit.side == 1;
-	});
+UnitIndex::Range Hypno::GetEnemyTurrets() const {
+	return mUnitIndex.Get(1, TURRET);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetEnemyObjects() const {
-	return GetObjects([](const MAP_OBJECT& obj) {
-		return obj.side != 0;
-	});
+UnitIndex::Range Hypno::GetEnemyObjects() const {
+	return mUnitIndex.Get(1);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetOurObjects() const {
-	return GetObjects([](const MAP_OBJECT& obj) {
-		return obj.side == 0;
-	});
+UnitIndex::Range Hypno::GetOurObjects() const {
+	return mUnitIndex.Get(0);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetEnemyObjectsNear(
+Hypno::ObjectList Hypno::GetEnemyObjectsNear(
 	const Position& pos, int distance_sq) const
 {
-	return GetObjects([&](const MAP_OBJECT& obj) {
-		return obj.side != 0 && pos.DistSquare(obj.pos) <= distance_sq;
-	});
+	ObjectList vec;
+	TICK_VECTOR<int> nearUnits;
+	for (auto& obj : mParser.GetUnitsNear(pos, distance_sq, nearUnits)) {
+		if (obj.side != 0) {
+			vec.push_back(obj);
+		}
+	}
+	return vec;
 }
 
 MAP_OBJECT Hypno::GetEnemyBase() const {
@@ -378,16 +499,105 @@ MAP_OBJECT Hypno::GetEnemyBase() const {
 	return {};
 }
 
-std::vector<MAP_OBJECT> Hypno::GetObjectsNear(
+Hypno::ObjectList Hypno::GetObjectsNear(
 	const Position& pos, int distance_sq) const
 {
-	return GetObjects([&](const MAP_OBJECT& obj) {
-		return pos.DistSquare(obj.pos) <= distance_sq;
-	});
+	TICK_VECTOR<int> nearUnits;
+	auto near = mParser.GetUnitsNear(pos, distance_sq, nearUnits);
+	return ObjectList(near.begin(), near.end());
+}
+
+// some enemy minion that could hit pos is not under attack by our minions
+// or turrets
+bool Hypno::HasUnattackedMinionNear(const Position& pos) const {
+	if (mBoardsValid) {
+		return GetRangeMasks(MINION_RANGE_SQ)->Intersects(pos, mUnattackedEnemyMinions);
+	}
+	const auto& our_minion_map = mFields.ourMinionDamage;
+	const auto& our_turret_map = mFields.ourTurretDamage;
+	for (auto& minion : GetEnemyMinions()) {
+		if (IsNeighbourOfCircle(pos, minion.pos, MINION_RANGE_SQ) &&
+			our_turret_map[minion.pos] == 0 && our_minion_map[minion.pos] == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void Hypno::UpdateBoards() {
+	int w = mParser.w;
+	int h = mParser.h;
+	if (!Bitboard::Fits(w, h)) {
+		mBoardsValid = false;
+		return;
+	}
+	if (!mBoardsValid || mBoardWidth != w || mBoardHeight != h ||
+		mBoardMatchId != mParser.match_id)
+	{
+		mBoardWidth = w;
+		mBoardHeight = h;
+		mBoardMatchId = mParser.match_id;
+		mWalkable.Clear();
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				if (mParser.GetAt(Position{x, y}) != PARSER::GROUND_TYPE::WALL) {
+					mWalkable.Set(Position{x, y});
+				}
+			}
+		}
+		// the damage fields leave out the last row and column
+		mDamageExtent.Clear();
+		for (int y = 0; y < h - 1; ++y) {
+			mDamageExtent.GetRow(y) = Bitboard::Span(0, w - 2);
+		}
+		mRangeMasks.clear();
+		for (int range_sq : {MINION_RANGE_SQ, HERO_RANGE_SQ, TURRET_RANGE_SQ}) {
+			if (!GetRangeMasks(range_sq)) {
+				mRangeMasks.emplace_back(range_sq, w, h);
+			}
+		}
+		mBoardsValid = true;
+	}
+
+	Bitboard covered;
+	for (auto& unit : GetOurMinions()) {
+		GetRangeMasks(mParser.GetAttackRangeSquaredOfUnit(unit))->OrInto(covered, unit.pos);
+	}
+	for (auto& unit : GetOurTurrets()) {
+		GetRangeMasks(mParser.GetAttackRangeSquaredOfUnit(unit))->OrInto(covered, unit.pos);
+	}
+	covered &= mDamageExtent;
+	mUnattackedEnemyMinions.Clear();
+	for (auto& unit : GetEnemyMinions()) {
+		mUnattackedEnemyMinions.Set(unit.pos);
+	}
+	mUnattackedEnemyMinions.AndNot(covered);
 }
 
-std::vector<Position> Hypno::GetNeighbours(const Position& pos) const {
-	std::vector<Position> result;
+const RangeMasks* Hypno::GetRangeMasks(int range_sq) const {
+	for (auto& masks : mRangeMasks) {
+		if (masks.GetRangeSq() == range_sq) {
+			return &masks;
+		}
+	}
+	return nullptr;
+}
+
+TICK_VECTOR<Position> Hypno::GetNeighbours(const Position& pos) const {
+	TICK_VECTOR<Position> result;
+	if (mBoardsValid && pos.x >= 0 && pos.x <= MaxX() && pos.y >= 0 && pos.y <= MaxY()) {
+		for (int y = std::max(pos.y - 1, 0); y <= std::min(pos.y + 1, MaxY()); ++y) {
+			auto bits = mWalkable.GetRow(y) & Bitboard::Span(pos.x - 1, pos.x + 1);
+			if (y == pos.y) {
+				bits &= ~(Bitboard::Row(1) << pos.x);
+			}
+			for (; bits != 0; bits &= bits - 1) {
+				result.emplace_back(Bitboard::LowestBit(bits), y);
+			}
+		}
+		return result;
+	}
 	for (int y = pos.y - 1; y <= pos.y + 1; ++y) {
 		for (int x = pos.x - 1; x <= pos.x + 1; ++x) {
 			if (x == pos.x && y == pos.y) {
@@ -408,32 +618,37 @@ std::vector<Position> Hypno::GetNeighbours(const Position& pos) const {
 bool Hypno::IsNeighbourOfCircle(
 	const Position& pos, const Position& center, int radius_sq) const
 {
-	auto d_sq = pos.DistSquare(center);
-	if (d_sq <= radius_sq) {
-		return true;
+	if (mBoardsValid && pos.x >= 0 && pos.x <= MaxX() && pos.y >= 0 && pos.y <= MaxY()) {
+		if (auto masks = GetRangeMasks(radius_sq)) {
+			return masks->Contains(center, pos);
+		}
 	}
+	return RangeMasks::InGrownCircle(pos.x - center.x, pos.y - center.y, radius_sq);
+}
 
-	for (int y = pos.y - 1; y <= pos.y + 1; ++y) {
-		for (int x = pos.x - 1; x <= pos.x + 1; ++x) {
-			auto n_d_sq = Position{x, y}.DistSquare(center);
-			if (n_d_sq <= radius_sq) {
-				return true;
-			}
-		}
+int& Hypno::EnemyHp(int id) {
+	auto it = std::lower_bound(enemy_hp_map.begin(), enemy_hp_map.end(),
+		std::make_pair(id, std::numeric_limits<int>::min()));
+	if (it == enemy_hp_map.end() || it->first != id) {
+		throw std::out_of_range("Hypno : no such enemy");
 	}
-	return false;
+	return it->second;
+}
+
+int Hypno::EnemyHp(int id) const {
+	return const_cast<Hypno*>(this)->EnemyHp(id);
 }
 
 bool Hypno::CanOneHit(const MAP_OBJECT& unit) const {
-	return enemy_hp_map.at(unit.id) <= mParser.GetHeroDamage(!unit.side);
+	return EnemyHp(unit.id) <= mParser.GetHeroDamage(!unit.side);
 }
 
-int Hypno::GetPreferredEnemyToAttack(const std::vector<MAP_OBJECT>& enemies_) const {
+int Hypno::GetPreferredEnemyToAttack(const ObjectList& enemies_) const {
 	assert(!enemies_.empty());
 
-	std::vector<MAP_OBJECT> enemies;
+	ObjectList enemies;
 	for (auto& enemy : enemies_) {
-		if (enemy_hp_map.at(enemy.id) > 0) {
+		if (EnemyHp(enemy.id) > 0) {
 			enemies.push_back(enemy);
 		}
 	}
@@ -474,54 +689,63 @@ int Hypno::GetPreferredEnemyToAttack(const std::vector<MAP_OBJECT>& enemies_) co
 	return target.id;
 }
 
-std::vector<MAP_OBJECT> Hypno::GetObjects(std::function<bool(const MAP_OBJECT&)> fn) const {
-	std::vector<MAP_OBJECT> vec;
-	for (auto& unit : mParser.Units) {
-		if (fn(unit)) {
-			vec.push_back(unit);
-		}
+template<typename T>
+void Hypno::StampDamage(Matrix<T>& field, const MAP_OBJECT& unit) const {
+	// skip bases for now
+	if (unit.t == UNIT_TYPE::BASE) {
+		return;
+	}
+	int sign = (unit.side == 0 ? -1 : 1);
+	int range_sq = mParser.GetAttackRangeSquaredOfUnit(unit);
+	int dmg = mParser.GetDamageOfUnit(unit);
+	// the damage map never covered the last row and column
+	Stamp(field, unit.pos, range_sq, static_cast<T>(sign * dmg), MaxX() - 1, MaxY() - 1);
+}
+
+template<typename T>
+void Hypno::StampHP(Matrix<T>& field, const MAP_OBJECT& unit) const {
+	// skip bases for now
+	if (unit.t == UNIT_TYPE::BASE) {
+		return;
 	}
+	int sign = (unit.side == 0 ? -1 : 1);
+	int range_sq = mParser.GetAttackRangeSquaredOfUnit(unit);
+	int hp = unit.hp;
+	if (unit.t == UNIT_TYPE::HERO && unit.side == 0) {
+		hp = mParser.GetMaxHPOfUnit(unit);
+	}
+	Stamp(field, unit.pos, range_sq, static_cast<T>(sign * hp), MaxX(), MaxY());
+}
 
-	return vec;
+template<typename T>
+void Hypno::Stamp(Matrix<T>& field, const Position& center, int range_sq,
+	T value, int max_x, int max_y) const
+{
+	assert(range_sq >= 0 && range_sq <= MaxStencilRangeSq);
+	for (auto& offset : mRangeStencils[range_sq]) {
+		int x = center.x + offset.x;
+		int y = center.y + offset.y;
+		if (x < 0 || x > max_x || y < 0 || y > max_y) {
+			continue;
+		}
+		field(x, y) += value;
+	}
 }
 
 Matrix<double> Hypno::GetDamageMap() const {
-	return GetDamageMap(mParser.Units);
+	return GetDamageMap(mUnitIndex.All());
 }
 
-Matrix<double> Hypno::GetDamageMap(const std::vector<MAP_OBJECT>& units) const {
+Matrix<double> Hypno::GetDamageMap(const UnitIndex::Range& units) const {
+	LATENCY_PROFILE::TIMER timer(mLatency, mStageDamageMap);
 	Matrix<double> result{
 		static_cast<Matrix<double>::size_type>(mParser.w),
 		static_cast<Matrix<double>::size_type>(mParser.h),
 		0
 	};
-
-
 	for (auto& unit : units) {
-		// skip bases for now
-		if (unit.t == UNIT_TYPE::BASE) {
-			continue;
-		}
-
-		int sign = (unit.side == 0 ? -1 : 1);
-
-		int range_sq = mParser.GetAttackRangeSquaredOfUnit(unit);
-		int dmg = mParser.GetDamageOfUnit(unit);
-
-		const int radius = 6;
-		for (int y = unit.pos.y - radius; y <= unit.pos.y + radius; ++y) {
-			for (int x = unit.pos.x - radius; x <= unit.pos.x + radius; ++x) {
-				if (x < 0 || x >= MaxX() || y < 0 || y >= MaxY()) {
-					continue;
-				}
-				if (!IsNeighbourOfCircle(Position{x, y}, unit.pos, range_sq)) {
-					continue;
-				}
-				result.at(x, y) += sign * dmg;
-			}
-		}
+		StampDamage(result, unit);
 	}
-
 	return result;
 }
 
@@ -531,37 +755,37 @@ Matrix<double> Hypno::GetHPMap() const {
 		static_cast<Matrix<double>::size_type>(mParser.h),
 		0
 	};
-
-
 	for (auto& unit : mParser.Units) {
-		// skip bases for now
-		if (unit.t == UNIT_TYPE::BASE) {
-			continue;
-		}
-
-		int sign = (unit.side == 0 ? -1 : 1);
-
-		int range_sq = mParser.GetAttackRangeSquaredOfUnit(unit);
-		int hp = unit.hp;
-		if (unit.t == UNIT_TYPE::HERO && unit.side == 0) {
-			hp = mParser.GetMaxHPOfUnit(unit);
-		}
+		StampHP(result, unit);
+	}
+	return result;
+}
 
-		const int radius = 6;
-		for (int y = unit.pos.y - radius; y <= unit.pos.y + radius; ++y) {
-			for (int x = unit.pos.x - radius; x <= unit.pos.x + radius; ++x) {
-				if (x < 0 || x > MaxX() || y < 0 || y > MaxY()) {
-					continue;
-				}
-				if (!IsNeighbourOfCircle(Position{x, y}, unit.pos, range_sq)) {
-					continue;
-				}
-				result(x, y) += sign * hp;
-			}
-		}
+void Hypno::UpdateFields() {
+	ClearField(mFields.ourMinionDamage);
+	ClearField(mFields.ourTurretDamage);
+	ClearField(mFields.damage);
+	ClearField(mFields.hp);
+	for (auto& unit : mParser.Units) {
+		StampDamage(mFields.damage, unit);
+		StampHP(mFields.hp, unit);
+	}
+	for (auto& unit : GetOurMinions()) {
+		StampDamage(mFields.ourMinionDamage, unit);
 	}
+	for (auto& unit : GetOurTurrets()) {
+		StampDamage(mFields.ourTurretDamage, unit);
+	}
+}
 
-	return result;
+void Hypno::ClearField(Field& field) const {
+	auto w = static_cast<Field::size_type>(mParser.w);
+	auto h = static_cast<Field::size_type>(mParser.h);
+	if (field.width() != w || field.height() != h) {
+		field = Field{w, h, 0};
+	} else {
+		std::fill(field.begin(), field.end(), 0);
+	}
 }
 
 Matrix<double> Hypno::GetHeatMap() const {
@@ -580,15 +804,16 @@ Matrix<double> Hypno::GetTowerHeatMap() const {
 
 	static constexpr int tower = 40;
 
+	TICK_VECTOR<int> nearUnits;
 	for (const auto& enemyTurret: GetEnemyTurrets()) {
-		for (const auto& cell: GetObjectsNear(enemyTurret.pos, TURRET_RANGE_SQ))
+		for (const auto& cell: mParser.GetUnitsNear(enemyTurret.pos, TURRET_RANGE_SQ, nearUnits))
 		{
 			result[cell.pos] += enemy * tower;
 		}
 	}
 
 	for (const auto& ourTurret: GetOurTurrets()) {
-		for (const auto& cell: GetObjectsNear(ourTurret.pos, TURRET_RANGE_SQ))
+		for (const auto& cell: mParser.GetUnitsNear(ourTurret.pos, TURRET_RANGE_SQ, nearUnits))
 		{
 			result[cell.pos] -= friendly * tower;
 		}
@@ -611,7 +836,7 @@ Matrix<double> Hypno::GetUnitHeatMap() const {
 	static constexpr int hero = 10; // TODO: Make this depend on level/hp
 	static constexpr int effectWidth = 5;
 
-	std::map<Position, int> sources;
+	TICK_MAP<Position, int> sources;
 	for (const auto& ourHero: GetOurHeroes()) {
 		result[ourHero.pos] -= friendly * hero;
 		sources[ourHero.pos] = result[ourHero.pos];
@@ -643,7 +868,7 @@ Matrix<double> Hypno::GetUnitHeatMap() const {
 				}
 				auto currentPosition = Position{x, y};
 				auto distance = std::abs(
-						mDistCache.GetDist(currentPosition, source.first));
+						mDistCache->GetDist(currentPosition, source.first));
 				result[currentPosition] +=
 						(double(effectWidth - distance)/effectWidth) *
 						double(source.second);
@@ -670,67 +895,64 @@ bool Hypno::IsRightLane(const Position& pos) const {
 	return pos.x > MaxX() - 4;
 }
 
-std::vector<MAP_OBJECT> Hypno::GetTopEnemyTurrets() const {
-	return OrderByX(GetObjects([&](const MAP_OBJECT& unit) {
-		return unit.t == TURRET && unit.side == 1 && IsAtTop(unit);
-	}));
+Hypno::ObjectList Hypno::GetTopEnemyTurrets() const {
+	return OrderByX(ToVector(mUnitIndex.Get(1, TURRET, UnitIndex::LaneTop)));
 }
 
-std::vector<MAP_OBJECT> Hypno::GetDownEnemyTurrets() const {
-	return OrderByY(GetObjects([&](const MAP_OBJECT& unit) {
-		return unit.t == TURRET && unit.side == 1 && IsAtTop(unit);
-	}));
+Hypno::ObjectList Hypno::GetDownEnemyTurrets() const {
+	return OrderByY(ToVector(mUnitIndex.Get(1, TURRET, UnitIndex::LaneTop)));
 }
 
-std::vector<MAP_OBJECT> Hypno::GetMidEnemyTurrets() const {
-	return OrderByX(GetObjects([&](const MAP_OBJECT& unit) {
-		auto lane = std::abs(GetLane(unit.pos));
-		return unit.t == TURRET && unit.side == 1 && lane < 4;
-	}));
+Hypno::ObjectList Hypno::GetMidEnemyTurrets() const {
+	return OrderByX(GetMidTurrets(1));
 }
 
-std::vector<MAP_OBJECT> Hypno::GetTopOurTurrets() const {
-	return OrderByX(GetObjects([&](const MAP_OBJECT& unit) {
-		return unit.t == TURRET && unit.side == 0 && IsAtTop(unit);
-	}));
+Hypno::ObjectList Hypno::GetTopOurTurrets() const {
+	return OrderByX(ToVector(mUnitIndex.Get(0, TURRET, UnitIndex::LaneTop)));
 }
 
-std::vector<MAP_OBJECT> Hypno::GetDownOurTurrets() const {
-	return OrderByY(GetObjects([&](const MAP_OBJECT& unit) {
-		return unit.t == TURRET && unit.side == 0 && IsAtDown(unit);
-	}));
+Hypno::ObjectList Hypno::GetDownOurTurrets() const {
+	return OrderByY(ToVector(mUnitIndex.Get(0, TURRET, UnitIndex::LaneDown)));
 }
 
-std::vector<MAP_OBJECT> Hypno::GetMidOurTurrets() const {
-	return OrderByX(GetObjects([&](const MAP_OBJECT& unit) {
-		auto lane = std::abs(GetLane(unit.pos));
-		return unit.t == TURRET && unit.side == 0 && lane < 4;
-	}));
+Hypno::ObjectList Hypno::GetMidOurTurrets() const {
+	return OrderByX(GetMidTurrets(0));
 }
 
-std::vector<MAP_OBJECT> Hypno::GetTopFallbackObjects() const {
-	auto minions = GetTopMinions();
+// turrets on the diagonal, which is narrower than IsAtMid
+Hypno::ObjectList Hypno::GetMidTurrets(int side) const {
+	ObjectList vec;
+	for (auto& unit : mUnitIndex.Get(side, TURRET)) {
+		if (std::abs(GetLane(unit.pos)) < 4) {
+			vec.push_back(unit);
+		}
+	}
+	return vec;
+}
+
+Hypno::ObjectList Hypno::GetTopFallbackObjects() const {
+	auto minions = ToVector(GetTopMinions());
 	auto turrets = GetTopOurTurrets();
 	minions.insert(minions.end(), turrets.begin(), turrets.end());
 	return minions;
 }
 
-std::vector<MAP_OBJECT> Hypno::GetDownFallbackObjects() const {
-	auto minions = GetDownMinions();
+Hypno::ObjectList Hypno::GetDownFallbackObjects() const {
+	auto minions = ToVector(GetDownMinions());
 	auto turrets = GetDownOurTurrets();
 	minions.insert(minions.end(), turrets.begin(), turrets.end());
 	return minions;
 }
 
-std::vector<MAP_OBJECT> Hypno::GetMidFallbackObjects() const {
-	auto minions = GetMidMinions();
+Hypno::ObjectList Hypno::GetMidFallbackObjects() const {
+	auto minions = ToVector(GetMidMinions());
 	auto turrets = GetMidOurTurrets();
 	minions.insert(minions.end(), turrets.begin(), turrets.end());
 	return minions;
 }
 
-std::vector<MAP_OBJECT> Hypno::OrderByX(
-	std::vector<MAP_OBJECT> units, bool reverse) const
+Hypno::ObjectList Hypno::OrderByX(
+	ObjectList units, bool reverse) const
 {
 	std::sort(units.begin(), units.end(), LessByX);
 	if (reverse) {
@@ -739,8 +961,8 @@ std::vector<MAP_OBJECT> Hypno::OrderByX(
 	return units;
 }
 
-std::vector<MAP_OBJECT> Hypno::OrderByDst(
-	std::vector<MAP_OBJECT> units, bool reverse) const
+Hypno::ObjectList Hypno::OrderByDst(
+	ObjectList units, bool reverse) const
 {
 	std::sort(units.begin(), units.end(), LessByDst());
 	if (reverse) {
@@ -749,8 +971,8 @@ std::vector<MAP_OBJECT> Hypno::OrderByDst(
 	return units;
 }
 
-std::vector<MAP_OBJECT> Hypno::OrderByY(
-	 std::vector<MAP_OBJECT> units, bool reverse) const
+Hypno::ObjectList Hypno::OrderByY(
+	 ObjectList units, bool reverse) const
 {
 	std::sort(units.begin(), units.end(), LessByY);
 	if (reverse) {
@@ -775,8 +997,8 @@ Hypno::ObjectCompare Hypno::LessByDst() const {
 	return [&](const MAP_OBJECT& lhs, const MAP_OBJECT& rhs) {
 		auto target = GetEnemyBase().pos;
 		return
-			mDistCache.GetDist(lhs.pos, target) <
-			mDistCache.GetDist(rhs.pos, target);
+			mDistCache->GetDist(lhs.pos, target) <
+			mDistCache->GetDist(rhs.pos, target);
 	};
 }
 
@@ -879,50 +1101,43 @@ int Hypno::PreferLane(const MAP_OBJECT& hero) const {
 	}
 }
 
-bool Hypno::IsNearOurBase(const MAP_OBJECT& unit, int dst) const {
+bool Hypno::IsNearOurBase(const MAP_OBJECT& unit) const {
+	const int dst = mParams.nearBaseDst;
 	return unit.pos.x < dst && unit.pos.y < dst;
 }
 
 bool Hypno::IsAtTop(const MAP_OBJECT& unit) const {
 	auto pos = unit.pos;
+	const auto& p = mParams;
 	return
-		(pos.y > 12 && pos.x < 8) ||
-		(pos.y > MaxY() - 8 && pos.x < MaxX() - 12) ||
-		((pos.y > MaxY() - 8 && pos.x >= MaxX() - 12) && GetLane(unit.pos) > 5);
+		(pos.y > p.laneEntry && pos.x < p.laneWidth) ||
+		(pos.y > MaxY() - p.laneWidth && pos.x < MaxX() - p.laneCorner) ||
+		((pos.y > MaxY() - p.laneWidth && pos.x >= MaxX() - p.laneCorner) && GetLane(unit.pos) > p.laneDiagonal);
 }
 
 bool Hypno::IsAtDown(const MAP_OBJECT& unit) const {
 	auto pos = unit.pos;
+	const auto& p = mParams;
 	return
-		(pos.x > 12 && pos.y < 8) ||
-		(pos.x > MaxX() - 8 && pos.y < MaxY() - 12) ||
-		(pos.x > MaxX() - 8 && pos.y >= MaxY() - 12 && GetLane(unit.pos) < -5);
+		(pos.x > p.laneEntry && pos.y < p.laneWidth) ||
+		(pos.x > MaxX() - p.laneWidth && pos.y < MaxY() - p.laneCorner) ||
+		(pos.x > MaxX() - p.laneWidth && pos.y >= MaxY() - p.laneCorner && GetLane(unit.pos) < -p.laneDiagonal);
 }
 
 bool Hypno::IsAtMid(const MAP_OBJECT& unit) const {
 	auto pos = unit.pos;
 	return
-		(pos.x > 12 || pos.y > 12) &&
+		(pos.x > mParams.laneEntry || pos.y > mParams.laneEntry) &&
 		!IsAtTop(unit) && !IsAtDown(unit);
 }
 
 
 bool Hypno::HasTopHero() const {
-	for (auto& unit : GetOurHeroes()) {
-		if (IsAtTop(unit)) {
-			return true;
-		}
-	}
-	return false;
+	return !mUnitIndex.Get(0, HERO, UnitIndex::LaneTop).empty();
 }
 
 bool Hypno::HasDownHero() const {
-	for (auto& unit : GetOurHeroes()) {
-		if (IsAtDown(unit)) {
-			return true;
-		}
-	}
-	return false;
+	return !mUnitIndex.Get(0, HERO, UnitIndex::LaneDown).empty();
 }
 
 bool Hypno::IsEnemyInside() const {
@@ -934,35 +1149,21 @@ bool Hypno::IsEnemyInside() const {
 	return false;
 }
 
-std::vector<MAP_OBJECT> Hypno::GetTopMinions() const {
-	std::vector<MAP_OBJECT> vec;
-	for (auto& minion : GetOurMinions()) {
-		if (IsAtTop(minion)) {
-			vec.push_back(minion);
-		}
-	}
-	return vec;
+UnitIndex::Range Hypno::GetTopMinions() const {
+	return mUnitIndex.Get(0, MINION, UnitIndex::LaneTop);
 }
 
 
-std::vector<MAP_OBJECT> Hypno::GetDownMinions() const {
-	std::vector<MAP_OBJECT> vec;
-	for (auto& minion : GetOurMinions()) {
-		if (IsAtDown(minion)) {
-			vec.push_back(minion);
-		}
-	}
-	return vec;
+UnitIndex::Range Hypno::GetDownMinions() const {
+	return mUnitIndex.Get(0, MINION, UnitIndex::LaneDown);
 }
 
-std::vector<MAP_OBJECT> Hypno::GetMidMinions() const {
-	std::vector<MAP_OBJECT> vec;
-	for (auto& minion : GetOurMinions()) {
-		if (IsAtMid(minion)) {
-			vec.push_back(minion);
-		}
-	}
-	return vec;
+UnitIndex::Range Hypno::GetMidMinions() const {
+	return mUnitIndex.Get(0, MINION, UnitIndex::LaneMid);
+}
+
+Hypno::ObjectList Hypno::ToVector(const UnitIndex::Range& units) {
+	return ObjectList(units.begin(), units.end());
 }
 
 bool Hypno::IsGangOfFourHigh(const MAP_OBJECT& unit) const {
@@ -971,19 +1172,14 @@ bool Hypno::IsGangOfFourHigh(const MAP_OBJECT& unit) const {
 		return false;
 	}
 
-	std::vector<MAP_OBJECT> gof;
-	for (auto& hero : GetOurHeroes()) {
-		if (IsAtMid(hero)) {
-			gof.push_back(hero);
-		}
-	}
+	auto gof = mUnitIndex.Get(0, HERO, UnitIndex::LaneMid);
 
-	if (gof.empty() || gof.size() < 4) {
+	if (gof.empty() || gof.size() < static_cast<std::size_t>(mParams.gangSize)) {
 		// failsafe
 		return false;
 	}
 
-	int high_id = gof[0].id;
+	int high_id = gof.front().id;
 	for (auto& hero : gof) {
 		high_id = std::max(high_id, hero.id);
 	}
@@ -2,20 +2,34 @@
 #include "Client.h"
 #include "parser.h"
 #include "Matrix.h"
+#include "UnitIndex.h"
+#include "UnitHistory.h"
+#include "flowfield.h"
+#include "arena.h"
+#include "Bitboard.h"
+#include "HypnoParams.h"
+#include "sim.h"
+#include "lookahead.h"
+#include <memory>
 #include <vector>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <functional>
-#include <unordered_map>
+#include <utility>
 
 
 class Hypno : public CLIENT
 {
 public:
-	Hypno(std::string preferredOpponents="test");
+	Hypno(std::string preferredOpponents="test",
+		const HypnoParams& params = HypnoParams());
 
 protected:
-	virtual std::string GetPassword() override { return std::string("c6gR92#1"); }
+	// unit lists built while deciding, from the tick arena
+	using ObjectList = TICK_VECTOR<MAP_OBJECT>;
+
+	virtual std::string GetPassword() override { return "c6gR92#" + std::to_string(GetSlot()); }
 	virtual std::string GetPreferredOpponents() override {
 		return mPreferredOpponents;
 	}
@@ -23,74 +37,113 @@ protected:
 	virtual void Process() override;
 	void MatchEnd() override;
 	void UpdateEnemyHeroes();
-	std::map<int, int> GetMostEvilEnemyHeroes() const;
+	TICK_MAP<int, int> GetMostEvilEnemyHeroes() const;
+
+	// Process is anytime: every hero gets a baseline command first, then the
+	// heroes are decided in full one by one until PastDeadline
+	void DecideHero(const MAP_OBJECT& hero);
+	bool GetBaselineCommand(const MAP_OBJECT& hero, COMMAND& command);
 
-	void AttackMove(int hero_id, const Position& pos);
+	void AttackMove(int hero_id, const FLOW_FIELD& field);
 	void AttackTop(const MAP_OBJECT& hero);
 	void AttackDown(const MAP_OBJECT& hero);
 	void AttackMid(const MAP_OBJECT& hero);
 	void AttackInside(const MAP_OBJECT& hero);
+	// toward a lane object, or the rally point while there are too few
+	void AttackFallback(const MAP_OBJECT& hero, const ObjectList& fallbacks, const Position& rally);
 
-	Matrix<double> GetDamageMap(const std::vector<MAP_OBJECT>& units) const;
+	Matrix<double> GetDamageMap(const UnitIndex::Range& units) const;
 	Matrix<double> GetDamageMap() const;
 	Matrix<double> GetHPMap() const;
+
+	// Damage and hp fields of the whole tick, shared by every hero's
+	// FightOrFlight. Units are stamped in with mRangeStencils. Damage and hp
+	// are whole numbers, so the fields hold int32.
+	using Field = Matrix<std::int32_t>;
+	struct TickFields {
+		Field ourMinionDamage;
+		Field ourTurretDamage;
+		Field damage; // every unit but the bases
+		Field hp;
+	};
+	void UpdateFields();
+	void ClearField(Field& field) const;
+	template<typename T>
+	void StampDamage(Matrix<T>& field, const MAP_OBJECT& unit) const;
+	template<typename T>
+	void StampHP(Matrix<T>& field, const MAP_OBJECT& unit) const;
+	template<typename T>
+	void Stamp(Matrix<T>& field, const Position& center, int range_sq,
+		T value, int max_x, int max_y) const;
 	Matrix<double> GetHeatMap() const;
 	Matrix<double> GetTowerHeatMap() const;
 	Matrix<double> GetUnitHeatMap() const;
 
-	std::vector<MAP_OBJECT> GetOurTurrets() const;
-	std::vector<MAP_OBJECT> GetEnemyTurrets() const;
-	std::vector<MAP_OBJECT> GetControlledHeroes() const;
-	std::vector<MAP_OBJECT> GetHeroes(int side) const;
-	std::vector<MAP_OBJECT> GetOurHeroes() const;
-	std::vector<MAP_OBJECT> GetEnemyHeroes() const;
-	std::vector<MAP_OBJECT> GetMinions(int side) const;
-	std::vector<MAP_OBJECT> GetOurMinions() const;
-	std::vector<MAP_OBJECT> GetEnemyMinions() const;
-	std::vector<MAP_OBJECT> GetObjects(std::function<bool(const MAP_OBJECT&)> fn) const;
-	std::vector<MAP_OBJECT> GetEnemyObjects() const;
-	std::vector<MAP_OBJECT> GetOurObjects() const;
-	std::vector<MAP_OBJECT> GetEnemyObjectsNear(
+	// ranges over mUnitIndex, valid until the next Process
+	UnitIndex::Range GetOurTurrets() const;
+	UnitIndex::Range GetEnemyTurrets() const;
+	UnitIndex::Range GetControlledHeroes() const;
+	UnitIndex::Range GetHeroes(int side) const;
+	UnitIndex::Range GetOurHeroes() const;
+	UnitIndex::Range GetEnemyHeroes() const;
+	UnitIndex::Range GetMinions(int side) const;
+	UnitIndex::Range GetOurMinions() const;
+	UnitIndex::Range GetEnemyMinions() const;
+	UnitIndex::Range GetEnemyObjects() const;
+	UnitIndex::Range GetOurObjects() const;
+	ObjectList GetEnemyObjectsNear(
 		const Position& pos, int distance_sq) const;
 	MAP_OBJECT GetEnemyBase() const;
-	std::vector<MAP_OBJECT> GetObjectsNear(
+	ObjectList GetObjectsNear(
 		const Position& pos, int distance_sq) const;
 
-	std::vector<Position> GetNeighbours(const Position& pos) const;
+	TICK_VECTOR<Position> GetNeighbours(const Position& pos) const;
 	bool IsNeighbourOfCircle(
 		const Position& pos, const Position& center, int radius_sq) const;
+	bool HasUnattackedMinionNear(const Position& pos) const;
+
+	// bitboards of the arena, used while mBoardsValid (arenas up to 64x64)
+	void UpdateBoards();
+	const RangeMasks* GetRangeMasks(int range_sq) const;
 
 	bool CanOneHit(const MAP_OBJECT& unit) const;
-	Position Retreat(const Matrix<double>& dmg_map, const MAP_OBJECT& hero) const;
-	Position FightOrFlight(int hero_id) const;
+	Position Retreat(const Field& dmg_map, const MAP_OBJECT& hero) const;
+	Position FightOrFlight(int hero_id);
+
+	// the tick as a SIM_STATE for LOOKAHEAD, if mParams.lookaheadDepth > 0
+	// and the arena and units fit the simulator
+	void UpdateLookahead();
+	bool SearchAhead(const MAP_OBJECT& hero, Position& target_pos);
 
-	int GetPreferredEnemyToAttack(const std::vector<MAP_OBJECT>& enemies) const;
+	int GetPreferredEnemyToAttack(const ObjectList& enemies) const;
 
 	bool IsTopLane(const Position& pos) const;
 	bool IsLeftLane(const Position& pos) const;
 	bool IsDownLane(const Position& pos) const;
 	bool IsRightLane(const Position& pos) const;
 
-	std::vector<MAP_OBJECT> GetTopEnemyTurrets() const;
-	std::vector<MAP_OBJECT> GetDownEnemyTurrets() const;
-	std::vector<MAP_OBJECT> GetMidEnemyTurrets() const;
+	ObjectList GetTopEnemyTurrets() const;
+	ObjectList GetDownEnemyTurrets() const;
+	ObjectList GetMidEnemyTurrets() const;
+	ObjectList GetMidTurrets(int side) const;
 
-	std::vector<MAP_OBJECT> GetTopOurTurrets() const;
-	std::vector<MAP_OBJECT> GetDownOurTurrets() const;
-	std::vector<MAP_OBJECT> GetMidOurTurrets() const;
+	ObjectList GetTopOurTurrets() const;
+	ObjectList GetDownOurTurrets() const;
+	ObjectList GetMidOurTurrets() const;
 
-	std::vector<MAP_OBJECT> OrderByX(std::vector<MAP_OBJECT> units, bool reverse=false) const;
-	std::vector<MAP_OBJECT> OrderByY(std::vector<MAP_OBJECT> units, bool reverse=false) const;
-	std::vector<MAP_OBJECT> OrderByDst(std::vector<MAP_OBJECT> units, bool reverse=false) const;
+	ObjectList OrderByX(ObjectList units, bool reverse=false) const;
+	ObjectList OrderByY(ObjectList units, bool reverse=false) const;
+	ObjectList OrderByDst(ObjectList units, bool reverse=false) const;
 
-	std::vector<MAP_OBJECT> GetTopMinions() const;
-	std::vector<MAP_OBJECT> GetDownMinions() const;
-	std::vector<MAP_OBJECT> GetMidMinions() const;
+	UnitIndex::Range GetTopMinions() const;
+	UnitIndex::Range GetDownMinions() const;
+	UnitIndex::Range GetMidMinions() const;
+	static ObjectList ToVector(const UnitIndex::Range& units);
 
 	// minions + turrets on lanes
-	std::vector<MAP_OBJECT> GetTopFallbackObjects() const;
-	std::vector<MAP_OBJECT> GetDownFallbackObjects() const;
-	std::vector<MAP_OBJECT> GetMidFallbackObjects() const;
+	ObjectList GetTopFallbackObjects() const;
+	ObjectList GetDownFallbackObjects() const;
+	ObjectList GetMidFallbackObjects() const;
 
 	static bool LessByX(const MAP_OBJECT& lhs, const MAP_OBJECT& rhs);
 	static bool LessByY(const MAP_OBJECT& lhs, const MAP_OBJECT& rhs);
@@ -105,7 +158,7 @@ protected:
 	int GetLane(const Position& pos) const;
 	int GetAdvance(const Position& pos) const;
 	int PreferLane(const MAP_OBJECT& hero) const;
-	bool IsNearOurBase(const MAP_OBJECT& unit, int dst=13) const;
+	bool IsNearOurBase(const MAP_OBJECT& unit) const;
 
 	bool IsAtTop(const MAP_OBJECT& unit) const;
 	bool IsAtDown(const MAP_OBJECT& unit) const;
@@ -116,9 +169,43 @@ protected:
 
 	bool IsGangOfFourHigh(const MAP_OBJECT& unit) const;
 
-	std::unordered_map<int, int> enemy_hp_map;
-
+	// enemy hp left after the attacks ordered so far this tick, sorted by id;
+	// flat so its storage is reused from tick to tick
+	std::vector<std::pair<int, int>> enemy_hp_map;
+	int& EnemyHp(int id);
+	int EnemyHp(int id) const;
+	UnitIndex mUnitIndex;
+	TickFields mFields;
+	std::vector<std::pair<int, COMMAND>> mBaseline; // by controlled hero slot
+	bool mBoardsValid = false;
+	int mBoardWidth = 0;
+	int mBoardHeight = 0;
+	int mBoardMatchId = 0;
+	Bitboard mWalkable;
+	Bitboard mDamageExtent; // cells the damage fields cover
+	Bitboard mUnattackedEnemyMinions; // out of reach of our minions and turrets
+	std::vector<RangeMasks> mRangeMasks; // by attack range
+	// offsets IsNeighbourOfCircle accepts within the 13x13 window, by range_sq
+	static const int MaxStencilRangeSq = 25;
+	std::vector<std::vector<Position>> mRangeStencils;
+
+	// stages of Process in mLatency; heroes by their place among ours
+	static const int MaxControlledHeroes = 5;
+	LATENCY_PROFILE::STAGE mStageUnitIndex, mStageBaseline, mStageBoards, mStageFields;
+	LATENCY_PROFILE::STAGE mStageEnemyState, mStageDamageMap, mStageLookahead;
+	LATENCY_PROFILE::STAGE mStageHero[MaxControlledHeroes];
+
+	HypnoParams mParams;
+	SIMULATOR mSim;
+	bool mSimValid = false;
+	int mSimMatchId = 0;
+	std::unique_ptr<SIM_STATE> mSimRoot;
+	bool mSimRootValid = false;
+	LOOKAHEAD mLookahead;
 	std::string mPreferredOpponents;
-	std::map<int, int> mSuccesfulEnemyHeroes;
-	std::map<int, Position> mLastPositionOfMinions;
+	UnitHistory mHistory;
+	FLOW_FIELDS mFlow; // toward the goals of this tick, shared by the heroes
+	// our minions that died near each enemy hero since it last respawned,
+	// by hero id; -1 until the hero is first seen near one
+	std::vector<int> mSuccesfulEnemyHeroes;
 };
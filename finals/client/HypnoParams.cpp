@@ -0,0 +1,54 @@
+#include "HypnoParams.h"
+#include <sstream>
+
+const std::vector<HypnoParams::Entry>& HypnoParams::Entries() {
+	static const std::vector<Entry> entries = {
+		{"nearBaseDst", &HypnoParams::nearBaseDst},
+		{"laneEntry", &HypnoParams::laneEntry},
+		{"laneWidth", &HypnoParams::laneWidth},
+		{"laneCorner", &HypnoParams::laneCorner},
+		{"laneDiagonal", &HypnoParams::laneDiagonal},
+		{"outnumberMinions", &HypnoParams::outnumberMinions},
+		{"standTurns", &HypnoParams::standTurns},
+		{"minFallbacks", &HypnoParams::minFallbacks},
+		{"fallbackNearest", &HypnoParams::fallbackNearest},
+		{"gangSize", &HypnoParams::gangSize},
+		{"lookaheadDepth", &HypnoParams::lookaheadDepth},
+		{"lookaheadBeam", &HypnoParams::lookaheadBeam},
+	};
+	return entries;
+}
+
+bool HypnoParams::Set(const std::string& name, int value) {
+	for (const auto& entry : Entries()) {
+		if (name == entry.name) {
+			this->*entry.value = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HypnoParams::Get(const std::string& name, int& value) const {
+	for (const auto& entry : Entries()) {
+		if (name == entry.name) {
+			value = this->*entry.value;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string HypnoParams::ToString() const {
+	const HypnoParams defaults;
+	std::ostringstream os;
+	for (const auto& entry : Entries()) {
+		if (this->*entry.value != defaults.*entry.value) {
+			if (os.tellp() > 0) {
+				os << " ";
+			}
+			os << entry.name << " " << this->*entry.value;
+		}
+	}
+	return os.tellp() > 0 ? os.str() : "defaults";
+}
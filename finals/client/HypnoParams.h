@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// The hand tuned constants Hypno decides with. The defaults are the values
+// we played the finals with; tools can override them by name, e.g. from a
+// tournament config ("nearBaseDst 11").
+struct HypnoParams {
+	int nearBaseDst = 13; // IsNearOurBase: x and y both below this
+	int laneEntry = 12; // IsAtTop/IsAtDown/IsAtMid: past this along the edge
+	int laneWidth = 8; // how far from the edge the side lanes reach
+	int laneCorner = 12; // the far corner of a side lane, from the enemy edge
+	int laneDiagonal = 5; // in the far corner: off the diagonal by more than this
+	int outnumberMinions = 10; // FightOrFlight: stay near unattacked minions with this much hp, in minions
+	int standTurns = 2; // FightOrFlight: stay if our hp lasts this many turns of damage
+	int minFallbacks = 2; // fewer lane objects than this: go to the fixed fallback
+	int fallbackNearest = 0; // AttackTop/Mid/Down: 1 heads for the nearest lane object instead of the one furthest forward
+	int gangSize = 4; // heroes in mid before the last one leaves for a side lane
+	int lookaheadDepth = 0; // FightOrFlight: ticks of beam search, 0 keeps the one tick estimate
+	int lookaheadBeam = 8; // states kept from depth to depth
+
+	struct Entry {
+		const char* name;
+		int HypnoParams::*value;
+	};
+	static const std::vector<Entry>& Entries();
+
+	bool Set(const std::string& name, int value); // false for unknown names
+	bool Get(const std::string& name, int& value) const;
+	std::string ToString() const; // "name value" pairs, differences from the defaults only
+};
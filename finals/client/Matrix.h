@@ -3,13 +3,106 @@
 #include <ostream>
 #include <iomanip>
 #include <algorithm>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
 #include <boost/assert.hpp>
-#include <boost/operators.hpp>
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/align/assume_aligned.hpp>
+
+// Element-wise loops over matrices have no loop carried dependencies: the
+// destination may only alias an operand at the very same index.
+#if defined(__GNUC__) && !defined(__clang__)
+#define MATRIX_IVDEP _Pragma("GCC ivdep")
+#else
+#define MATRIX_IVDEP
+#endif
+
+// Anything that can be evaluated into a Matrix: Matrix itself and the lazy
+// sums and differences built by operator+ and operator-. A chain like
+// a + b - c is evaluated in one pass when it is assigned, without
+// temporaries.
+template<class E>
+class MatrixExpression {
+public:
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+template<class T> class Matrix;
+
+namespace matrix_detail {
+
+// Inner nodes are held by value, matrices as a view of their storage, so
+// an expression stays valid while the matrices it names are alive and the
+// fused loop only reads plain pointers.
+template<class T>
+class view {
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    view(const Matrix<T>& m) : data_(m.begin()), width_(m.width()), height_(m.height()) {}
+    size_type width() const { return width_; }
+    size_type height() const { return height_; }
+    const T& element(size_type i) const { return data_[i]; }
+private:
+    const T* data_;
+    size_type width_;
+    size_type height_;
+};
+
+template<class E> struct operand { typedef E type; };
+template<class T> struct operand<Matrix<T>> { typedef view<T> type; };
+
+struct plus {
+    template<class T> static T apply(const T& a, const T& b) { return a + b; }
+};
+struct minus {
+    template<class T> static T apply(const T& a, const T& b) { return a - b; }
+};
+
+template<class L, class R, class Op>
+class binary : public MatrixExpression<binary<L, R, Op>> {
+public:
+    typedef typename L::value_type value_type;
+    typedef std::size_t size_type;
+    static_assert(std::is_same<value_type, typename R::value_type>::value,
+        "Matrix : mixed element types");
+
+    binary(const L& lhs, const R& rhs) : lhs_(lhs), rhs_(rhs) {
+        BOOST_ASSERT(lhs.width() == rhs.width() && lhs.height() == rhs.height());
+    }
 
+    size_type width() const { return lhs_.width(); }
+    size_type height() const { return lhs_.height(); }
+    value_type element(size_type i) const {
+        return Op::apply(lhs_.element(i), rhs_.element(i));
+    }
+
+private:
+    const typename operand<L>::type lhs_;
+    const typename operand<R>::type rhs_;
+};
 
+} // namespace matrix_detail
+
+template<class L, class R> inline
+matrix_detail::binary<L, R, matrix_detail::plus>
+operator+(const MatrixExpression<L>& lhs, const MatrixExpression<R>& rhs) {
+    return {lhs.self(), rhs.self()};
+}
+
+template<class L, class R> inline
+matrix_detail::binary<L, R, matrix_detail::minus>
+operator-(const MatrixExpression<L>& lhs, const MatrixExpression<R>& rhs) {
+    return {lhs.self(), rhs.self()};
+}
+
+// Row-major storage aligned to 64 bytes, so fused loops start on a cache
+// line. Meant for arithmetic element types: double, or std::int32_t where
+// the values are whole numbers and twice as many fit in a vector register.
 template<class T>
-class Matrix : boost::addable<Matrix<T>> {
+class Matrix : public MatrixExpression<Matrix<T>> {
+    static_assert(std::is_arithmetic<T>::value, "Matrix : arithmetic elements only");
 public:
     typedef T               value_type;
     typedef T*              pointer;
@@ -20,12 +113,20 @@ public:
     typedef const T*        const_iterator;
     typedef std::size_t     size_type;
     typedef std::ptrdiff_t  difference_type;
+
+    static const std::size_t alignment = 64;
 public:
     Matrix();
     Matrix(const Matrix& o);
+    Matrix(Matrix&& o) noexcept;
     Matrix(size_type width, size_type height, const T& init_value = T());
+    template<class E>
+    Matrix(const MatrixExpression<E>& e);
 
     Matrix& operator=(const Matrix& o);
+    Matrix& operator=(Matrix&& o) noexcept;
+    template<class E>
+    Matrix& operator=(const MatrixExpression<E>& e);
 
     virtual ~Matrix();
 
@@ -51,28 +152,62 @@ public:
 
     size_type width() const;
     size_type height() const;
-
-    void swap(Matrix<T>& rhs);
-    Matrix& operator+=(const Matrix& o);
+    size_type size() const;
+    const_reference element(size_type i) const; // for expressions
+
+    void swap(Matrix<T>& rhs) noexcept;
+    template<class E>
+    Matrix& operator+=(const MatrixExpression<E>& e);
+    template<class E>
+    Matrix& operator-=(const MatrixExpression<E>& e);
 protected:
+    static T* allocate(size_type count);
+    static void release(T* data);
+    template<class E>
+    void evaluate(const E& e);
+
     size_type width_;
     size_type height_;
     T *data_;
 };
 
+template<class T>
+T* Matrix<T>::allocate(size_type count) {
+    void* p = boost::alignment::aligned_alloc(alignment, count * sizeof(T));
+    if ( !p ) {
+        throw std::bad_alloc();
+    }
+    return static_cast<T*>(p);
+}
+
+template<class T>
+void Matrix<T>::release(T* data) {
+    boost::alignment::aligned_free(data);
+}
+
 template<class T>
 Matrix<T>::Matrix() : width_(0), height_(0), data_(0) {}
 
 template<class T>
 Matrix<T>::Matrix(const Matrix<T>& o) : width_(o.width_), height_(o.height_) {
     if ( o.data_ ) {
-        data_ = new T[width_ * height_];
-        std::copy( o.begin(), o.end(), begin() );
+        data_ = allocate(width_ * height_);
+        std::copy( o.begin(), o.end(), data_ );
     } else {
         data_ = 0;
     }
 }
 
+template<class T>
+Matrix<T>::Matrix(Matrix<T>&& o) noexcept :
+    width_(o.width_),
+    height_(o.height_),
+    data_(o.data_) {
+    o.width_ = 0;
+    o.height_ = 0;
+    o.data_ = 0;
+}
+
 template<class T>
 Matrix<T>::Matrix(size_type width, size_type height, const T& init_value) :
     width_(width),
@@ -80,38 +215,71 @@ Matrix<T>::Matrix(size_type width, size_type height, const T& init_value) :
     if ( width_ == 0 || height_ == 0 ) {
         data_ = 0;
     } else {
-        data_ = new T[width_ * height_];
+        data_ = allocate(width_ * height_);
         std::fill(data_, data_ + (width_*height_), init_value);
     }
 }
 
+template<class T>
+template<class E>
+Matrix<T>::Matrix(const MatrixExpression<E>& e) :
+    width_(e.self().width()),
+    height_(e.self().height()) {
+    data_ = width_ == 0 || height_ == 0 ? 0 : allocate(width_ * height_);
+    evaluate(e.self());
+}
+
 template<class T>
 Matrix<T>& Matrix<T>::operator=(const Matrix<T>& o) {
     if ( this == &o ) {
         return *this;
     }
+    if ( width_ == o.width_ && height_ == o.height_ ) {
+        std::copy( o.begin(), o.end(), begin() );
+    } else {
+        Matrix<T>(o).swap(*this);
+    }
+    return *this;
+}
 
-    delete[] data_;
+template<class T>
+Matrix<T>& Matrix<T>::operator=(Matrix<T>&& o) noexcept {
+    Matrix<T>(std::move(o)).swap(*this);
+    return *this;
+}
 
-    width_ = o.width_;
-    height_ = o.height_;
-    if ( o.data_ ) {
-        data_ = new T[width_ * height_];
-        std::copy( o.begin(), o.end(), begin() );
+template<class T>
+template<class E>
+Matrix<T>& Matrix<T>::operator=(const MatrixExpression<E>& e) {
+    // the expression may name this matrix, reuse the storage only in place
+    if ( width_ == e.self().width() && height_ == e.self().height() ) {
+        evaluate(e.self());
     } else {
-        data_ = 0;
+        Matrix<T>(e).swap(*this);
     }
     return *this;
 }
 
 template<class T>
 Matrix<T>::~Matrix() {
-    delete[] data_;
+    release(data_);
+}
+
+template<class T>
+template<class E> inline
+void Matrix<T>::evaluate(const E& e) {
+    T* out = data_;
+    BOOST_ALIGN_ASSUME_ALIGNED(out, alignment);
+    const size_type n = size();
+    MATRIX_IVDEP
+    for (size_type i = 0; i < n; ++i) {
+        out[i] = e.element(i);
+    }
 }
 
 template<class T> inline
 bool Matrix<T>::operator==(const Matrix<T>& o) const {
-    return width_ == o.width_ && height_ == o.height && std::equal( data_, data_ + width_*height_, o.data_);
+    return width_ == o.width_ && height_ == o.height_ && std::equal( data_, data_ + width_*height_, o.data_);
 }
 
 template<class T> inline
@@ -196,17 +364,48 @@ typename Matrix<T>::size_type Matrix<T>::height() const {
 }
 
 template<class T> inline
-void Matrix<T>::swap(Matrix<T>& rhs) {
+typename Matrix<T>::size_type Matrix<T>::size() const {
+    return width_ * height_;
+}
+
+template<class T> inline
+typename Matrix<T>::const_reference Matrix<T>::element(size_type i) const {
+    return data_[i];
+}
+
+template<class T> inline
+void Matrix<T>::swap(Matrix<T>& rhs) noexcept {
     std::swap(width_, rhs.width_);
     std::swap(height_, rhs.height_);
     std::swap(data_, rhs.data_);
 }
 
-template<class T> inline
-Matrix<T>& Matrix<T>::operator+=(const Matrix& o) {
-	BOOST_ASSERT(width_ == o.width_ && height_ == o.height_);
-	for (std::size_t i=0; i<width_*height_; ++i) {
-		data_[i] += o.data_[i];
+template<class T>
+template<class E> inline
+Matrix<T>& Matrix<T>::operator+=(const MatrixExpression<E>& e) {
+	const E& o = e.self();
+	BOOST_ASSERT(width_ == o.width() && height_ == o.height());
+	T* out = data_;
+	BOOST_ALIGN_ASSUME_ALIGNED(out, alignment);
+	const size_type n = size();
+	MATRIX_IVDEP
+	for (size_type i = 0; i < n; ++i) {
+		out[i] += o.element(i);
+	}
+	return *this;
+}
+
+template<class T>
+template<class E> inline
+Matrix<T>& Matrix<T>::operator-=(const MatrixExpression<E>& e) {
+	const E& o = e.self();
+	BOOST_ASSERT(width_ == o.width() && height_ == o.height());
+	T* out = data_;
+	BOOST_ALIGN_ASSUME_ALIGNED(out, alignment);
+	const size_type n = size();
+	MATRIX_IVDEP
+	for (size_type i = 0; i < n; ++i) {
+		out[i] -= o.element(i);
 	}
 	return *this;
 }
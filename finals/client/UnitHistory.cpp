@@ -0,0 +1,109 @@
+#include "UnitHistory.h"
+
+UnitHistory::UnitHistory()
+{
+	const int slots = UNIT_TABLE::FIXED_ID_LIMIT + UNIT_TABLE::RESERVED_UNITS;
+	mRings.reserve(slots);
+	mTargets.reserve(slots);
+}
+
+void UnitHistory::Reset()
+{
+	for (auto& ring : mRings) {
+		ring.id = -1;
+		ring.length = 0;
+	}
+	mMatchId = -1;
+	mTick = -1;
+}
+
+void UnitHistory::Update(const PARSER& parser)
+{
+	if (parser.match_id != mMatchId || parser.tick < mTick) {
+		Reset();
+		mMatchId = parser.match_id;
+	}
+	if (parser.tick == mTick) {
+		return; // the same frame again
+	}
+	mTick = parser.tick;
+	const UNIT_TABLE& table = parser.UnitTable;
+	mTable = &table;
+	const int slots = table.SlotCount();
+	if (static_cast<int>(mRings.size()) < slots) {
+		mRings.resize(slots);
+	}
+	mTargets.assign(slots, -1);
+	for (const auto& attack : parser.Attacks) {
+		int slot = table.GetSlot(attack.attacker_id);
+		if (slot != -1) {
+			mTargets[slot] = attack.target_id;
+		}
+	}
+	for (int slot = 0; slot < slots; ++slot) {
+		Ring& ring = mRings[slot];
+		int id = table.SlotId(slot);
+		if (id != ring.id) {
+			ring.id = id;
+			ring.length = 0;
+		}
+		if (id == -1) {
+			continue;
+		}
+		const MAP_OBJECT& unit = parser.Units[table.SlotIndex(slot)];
+		ring.samples[ring.head] = Sample{mTick, unit.pos, unit.hp, mTargets[slot]};
+		ring.head = (ring.head + 1) % Depth;
+		if (ring.length < Depth) {
+			++ring.length;
+		}
+	}
+}
+
+const UnitHistory::Ring* UnitHistory::Find(int id) const
+{
+	if (mTable == nullptr) {
+		return nullptr;
+	}
+	int slot = mTable->GetSlot(id);
+	if (slot == -1 || slot >= static_cast<int>(mRings.size()) || mRings[slot].id != id) {
+		return nullptr;
+	}
+	return &mRings[slot];
+}
+
+int UnitHistory::Length(int id) const
+{
+	const Ring* ring = Find(id);
+	return ring == nullptr ? 0 : ring->length;
+}
+
+const UnitHistory::Sample* UnitHistory::Get(int id, int age) const
+{
+	const Ring* ring = Find(id);
+	if (ring == nullptr || age < 0 || age >= ring->length) {
+		return nullptr;
+	}
+	return &ring->At(age);
+}
+
+Position UnitHistory::Velocity(int id) const
+{
+	const Ring* ring = Find(id);
+	if (ring == nullptr || ring->length < 2) {
+		return Position{0, 0};
+	}
+	const Position& now = ring->At(0).pos;
+	const Position& before = ring->At(1).pos;
+	return Position{now.x - before.x, now.y - before.y};
+}
+
+int UnitHistory::LastTarget(int id) const
+{
+	const Ring* ring = Find(id);
+	for (int age = 0; ring != nullptr && age < ring->length; ++age) {
+		if (ring->At(age).target != -1) {
+			return ring->At(age).target;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "parser.h"
+#include <vector>
+
+// The last Depth ticks of every unit on the map, kept in a ring per
+// UNIT_TABLE slot: position, hp and the target of its attack that tick.
+// Update touches each slot once, lookups are a slot lookup and an index, and
+// nothing is allocated once the slots of the busiest tick exist. A slot that
+// changes hands (a minion dies, a new one gets its slot) or whose unit
+// leaves the map starts over, so a respawned hero has no past.
+class UnitHistory {
+public:
+	static const int Depth = 8;
+
+	struct Sample {
+		int tick;
+		Position pos;
+		int hp;
+		int target; // whom it attacked this tick, -1 if nobody
+	};
+
+	UnitHistory();
+	void Reset();
+	// once per tick, after PARSER::Parse; a new match starts over
+	void Update(const PARSER& parser);
+
+	// samples of the unit, 0 if it is not on the map
+	int Length(int id) const;
+	// age 0 is this tick, 1 the one before...; nullptr past Length
+	const Sample* Get(int id, int age = 0) const;
+	// cells moved since the previous sample, {0, 0} without one
+	Position Velocity(int id) const;
+	// the target of its latest attack within Depth ticks, -1 if none
+	int LastTarget(int id) const;
+
+private:
+	struct Ring {
+		int id = -1;
+		int head = 0; // where the next sample goes
+		int length = 0;
+		Sample samples[Depth];
+		const Sample& At(int age) const {
+			return samples[(head - 1 - age + 2 * Depth) % Depth];
+		}
+	};
+	const Ring* Find(int id) const;
+
+	const UNIT_TABLE* mTable = nullptr;
+	std::vector<Ring> mRings; // by slot
+	std::vector<int> mTargets; // scratch of Update, by slot
+	int mMatchId = -1;
+	int mTick = -1;
+};
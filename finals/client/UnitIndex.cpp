@@ -0,0 +1,98 @@
+#include "UnitIndex.h"
+#include <algorithm>
+
+UnitIndex::UnitIndex()
+{
+	for (auto* keys : {&mLanes, &mSideKeys, &mTypeKeys, &mLaneKeys}) {
+		keys->reserve(UNIT_TABLE::RESERVED_UNITS);
+	}
+	for (auto* order : {&mAll, &mBySide, &mByType, &mByLane}) {
+		order->reserve(UNIT_TABLE::RESERVED_UNITS);
+	}
+	mControlled.reserve(UNIT_TABLE::FIXED_ID_LIMIT);
+}
+
+void UnitIndex::CountingSort(const std::vector<std::uint8_t>& keys, int keyCount,
+	std::vector<int>& order, std::vector<int>& starts)
+{
+	starts.assign(keyCount + 1, 0);
+	for (auto key : keys) {
+		++starts[key + 1];
+	}
+	for (int k = 0; k < keyCount; ++k) {
+		starts[k + 1] += starts[k];
+	}
+	order.resize(keys.size());
+	// placing advances every start, walk them back afterwards
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		order[starts[keys[i]]++] = static_cast<int>(i);
+	}
+	for (int k = keyCount; k > 0; --k) {
+		starts[k] = starts[k - 1];
+	}
+	starts[0] = 0;
+}
+
+void UnitIndex::Partition(const std::vector<MAP_OBJECT>& units,
+	const std::vector<CONTROLLER_INFO>& controllers)
+{
+	mUnits = &units;
+	mSideKeys.resize(units.size());
+	mTypeKeys.resize(units.size());
+	mLaneKeys.resize(units.size());
+	mAll.resize(units.size());
+	mControlled.clear();
+	for (std::size_t i = 0; i < units.size(); ++i) {
+		const auto& unit = units[i];
+		int side = SideOf(unit);
+		mSideKeys[i] = static_cast<std::uint8_t>(side);
+		mTypeKeys[i] = static_cast<std::uint8_t>(TypeKey(side, unit.t));
+		mLaneKeys[i] = static_cast<std::uint8_t>(LaneKey(side, unit.t, mLanes[i]));
+		mAll[i] = static_cast<int>(i);
+		if (unit.t != HERO) {
+			continue;
+		}
+		for (auto& cc : controllers) {
+			if (cc.controller_id == 0 && cc.hero_id == unit.id) {
+				mControlled.push_back(static_cast<int>(i));
+				break;
+			}
+		}
+	}
+	CountingSort(mSideKeys, SideCount, mBySide, mSideStarts);
+	CountingSort(mTypeKeys, SideCount * TypeCount, mByType, mTypeStarts);
+	CountingSort(mLaneKeys, SideCount * TypeCount * LaneCount, mByLane, mLaneStarts);
+}
+
+UnitIndex::Range UnitIndex::MakeRange(
+	const std::vector<int>& order, int begin, int end) const
+{
+	auto units = mUnits->begin();
+	auto indices = order.data();
+	return Range(
+		SPATIAL_GRID::UNIT_ITERATOR(units, indices + begin),
+		SPATIAL_GRID::UNIT_ITERATOR(units, indices + end));
+}
+
+UnitIndex::Range UnitIndex::All() const {
+	return MakeRange(mAll, 0, static_cast<int>(mAll.size()));
+}
+
+UnitIndex::Range UnitIndex::Get(int side) const {
+	int s = side == 0 ? 0 : 1;
+	return MakeRange(mBySide, mSideStarts[s], mSideStarts[s + 1]);
+}
+
+UnitIndex::Range UnitIndex::Get(int side, UNIT_TYPE type) const {
+	int key = TypeKey(side == 0 ? 0 : 1, type);
+	return MakeRange(mByType, mTypeStarts[key], mTypeStarts[key + 1]);
+}
+
+UnitIndex::Range UnitIndex::Get(int side, UNIT_TYPE type, Lane lane) const {
+	int key = LaneKey(side == 0 ? 0 : 1, type, lane);
+	return MakeRange(mByLane, mLaneStarts[key], mLaneStarts[key + 1]);
+}
+
+UnitIndex::Range UnitIndex::GetControlledHeroes() const {
+	return MakeRange(mControlled, 0, static_cast<int>(mControlled.size()));
+}
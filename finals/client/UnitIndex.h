@@ -0,0 +1,68 @@
+#pragma once
+#include "parser.h"
+#include <vector>
+#include <cstdint>
+
+// Units of one tick partitioned once by side, type and lane, so the Hypno
+// accessors hand out ranges instead of filtering Units on every call.
+// Columns are kept per unit (lane, side, type) and the partitions are index
+// lists into Units; every range lists its units in Units order, the same
+// order the old filtered copies had.
+class UnitIndex {
+public:
+	enum Lane {
+		LaneTop,
+		LaneMid,
+		LaneDown,
+		LaneNone, // near the bases, between the lanes
+		LaneCount
+	};
+	static const int SideCount = 2; // 0 ours, everything else enemy
+	static const int TypeCount = 4;
+
+	using Range = SPATIAL_GRID::UNIT_RANGE;
+
+	UnitIndex();
+
+	// laneOf(unit) -> Lane; controlled heroes are the ones with controller_id 0
+	template<typename LaneOf>
+	void Rebuild(const std::vector<MAP_OBJECT>& units,
+		const std::vector<CONTROLLER_INFO>& controllers, LaneOf laneOf)
+	{
+		mLanes.resize(units.size());
+		for (std::size_t i = 0; i < units.size(); ++i) {
+			mLanes[i] = static_cast<std::uint8_t>(laneOf(units[i]));
+		}
+		Partition(units, controllers);
+	}
+
+	Range All() const;
+	Range Get(int side) const;
+	Range Get(int side, UNIT_TYPE type) const;
+	Range Get(int side, UNIT_TYPE type, Lane lane) const;
+	Range GetControlledHeroes() const;
+
+	Lane GetLane(int index) const { return static_cast<Lane>(mLanes[index]); }
+
+private:
+	static int SideOf(const MAP_OBJECT& unit) { return unit.side == 0 ? 0 : 1; }
+	static int TypeKey(int side, int type) { return side * TypeCount + type; }
+	static int LaneKey(int side, int type, int lane) {
+		return TypeKey(side, type) * LaneCount + lane;
+	}
+	void Partition(const std::vector<MAP_OBJECT>& units,
+		const std::vector<CONTROLLER_INFO>& controllers);
+	// stable counting sort of 0..n-1 by keys
+	static void CountingSort(const std::vector<std::uint8_t>& keys, int keyCount,
+		std::vector<int>& order, std::vector<int>& starts);
+	Range MakeRange(const std::vector<int>& order, int begin, int end) const;
+
+	const std::vector<MAP_OBJECT>* mUnits = nullptr;
+	std::vector<std::uint8_t> mLanes;
+	std::vector<std::uint8_t> mSideKeys, mTypeKeys, mLaneKeys;
+	std::vector<int> mAll;
+	std::vector<int> mBySide, mSideStarts; // key side
+	std::vector<int> mByType, mTypeStarts; // key side, type
+	std::vector<int> mByLane, mLaneStarts; // key side, type, lane
+	std::vector<int> mControlled;
+};
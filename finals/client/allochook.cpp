@@ -0,0 +1,26 @@
+#include "stdafx.h"
+#include "alloctrack.h"
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new to count allocations for ALLOC_TRACKER.
+// The array and nothrow forms end up here too.
+static const bool gHookInstalled = ALLOC_TRACKER::Install();
+
+void *operator new(std::size_t size)
+{
+	ALLOC_TRACKER::Note();
+	void *p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	free(p);
+}
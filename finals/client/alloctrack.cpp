@@ -0,0 +1,22 @@
+#include "stdafx.h"
+#include "alloctrack.h"
+
+bool ALLOC_TRACKER::sInstalled = false;
+
+static thread_local uint64_t gAllocationCount = 0;
+
+uint64_t ALLOC_TRACKER::Count()
+{
+	return gAllocationCount;
+}
+
+bool ALLOC_TRACKER::Install()
+{
+	sInstalled = true;
+	return true;
+}
+
+void ALLOC_TRACKER::Note()
+{
+	gAllocationCount++;
+}
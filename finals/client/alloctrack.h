@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// Counts heap allocations made by the calling thread, so steady state ticks
+// can be checked for "no mallocs". The counting global operator new lives in
+// allochook.cpp; it is linked into moba-bench, and into moba when configured
+// with -DMOBA_TRACK_ALLOCATIONS=ON. Without it Enabled() is false and the
+// count stays 0.
+class ALLOC_TRACKER
+{
+public:
+	static bool Enabled() { return sInstalled; }
+	static uint64_t Count(); // allocations by this thread so far
+
+	// for the hook
+	static bool Install();
+	static void Note();
+
+private:
+	static bool sInstalled;
+};
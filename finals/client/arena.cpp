@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "arena.h"
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+static thread_local TICK_ARENA *gCurrentArena = NULL;
+
+TICK_ARENA::TICK_ARENA() : mBlock(0), mOffset(0), mUsedBefore(0), mHighWater(0)
+{
+}
+
+TICK_ARENA::~TICK_ARENA()
+{
+	for (size_t i = 0; i<mBlocks.size(); i++)
+	{
+		free(mBlocks[i].data);
+	}
+}
+
+void *TICK_ARENA::Allocate(size_t size, size_t alignment)
+{
+	for (;;)
+	{
+		if (mBlock<mBlocks.size())
+		{
+			BLOCK &block = mBlocks[mBlock];
+			uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+			size_t start = ((base + mOffset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+			if (start + size <= block.size)
+			{
+				mOffset = start + size;
+				size_t used = mUsedBefore + mOffset;
+				if (used>mHighWater) mHighWater = used;
+				return block.data + start;
+			}
+			mUsedBefore += mOffset;
+			mBlock++;
+			mOffset = 0;
+			if (mBlock<mBlocks.size()) continue;
+		}
+		// only grows until the blocks cover the largest tick
+		BLOCK block;
+		block.size = size + alignment>BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+		block.data = static_cast<char *>(malloc(block.size));
+		if (block.data == NULL) throw std::bad_alloc();
+		mBlocks.push_back(block);
+	}
+}
+
+void TICK_ARENA::Reset()
+{
+	mBlock = 0;
+	mOffset = 0;
+	mUsedBefore = 0;
+}
+
+size_t TICK_ARENA::GetUsed() const
+{
+	return mUsedBefore + mOffset;
+}
+
+size_t TICK_ARENA::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (size_t i = 0; i<mBlocks.size(); i++)
+	{
+		capacity += mBlocks[i].size;
+	}
+	return capacity;
+}
+
+TICK_ARENA *TICK_ARENA::Current()
+{
+	return gCurrentArena;
+}
+
+TICK_ARENA::SCOPE::SCOPE(TICK_ARENA &arena) : mPrevious(gCurrentArena)
+{
+	gCurrentArena = &arena;
+}
+
+TICK_ARENA::SCOPE::~SCOPE()
+{
+	gCurrentArena = mPrevious;
+}
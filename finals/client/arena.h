@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstddef>
+#include <functional>
+
+// Monotonic memory for whatever one tick of decision making builds and
+// throws away. Allocation is a pointer bump into blocks that are kept
+// between ticks; Deallocate does nothing and Reset makes the whole arena
+// free again, so once the blocks cover the largest tick seen, nothing is
+// taken from the heap.
+//
+// CLIENT resets its arena at the start of every HandleServerResponse and
+// makes it the current one while the tick runs. Everything built from it
+// must be gone by the next tick.
+class TICK_ARENA
+{
+public:
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	TICK_ARENA();
+	~TICK_ARENA();
+	TICK_ARENA(const TICK_ARENA &) = delete;
+	TICK_ARENA &operator=(const TICK_ARENA &) = delete;
+
+	void *Allocate(size_t size, size_t alignment);
+	void Deallocate(void *, size_t) {}
+	void Reset();
+
+	size_t GetUsed() const; // bytes handed out since the last Reset
+	size_t GetHighWater() const { return mHighWater; } // largest GetUsed so far
+	size_t GetCapacity() const; // bytes in the blocks
+
+	// the arena of the tick running on this thread, NULL outside ticks
+	static TICK_ARENA *Current();
+
+	// makes an arena current for its lifetime
+	class SCOPE
+	{
+	public:
+		explicit SCOPE(TICK_ARENA &arena);
+		~SCOPE();
+		SCOPE(const SCOPE &) = delete;
+		SCOPE &operator=(const SCOPE &) = delete;
+	private:
+		TICK_ARENA *mPrevious;
+	};
+
+private:
+	struct BLOCK
+	{
+		char *data;
+		size_t size;
+	};
+	std::vector<BLOCK> mBlocks;
+	size_t mBlock; // block being filled
+	size_t mOffset; // first free byte in it
+	size_t mUsedBefore; // bytes handed out from the blocks before mBlock
+	size_t mHighWater;
+};
+
+// Standard allocator drawing from the arena that was current when it was
+// made. Containers made outside a tick use the heap, so they may outlive it.
+template<class T>
+class TICK_ALLOCATOR
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	TICK_ALLOCATOR() : mArena(TICK_ARENA::Current()) {}
+	template<class U>
+	TICK_ALLOCATOR(const TICK_ALLOCATOR<U> &o) : mArena(o.GetArena()) {}
+
+	T *allocate(size_t n)
+	{
+		if (mArena == NULL) return static_cast<T *>(::operator new(n * sizeof(T)));
+		return static_cast<T *>(mArena->Allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *p, size_t n)
+	{
+		if (mArena == NULL) ::operator delete(p);
+		else mArena->Deallocate(p, n * sizeof(T));
+	}
+
+	TICK_ARENA *GetArena() const { return mArena; }
+
+private:
+	TICK_ARENA *mArena;
+};
+
+template<class T, class U>
+bool operator==(const TICK_ALLOCATOR<T> &a, const TICK_ALLOCATOR<U> &b)
+{
+	return a.GetArena() == b.GetArena();
+}
+
+template<class T, class U>
+bool operator!=(const TICK_ALLOCATOR<T> &a, const TICK_ALLOCATOR<U> &b)
+{
+	return !(a == b);
+}
+
+template<class T>
+using TICK_VECTOR = std::vector<T, TICK_ALLOCATOR<T> >;
+
+template<class K, class V, class LESS = std::less<K> >
+using TICK_MAP = std::map<K, V, LESS, TICK_ALLOCATOR<std::pair<const K, V> > >;
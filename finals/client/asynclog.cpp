@@ -0,0 +1,173 @@
+#include "stdafx.h"
+#include "asynclog.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+ASYNC_LOG::ASYNC_LOG(size_t capacity)
+{
+	mCapacity = 1;
+	while (mCapacity<capacity) mCapacity <<= 1;
+	mMask = mCapacity - 1;
+	mHead = 0;
+	mCachedTail = 0;
+	mTail = 0;
+	mStop = false;
+	mDropped = 0;
+	mWritten = 0;
+	mFormat = FORMAT_TEXT;
+}
+
+ASYNC_LOG::~ASYNC_LOG()
+{
+	Close();
+}
+
+bool ASYNC_LOG::Open(const char *filename, FORMAT format)
+{
+	if (IsOpen()) return true;
+	mFile.open(filename, std::ofstream::out | std::ofstream::app | std::ofstream::binary
+#ifdef WIN32
+	, SH_DENYWR
+#endif
+	);
+	if (!mFile.is_open()) return false;
+	mFormat = format;
+	if (mFormat == FORMAT_REPLAY)
+	{
+		// a new session starts with a keyframe, a new file with the magic
+		mReplay.Reset();
+		mFile.seekp(0, std::ofstream::end);
+		if (mFile.tellp() == std::streampos(0)) mFile.write(REPLAY_FORMAT::MAGIC, REPLAY_FORMAT::MAGIC_SIZE);
+	}
+	mRing.resize(mCapacity); // clients that never log do not pay for it
+	mStop = false;
+	mWriter = std::thread([this]() { WriterLoop(); });
+	return true;
+}
+
+void ASYNC_LOG::Close()
+{
+	if (!IsOpen()) return;
+	mStop.store(true, std::memory_order_release);
+	mWriter.join();
+	mFile.close();
+}
+
+bool ASYNC_LOG::Reserve(size_t length)
+{
+	uint64_t head = mHead.load(std::memory_order_relaxed);
+	if (head + length - mCachedTail<=mRing.size()) return true;
+	mCachedTail = mTail.load(std::memory_order_acquire);
+	if (head + length - mCachedTail<=mRing.size()) return true;
+	mDropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void ASYNC_LOG::Copy(uint64_t pos, const char *data, size_t length)
+{
+	size_t offset = (size_t)(pos & mMask);
+	size_t first = std::min(length, mRing.size() - offset);
+	memcpy(&mRing[offset], data, first);
+	if (first<length) memcpy(&mRing[0], data + first, length - first);
+}
+
+void ASYNC_LOG::CopyOut(uint64_t pos, char *data, size_t length) const
+{
+	size_t offset = (size_t)(pos & mMask);
+	size_t first = std::min(length, mRing.size() - offset);
+	memcpy(data, &mRing[offset], first);
+	if (first<length) memcpy(data + first, &mRing[0], length - first);
+}
+
+bool ASYNC_LOG::WriteLines(const std::vector<LINE_VIEW> &Lines)
+{
+	if (!IsOpen()) return false;
+	RECORD_HEADER header = { 0, RECORD_LINES };
+	for (size_t i = 0; i<Lines.size(); i++)
+	{
+		header.length += (uint32_t)Lines[i].size() + 1;
+	}
+	if (!Reserve(sizeof(header) + header.length)) return false;
+	uint64_t pos = mHead.load(std::memory_order_relaxed);
+	Copy(pos, (const char *)&header, sizeof(header));
+	pos += sizeof(header);
+	for (size_t i = 0; i<Lines.size(); i++)
+	{
+		Copy(pos, Lines[i].data(), Lines[i].size());
+		pos += Lines[i].size();
+		Copy(pos, "\n", 1);
+		pos++;
+	}
+	mHead.store(pos, std::memory_order_release);
+	return true;
+}
+
+bool ASYNC_LOG::WriteSent(const char *data, size_t length)
+{
+	if (!IsOpen()) return false;
+	RECORD_HEADER header = { (uint32_t)length, RECORD_SENT };
+	if (!Reserve(sizeof(header) + header.length)) return false;
+	uint64_t pos = mHead.load(std::memory_order_relaxed);
+	Copy(pos, (const char *)&header, sizeof(header));
+	Copy(pos + sizeof(header), data, length);
+	mHead.store(pos + sizeof(header) + header.length, std::memory_order_release);
+	return true;
+}
+
+void ASYNC_LOG::WriterLoop()
+{
+	std::string batch, record;
+	std::vector<LINE_VIEW> lines;
+	for (;;)
+	{
+		// read stop first: whatever was queued before it is written
+		bool stop = mStop.load(std::memory_order_acquire);
+		uint64_t head = mHead.load(std::memory_order_acquire);
+		uint64_t tail = mTail.load(std::memory_order_relaxed);
+		if (head == tail)
+		{
+			if (stop) break;
+			std::this_thread::sleep_for(std::chrono::microseconds(IDLE_SLEEP_US));
+			continue;
+		}
+		batch.clear();
+		while (tail != head)
+		{
+			RECORD_HEADER header;
+			CopyOut(tail, (char *)&header, sizeof(header));
+			if (mFormat == FORMAT_TEXT)
+			{
+				if (header.type == RECORD_SENT) batch += "Sent: ";
+				size_t at = batch.size();
+				batch.resize(at + header.length);
+				CopyOut(tail + sizeof(header), &batch[at], header.length);
+			} else
+			{
+				record.resize(header.length);
+				if (header.length>0) CopyOut(tail + sizeof(header), &record[0], header.length);
+				if (header.type == RECORD_SENT)
+				{
+					mReplay.AddSent(record);
+				} else
+				{
+					lines.clear();
+					for (size_t begin = 0, end; begin<record.size(); begin = end + 1)
+					{
+						end = record.find('\n', begin);
+						lines.push_back(LINE_VIEW(record.data() + begin, end - begin));
+					}
+					mReplay.AddFrame(lines);
+				}
+			}
+			tail += sizeof(header) + header.length;
+		}
+		// the ring is free again before the disk is touched
+		mTail.store(tail, std::memory_order_release);
+		const std::string &out = mFormat == FORMAT_TEXT ? batch : mReplay.Buffer();
+		mFile.write(out.data(), out.size());
+		mFile.flush();
+		mWritten.fetch_add(out.size(), std::memory_order_relaxed);
+		mReplay.ClearBuffer();
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "parser.h"
+#include "replayfile.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// debug.log off the tick path. The network thread only copies the raw bytes
+// of a record into a single-producer single-consumer ring; a writer thread
+// turns the records into the debug.log text (received lines one per line,
+// answers after "Sent: ") and writes them in batches. Nothing on the
+// producer side locks, allocates, formats or touches the disk; if the ring
+// is full the record is dropped and counted instead of waiting.
+// In FORMAT_REPLAY the writer thread encodes the same records into the
+// binary replay of replayfile.h instead.
+class ASYNC_LOG
+{
+public:
+	static const size_t DEFAULT_CAPACITY = 1<<22; // bytes, a power of two
+
+	enum FORMAT
+	{
+		FORMAT_TEXT, // debug.log
+		FORMAT_REPLAY // replay.bin
+	};
+
+	explicit ASYNC_LOG(size_t capacity = DEFAULT_CAPACITY);
+	~ASYNC_LOG(); // Close
+
+	bool Open(const char *filename, FORMAT format = FORMAT_TEXT); // appends, starts the writer thread
+	bool IsOpen() const { return mWriter.joinable(); }
+	void Close(); // writes everything queued, stops the writer thread
+
+	// producer side, from one thread only; false if the record was dropped
+	bool WriteLines(const std::vector<LINE_VIEW> &Lines);
+	bool WriteSent(const std::string &Message) { return WriteSent(Message.data(), Message.size()); }
+	bool WriteSent(const char *data, size_t length);
+
+	uint64_t Dropped() const { return mDropped.load(std::memory_order_relaxed); }
+	uint64_t Written() const { return mWritten.load(std::memory_order_relaxed); } // bytes written to the file
+
+private:
+	enum RECORD_TYPE
+	{
+		RECORD_LINES, // lines, each followed by '\n'
+		RECORD_SENT // an answer as sent
+	};
+	struct RECORD_HEADER
+	{
+		uint32_t length; // of the payload
+		uint32_t type;
+	};
+	static const int IDLE_SLEEP_US = 1000; // the writer polls this often when idle
+
+	bool Reserve(size_t length); // producer: room for length bytes
+	void Copy(uint64_t pos, const char *data, size_t length); // into the ring, wrapping
+	void CopyOut(uint64_t pos, char *data, size_t length) const;
+	void WriterLoop();
+
+	size_t mCapacity;
+	std::vector<char> mRing;
+	uint64_t mMask;
+	// the producer owns mHead and caches mTail, the writer owns mTail; the
+	// padding keeps them off each other's cache line
+	std::atomic<uint64_t> mHead;
+	uint64_t mCachedTail;
+	char mPadding[64];
+	std::atomic<uint64_t> mTail;
+	std::atomic<bool> mStop;
+	std::atomic<uint64_t> mDropped;
+	std::atomic<uint64_t> mWritten;
+	std::ofstream mFile;
+	FORMAT mFormat;
+	REPLAY_WRITER mReplay; // used by the writer thread only
+	std::thread mWriter;
+};
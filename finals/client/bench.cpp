@@ -0,0 +1,860 @@
+// Offline micro benchmarks for the client's hot paths.
+//   moba-bench parse <debug.log> [passes]
+//   moba-bench distcache <map.txt> [synthetic map sizes...]
+//   moba-bench storage <map.txt> [synthetic map sizes...]
+//   moba-bench grid <debug.log> [radius_sq]
+//   moba-bench tick <map.txt> <debug.log> [passes] [budget_us]
+//   moba-bench matrix [size]
+//   moba-bench lookahead <map.txt> [depth] [beam width] [ticks]
+//   moba-bench debuglog <debug.log> [out.log]
+//   moba-bench commands [answers]
+//   moba-bench history <debug.log>
+//   moba-bench flow <map.txt>
+#include "stdafx.h"
+#include "Client.h"
+#include "parser.h"
+#include "distcache.h"
+#include "debuglog.h"
+#include "Matrix.h"
+#include "alloctrack.h"
+#include "sim.h"
+#include "lookahead.h"
+#include "asynclog.h"
+#include "UnitHistory.h"
+#include "flowfield.h"
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+
+typedef std::chrono::steady_clock CLOCK;
+
+static void PrintStats(const char *name, std::vector<double> &samples_ns)
+{
+	if (samples_ns.empty()) return;
+	std::sort(samples_ns.begin(), samples_ns.end());
+	double sum = 0;
+	for (double s : samples_ns) sum += s;
+	std::cout << name << ": " << samples_ns.size() << " samples, mean "
+		<< sum / samples_ns.size() << "ns, p50 " << samples_ns[samples_ns.size() / 2]
+		<< "ns, p99 " << samples_ns[samples_ns.size() * 99 / 100]
+		<< "ns, max " << samples_ns.back() << "ns" << std::endl;
+}
+
+// Frames are copied into one contiguous buffer first, the way FRAMER hands
+// them to the parser, so only PARSER::Parse is measured.
+static int BenchParse(const char *log_file, int passes)
+{
+	std::vector<std::vector<std::string> > frames;
+	if (!LoadDebugLogFrames(log_file, frames) || frames.empty())
+	{
+		std::cout << "no frames in " << log_file << std::endl;
+		return 1;
+	}
+	std::string arena;
+	std::vector<std::vector<std::pair<size_t, size_t> > > spans(frames.size());
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		for (const std::string &line : frames[f])
+		{
+			spans[f].push_back(std::make_pair(arena.size(), line.size()));
+			arena += line;
+			arena += '\n';
+		}
+	}
+	std::vector<std::vector<LINE_VIEW> > views(frames.size());
+	size_t units = 0;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		for (auto &span : spans[f])
+		{
+			views[f].push_back(LINE_VIEW(arena.data() + span.first, span.second));
+		}
+	}
+
+	PARSER parser;
+	for (size_t f = 0; f<views.size(); f++)
+	{
+		parser.Parse(views[f]); // warm up the unit vectors
+		units += parser.Units.size();
+	}
+	std::vector<double> samples;
+	samples.reserve(views.size() * passes);
+	uint64_t allocations_before = ALLOC_TRACKER::Count();
+	for (int pass = 0; pass<passes; pass++)
+	{
+		for (size_t f = 0; f<views.size(); f++)
+		{
+			CLOCK::time_point start = CLOCK::now();
+			parser.Parse(views[f]);
+			CLOCK::time_point end = CLOCK::now();
+			samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+		}
+	}
+	uint64_t allocations = ALLOC_TRACKER::Count() - allocations_before;
+	std::cout << frames.size() << " frames, " << double(units) / frames.size() << " units/tick avg, "
+		<< allocations << " allocations while parsing" << std::endl;
+	PrintStats("parse", samples);
+	return 0;
+}
+
+// Radius queries around every unit of the busiest ticks (the top tenth by
+// unit count, i.e. late game with many minions): the old scan of all units
+// through a std::function predicate against SPATIAL_GRID.
+static int BenchGrid(const char *log_file, int radius_sq)
+{
+	std::vector<std::vector<std::string> > frames;
+	if (!LoadDebugLogFrames(log_file, frames) || frames.empty())
+	{
+		std::cout << "no frames in " << log_file << std::endl;
+		return 1;
+	}
+	PARSER parser;
+	std::vector<std::pair<size_t, size_t> > by_units; // (units, frame)
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		std::vector<LINE_VIEW> views(frames[f].begin(), frames[f].end());
+		parser.Parse(views);
+		by_units.push_back(std::make_pair(parser.Units.size(), f));
+	}
+	std::sort(by_units.rbegin(), by_units.rend());
+	by_units.resize(std::max<size_t>(1, by_units.size() / 10));
+
+	std::vector<double> scan_samples, grid_samples, rebuild_samples;
+	TICK_VECTOR<int> near;
+	std::vector<MAP_OBJECT> scanned;
+	size_t mismatches = 0, queries = 0, found = 0;
+	for (size_t t = 0; t<by_units.size(); t++)
+	{
+		std::vector<LINE_VIEW> views(frames[by_units[t].second].begin(), frames[by_units[t].second].end());
+		parser.Parse(views);
+		const std::vector<MAP_OBJECT> &units = parser.Units;
+		CLOCK::time_point start = CLOCK::now();
+		parser.Grid.Rebuild(units, parser.w, parser.h);
+		rebuild_samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		// whole ticks are timed, single queries are too short for the clock
+		const int repeat = 20;
+		start = CLOCK::now();
+		for (size_t u = 0; u<units.size()*repeat; u++)
+		{
+			const Position &pos = units[u % units.size()].pos;
+			std::function<bool(const MAP_OBJECT&)> fn = [&](const MAP_OBJECT& obj) {
+				return pos.DistSquare(obj.pos) <= radius_sq;
+			};
+			scanned.clear();
+			for (auto& unit : units) {
+				if (fn(unit)) {
+					scanned.push_back(unit);
+				}
+			}
+			found += scanned.size();
+		}
+		CLOCK::time_point mid = CLOCK::now();
+		for (size_t u = 0; u<units.size()*repeat; u++)
+		{
+			parser.Grid.Query(units[u % units.size()].pos, radius_sq, near);
+			found -= near.size();
+		}
+		CLOCK::time_point end = CLOCK::now();
+		scan_samples.push_back(std::chrono::duration<double, std::nano>(mid - start).count() / (units.size()*repeat));
+		grid_samples.push_back(std::chrono::duration<double, std::nano>(end - mid).count() / (units.size()*repeat));
+		for (size_t u = 0; u<units.size(); u++)
+		{
+			const Position &pos = units[u].pos;
+			scanned.clear();
+			for (auto& unit : units) {
+				if (pos.DistSquare(unit.pos) <= radius_sq) {
+					scanned.push_back(unit);
+				}
+			}
+			parser.Grid.Query(pos, radius_sq, near);
+			bool same = scanned.size() == near.size();
+			for (size_t i = 0; same && i<near.size(); i++)
+			{
+				same = units[near[i]].id == scanned[i].id;
+			}
+			if (!same) mismatches++;
+			queries++;
+			found += near.size();
+		}
+	}
+	std::cout << by_units.size() << " ticks with " << by_units.back().first << "+ units, "
+		<< queries << " queries, " << double(found) / queries << " units found per query, "
+		<< mismatches << " mismatches" << std::endl;
+	PrintStats("scan per query", scan_samples);
+	PrintStats("grid per query", grid_samples);
+	PrintStats("rebuild", rebuild_samples);
+	return 0;
+}
+
+// Whole ticks as the server loop runs them: parse, Process and the command
+// text, through the default client (Hypno) with the map and distances set up.
+static int BenchTick(const char *map_file, const char *log_file, int passes, int64_t budget_us)
+{
+	std::vector<std::string> map_lines;
+	std::vector<std::vector<std::string> > frames;
+	if (!LoadLines(map_file, map_lines) || !LoadDebugLogFrames(log_file, frames) || frames.empty())
+	{
+		std::cout << "cannot read " << map_file << " or " << log_file << std::endl;
+		return 1;
+	}
+	std::unique_ptr<CLIENT> client(CreateClient());
+	client->SetTickBudget(budget_us);
+	client->mParser.ParseMap(map_lines);
+	client->UpdateDistCache(false);
+	size_t commands = 0;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		commands += client->DebugResponse(frames[f]).size(); // warm up
+	}
+	std::vector<double> samples;
+	uint64_t allocations_before = ALLOC_TRACKER::Count();
+	for (int pass = 0; pass<passes; pass++)
+	{
+		for (size_t f = 0; f<frames.size(); f++)
+		{
+			CLOCK::time_point start = CLOCK::now();
+			commands += client->DebugResponse(frames[f]).size();
+			samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		}
+	}
+	std::cout << frames.size() << " frames, " << double(ALLOC_TRACKER::Count() - allocations_before) / samples.size()
+		<< " allocations per tick" << (commands ? "" : ", no commands") << std::endl;
+	PrintStats("tick", samples);
+	client->mLatency.Print(std::cout);
+	return 0;
+}
+
+// the way boost::addable summed: copy the left side, add the right one
+template<typename T>
+static Matrix<T> AddByCopy(const Matrix<T> &a, const Matrix<T> &b)
+{
+	Matrix<T> result(a);
+	result += b;
+	return result;
+}
+
+// six damage maps summed into one, as FightOrFlight used to do per hero
+template<typename T>
+static void BenchMatrixSum(int size)
+{
+	std::vector<Matrix<T> > maps;
+	for (int m = 0; m<6; m++)
+	{
+		maps.emplace_back(size, size, T(m + 1));
+	}
+	const int reps = 2000;
+	for (int fused = 0; fused<2; fused++)
+	{
+		std::vector<double> samples;
+		T check = 0;
+		for (int r = 0; r<reps; r++)
+		{
+			CLOCK::time_point start = CLOCK::now();
+			Matrix<T> sum = fused
+				? Matrix<T>(maps[0] + maps[1] + maps[2] + maps[3] + maps[4] + maps[5])
+				: AddByCopy(AddByCopy(AddByCopy(AddByCopy(AddByCopy(maps[0], maps[1]), maps[2]), maps[3]), maps[4]), maps[5]);
+			samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+			check += sum(r % size, 0);
+		}
+		if (check != T(21 * reps)) std::cout << "wrong sum" << std::endl;
+		PrintStats(fused ? "fused" : "pairwise", samples);
+	}
+}
+
+static int BenchMatrix(int size)
+{
+	std::cout << "double" << std::endl;
+	BenchMatrixSum<double>(size);
+	std::cout << "int32" << std::endl;
+	BenchMatrixSum<int32_t>(size);
+	return 0;
+}
+
+// size x size arena with a wall border and ~20% random walls inside
+static void MakeSyntheticMap(PARSER &Parser, int size, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	Parser.w = Parser.h = size;
+	Parser.Arena.assign(size*size, PARSER::EMPTY);
+	for (int y = 0; y<size; y++)
+		for (int x = 0; x<size; x++)
+		{
+			bool border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+			if (border || rng() % 5 == 0) Parser.Arena[x + y*size] = PARSER::WALL;
+		}
+}
+
+static double TimeBuild(DISTCACHE &Cache, PARSER &Parser, DISTCACHE::BUILD_KERNEL kernel, int threads)
+{
+	CLOCK::time_point start = CLOCK::now();
+	Cache.CreateFromParser(Parser, kernel, threads);
+	return std::chrono::duration<double, std::milli>(CLOCK::now() - start).count();
+}
+
+static void BenchDistCacheMap(const char *name, PARSER &Parser)
+{
+	int cores = std::max(1u, std::thread::hardware_concurrency());
+	DISTCACHE serial, bit1, scalar_mt, bit_mt;
+	double t_serial = TimeBuild(serial, Parser, DISTCACHE::SCALAR_BFS, 1);
+	double t_bit1 = TimeBuild(bit1, Parser, DISTCACHE::BIT_PARALLEL_BFS, 1);
+	double t_scalar_mt = TimeBuild(scalar_mt, Parser, DISTCACHE::SCALAR_BFS, cores);
+	double t_bit_mt = TimeBuild(bit_mt, Parser, DISTCACHE::BIT_PARALLEL_BFS, cores);
+	size_t mismatches = 0;
+	for (int y0 = 0; y0<Parser.h; y0++)
+		for (int x0 = 0; x0<Parser.w; x0++)
+			for (int y1 = 0; y1<Parser.h; y1++)
+				for (int x1 = 0; x1<Parser.w; x1++)
+				{
+					Position p0(x0, y0), p1(x1, y1);
+					int d = serial.GetDist(p0, p1);
+					if (bit1.GetDist(p0, p1) != d || scalar_mt.GetDist(p0, p1) != d || bit_mt.GetDist(p0, p1) != d)
+					{
+						mismatches++;
+					}
+				}
+	std::cout << name << " " << Parser.w << "x" << Parser.h << ": serial " << t_serial
+		<< "ms, bit-parallel 1 thread " << t_bit1 << "ms, scalar " << cores << " threads " << t_scalar_mt
+		<< "ms, bit-parallel " << cores << " threads " << t_bit_mt << "ms, "
+		<< mismatches << " mismatches" << std::endl;
+}
+
+// Memory, build time and lookup latency of every DISTCACHE storage. Exact
+// storages are checked against TRIANGLE16, landmark bounds against it too.
+// "hot" queries go to a handful of targets, the way heroes walk to lanes and
+// bases; "random" ones to any cell, the worst case for on demand rows.
+static void BenchStorageMap(const char *name, PARSER &Parser)
+{
+	const uint64_t max_bytes = uint64_t(1) << 30;
+	std::mt19937 rng(7);
+	std::vector<Position> walkable;
+	for (int y = 0; y<Parser.h; y++)
+		for (int x = 0; x<Parser.w; x++)
+			if (Parser.GetAt(Position(x, y)) != PARSER::WALL) walkable.push_back(Position(x, y));
+	if (walkable.empty()) return;
+	uint64_t cells = uint64_t(Parser.w) * Parser.h, count = walkable.size();
+	std::vector<std::pair<Position, Position> > random_pairs(200000), hot_pairs(200000);
+	for (size_t i = 0; i<random_pairs.size(); i++)
+	{
+		random_pairs[i] = std::make_pair(walkable[rng() % count], walkable[rng() % count]);
+		hot_pairs[i] = std::make_pair(walkable[rng() % count], walkable[(rng() % 8) * 7919 % count]);
+	}
+	DISTCACHE reference;
+	bool exact_reference = count*(count + 1) <= max_bytes;
+	if (exact_reference) reference.CreateFromParser(Parser, DISTCACHE::BIT_PARALLEL_BFS, 0, DISTCACHE::TRIANGLE16);
+
+	const char *names[] = { "dense8", "triangle16", "landmarks16" };
+	const uint64_t table_bytes[] = { count*cells, count*(count + 1), DISTCACHE::LANDMARK_COUNT * cells * 2 };
+	for (int storage = DISTCACHE::DENSE8; storage<DISTCACHE::AUTO; storage++)
+	{
+		if (table_bytes[storage]>max_bytes)
+		{
+			std::cout << name << " " << Parser.w << "x" << Parser.h << " " << names[storage] << ": skipped, "
+				<< (table_bytes[storage] >> 20) << "MB" << std::endl;
+			continue;
+		}
+		DISTCACHE cache;
+		CLOCK::time_point start = CLOCK::now();
+		cache.CreateFromParser(Parser, DISTCACHE::BIT_PARALLEL_BFS, 0, (DISTCACHE::STORAGE)storage);
+		double build_ms = std::chrono::duration<double, std::milli>(CLOCK::now() - start).count();
+		// every random landmark query is a search of its own, keep them few
+		size_t random_queries = storage == DISTCACHE::LANDMARKS16 ? 200 : random_pairs.size();
+		int sink = 0;
+		start = CLOCK::now();
+		for (size_t i = 0; i<random_queries; i++) sink += cache.GetDist(random_pairs[i].first, random_pairs[i].second);
+		double random_ns = std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / random_queries;
+		start = CLOCK::now();
+		for (size_t i = 0; i<hot_pairs.size(); i++) sink += cache.GetDist(hot_pairs[i].first, hot_pairs[i].second);
+		double hot_ns = std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / hot_pairs.size();
+		std::vector<std::pair<Position, Position> > walks; // GetNextTowards needs a path
+		for (size_t i = 0; i<hot_pairs.size(); i++)
+		{
+			int d = cache.GetDist(hot_pairs[i].first, hot_pairs[i].second);
+			if (d>0 && d != cache.Unreachable()) walks.push_back(hot_pairs[i]);
+		}
+		start = CLOCK::now();
+		for (size_t i = 0; i<walks.size(); i++) sink += cache.GetNextTowards(walks[i].first, walks[i].second).x;
+		double next_ns = std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / std::max<size_t>(1, walks.size());
+		// the same steps without the next hop table
+		double search_ns = 0;
+		size_t step_mismatches = 0;
+		if (cache.HasNextHops())
+		{
+			DISTCACHE search;
+			search.CreateFromParser(Parser, DISTCACHE::BIT_PARALLEL_BFS, 0, (DISTCACHE::STORAGE)storage, false);
+			start = CLOCK::now();
+			for (size_t i = 0; i<walks.size(); i++) sink += search.GetNextTowards(walks[i].first, walks[i].second).x;
+			search_ns = std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / std::max<size_t>(1, walks.size());
+			for (size_t i = 0; i<walks.size(); i++)
+			{
+				if (search.GetNextTowards(walks[i].first, walks[i].second) != cache.GetNextTowards(walks[i].first, walks[i].second)) step_mismatches++;
+			}
+		}
+		start = CLOCK::now();
+		for (size_t i = 0; i<random_pairs.size(); i++) sink += cache.GetDistLowerBound(random_pairs[i].first, random_pairs[i].second);
+		double bound_ns = std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / random_pairs.size();
+
+		size_t mismatches = 0, bound_errors = 0, checked = 0;
+		double bound_ratio = 0;
+		if (exact_reference)
+		{
+			for (size_t i = 0; i<hot_pairs.size(); i++)
+			{
+				const Position &p0 = hot_pairs[i].first, &p1 = hot_pairs[i].second;
+				int d = reference.GetDist(p0, p1);
+				if (d == reference.Unreachable()) continue;
+				if (storage == DISTCACHE::DENSE8 && d >= 0xFF) continue; // does not fit a byte
+				checked++;
+				if (cache.GetDist(p0, p1) != d) mismatches++;
+				int bound = cache.GetDistLowerBound(p0, p1);
+				if (bound>d) bound_errors++;
+				if (d>0) bound_ratio += double(bound) / d;
+			}
+		}
+		std::cout << name << " " << Parser.w << "x" << Parser.h << " " << names[storage] << ": "
+			<< cache.GetTableBytes() / 1024 << "KB, build " << build_ms << "ms, GetDist random "
+			<< random_ns << "ns hot " << hot_ns << "ns, GetNextTowards hot " << next_ns << "ns";
+		if (cache.HasNextHops())
+		{
+			std::cout << " (search " << search_ns << "ns, " << step_mismatches << " different steps)";
+		}
+		std::cout << ", lower bound " << bound_ns << "ns";
+		if (exact_reference)
+		{
+			std::cout << ", " << mismatches << " mismatches, " << bound_errors << " bound errors, bound/dist "
+				<< (checked ? bound_ratio / checked : 0);
+		}
+		std::cout << (sink == 42 ? " " : "") << std::endl;
+	}
+}
+
+// A simulated match where each of side 0's heroes plays the first action
+// of its own search, side 1 fights back greedily.
+static int BenchLookahead(const char *map_file, int depth, int beam_width, int ticks)
+{
+	std::vector<std::string> lines;
+	if (!LoadLines(map_file, lines) || lines.empty())
+	{
+		std::cout << "cannot read " << map_file << std::endl;
+		return 1;
+	}
+	PARSER parser;
+	parser.ParseMap(lines);
+	SIMULATOR sim;
+	if (!sim.Init(parser))
+	{
+		std::cout << "the arena of " << map_file << " cannot be simulated" << std::endl;
+		return 1;
+	}
+	std::unique_ptr<SIM_STATE> state(new SIM_STATE);
+	sim.Reset(*state, 1);
+	LOOKAHEAD lookahead;
+	std::function<bool()> never = []() { return false; };
+	std::vector<COMMAND> commands[2];
+	std::vector<double> samples;
+	for (int t = 0; t<ticks && state->result == PARSER::ONGOING; t++)
+	{
+		commands[0].clear();
+		commands[1].clear();
+		for (int id = 1; id<=5; id++)
+		{
+			COMMAND first;
+			CLOCK::time_point start = CLOCK::now();
+			bool found = lookahead.Search(sim, *state, id, depth, beam_width, never, first);
+			if (!state->units[id - 1].alive) continue;
+			samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+			if (found) commands[0].push_back(first);
+		}
+		sim.GreedyCommands(*state, 1, 0, commands[1]);
+		sim.Step(*state, commands);
+	}
+	std::cout << "depth " << depth << ", beam " << beam_width << ": " << lookahead.Nodes() << " nodes in "
+		<< lookahead.Milliseconds() << "ms, " << lookahead.NodesPerMillisecond() << " nodes/ms, levels "
+		<< state->level[0] << " vs " << state->level[1] << std::endl;
+	PrintStats("search", samples);
+	return 0;
+}
+
+// What logging a frame and its answer costs the network thread: the old
+// synchronous writes with std::endl, then ASYNC_LOG. Both logs must come out
+// the same.
+static int BenchDebugLog(const char *log_file, const char *out_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	if (!LoadDebugLogFrames(log_file, frames) || frames.empty())
+	{
+		std::cout << "cannot read " << log_file << std::endl;
+		return 1;
+	}
+	std::vector<std::vector<LINE_VIEW> > views(frames.size());
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		for (size_t l = 0; l<frames[f].size(); l++) views[f].push_back(frames[f][l]);
+	}
+	const std::string answer = "tick 1\nmove 1 2 3\nattack 2 100\n.\n";
+	std::string sync_file = std::string(out_file) + ".sync";
+	remove(sync_file.c_str());
+	remove(out_file);
+	std::vector<double> samples;
+	{
+		std::ofstream sync(sync_file.c_str(), std::ofstream::out | std::ofstream::app);
+		for (size_t f = 0; f<views.size(); f++)
+		{
+			CLOCK::time_point start = CLOCK::now();
+			for (size_t l = 0; l<views[f].size(); l++) sync << views[f][l] << std::endl;
+			sync << "Sent: " << answer;
+			samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		}
+	}
+	PrintStats("ofstream + endl", samples);
+	samples.clear();
+	uint64_t dropped;
+	{
+		ASYNC_LOG log;
+		if (!log.Open(out_file))
+		{
+			std::cout << "cannot write " << out_file << std::endl;
+			return 1;
+		}
+		for (size_t f = 0; f<views.size(); f++)
+		{
+			CLOCK::time_point start = CLOCK::now();
+			log.WriteLines(views[f]);
+			log.WriteSent(answer);
+			samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		}
+		log.Close();
+		dropped = log.Dropped();
+	}
+	PrintStats("ASYNC_LOG", samples);
+	std::ifstream a(sync_file.c_str()), b(out_file);
+	std::stringstream sa, sb;
+	sa << a.rdbuf();
+	sb << b.rdbuf();
+	std::cout << frames.size() << " frames, " << dropped << " records dropped, logs "
+		<< (sa.str() == sb.str() ? "identical" : "DIFFER") << std::endl;
+	remove(sync_file.c_str());
+	return 0;
+}
+
+// the answer as CLIENT formatted it before COMMAND_WRITER, with the '\n'
+// SendMessage appended
+static std::string StreamAnswer(int tick, const std::vector<COMMAND> &Commands)
+{
+	std::stringstream ss;
+	ss << "tick "<<tick<<"\n";
+	for (size_t i = 0; i<Commands.size(); i++)
+	{
+		const COMMAND &command = Commands[i];
+		if (command.type==COMMAND::ATTACK)
+		{
+			ss << "attack " << command.hero_id << " " << command.target_id << "\n";
+		} else
+		{
+			ss << "move " << command.hero_id << " " << command.target_pos.x << " " << command.target_pos.y << "\n";
+		}
+	}
+	ss<<".";
+	return ss.str() + "\n";
+}
+
+static void WriteAnswer(COMMAND_WRITER &Writer, int tick, const std::vector<COMMAND> &Commands)
+{
+	Writer.Clear();
+	Writer.Tick(tick);
+	for (size_t i = 0; i<Commands.size(); i++)
+	{
+		const COMMAND &command = Commands[i];
+		if (command.type==COMMAND::ATTACK)
+		{
+			Writer.Attack(command.hero_id, command.target_id);
+		} else
+		{
+			Writer.Move(command.hero_id, command.target_pos.x, command.target_pos.y);
+		}
+	}
+	Writer.End();
+}
+
+static int BenchCommands(int answers)
+{
+	// random answers, a few with extreme values; moba-selftest commands
+	// checks that both formatters give the same wire bytes
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> any(INT_MIN, INT_MAX), small(-5, 200), count(0, 12);
+	std::vector<std::pair<int, std::vector<COMMAND> > > ticks(answers);
+	for (int a = 0; a<answers; a++)
+	{
+		bool extreme = a%16 == 0;
+		ticks[a].first = extreme ? any(rng) : a;
+		for (int n = count(rng); n>0; n--)
+		{
+			COMMAND command;
+			command.type = rng()%2 ? COMMAND::ATTACK : COMMAND::MOVE;
+			command.hero_id = extreme ? any(rng) : small(rng);
+			command.target_id = extreme ? any(rng) : small(rng);
+			command.target_pos = Position(extreme ? any(rng) : small(rng), extreme ? any(rng) : small(rng));
+			ticks[a].second.push_back(command);
+		}
+	}
+	ticks[0].first = INT_MIN;
+	ticks[1].first = INT_MAX;
+	COMMAND_WRITER writer;
+	std::vector<double> samples;
+	size_t bytes = 0;
+	for (int a = 0; a<answers; a++)
+	{
+		CLOCK::time_point start = CLOCK::now();
+		std::string answer = StreamAnswer(ticks[a].first, ticks[a].second);
+		std::string sent = answer; // SendMessage took it by value
+		samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		bytes += sent.size();
+	}
+	PrintStats("stringstream", samples);
+	samples.clear();
+	for (int a = 0; a<answers; a++)
+	{
+		CLOCK::time_point start = CLOCK::now();
+		WriteAnswer(writer, ticks[a].first, ticks[a].second);
+		samples.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		bytes += writer.Size();
+	}
+	PrintStats("COMMAND_WRITER", samples);
+	std::cout << answers << " answers, " << bytes << " bytes" << std::endl;
+	return 0;
+}
+
+// UnitHistory::Update per tick and a Velocity and LastTarget query per unit,
+// against std::map bookkeeping of the previous positions and the latest
+// attacks, the way the trackers were written before (moba-selftest history
+// checks that both agree).
+static int BenchHistory(const char *log_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	if (!LoadDebugLogFrames(log_file, frames) || frames.empty())
+	{
+		std::cout << "no frames in " << log_file << std::endl;
+		return 1;
+	}
+	PARSER parser;
+	UnitHistory history;
+	std::map<int, Position> last_pos;
+	std::map<int, std::pair<int, int> > last_target; // id -> (tick, target)
+	std::vector<double> update_ns, query_ns, map_ns;
+	int match_id = -1;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		std::vector<LINE_VIEW> lines(frames[f].begin(), frames[f].end());
+		parser.Parse(lines);
+		CLOCK::time_point start = CLOCK::now();
+		history.Update(parser);
+		update_ns.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+
+		start = CLOCK::now();
+		int sum = 0;
+		for (const MAP_OBJECT &unit : parser.Units)
+		{
+			Position v = history.Velocity(unit.id);
+			sum += v.x + v.y + history.LastTarget(unit.id);
+		}
+		query_ns.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+
+		start = CLOCK::now();
+		if (parser.match_id != match_id)
+		{
+			last_pos.clear();
+			last_target.clear();
+			match_id = parser.match_id;
+		}
+		std::map<int, Position> pos;
+		for (const MAP_OBJECT &unit : parser.Units) pos[unit.id] = unit.pos;
+		for (const ATTACK_INFO &attack : parser.Attacks)
+		{
+			if (pos.count(attack.attacker_id)) last_target[attack.attacker_id] = std::make_pair(parser.tick, attack.target_id);
+		}
+		map_ns.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		// units that left the map start over, like the history does
+		for (std::map<int, std::pair<int, int> >::iterator it = last_target.begin(); it != last_target.end();)
+		{
+			if (pos.count(it->first)) ++it;
+			else it = last_target.erase(it);
+		}
+		last_pos.swap(pos);
+		if (sum == 42) std::cout << ""; // keeps the queries
+	}
+	std::cout << frames.size() << " frames" << std::endl;
+	PrintStats("UnitHistory::Update", update_ns);
+	PrintStats("velocity + last target of every unit", query_ns);
+	PrintStats("std::map bookkeeping", map_ns);
+	return 0;
+}
+
+// Every walkable cell toward the goals Hypno heads for, once with the next
+// hop table and once with landmarks only, where the fields are searched
+// (moba-selftest flow checks that the fields agree with DISTCACHE).
+static int BenchFlow(const char *map_file)
+{
+	std::vector<std::string> lines;
+	if (!LoadLines(map_file, lines) || lines.empty())
+	{
+		std::cout << "cannot read " << map_file << std::endl;
+		return 1;
+	}
+	PARSER parser;
+	parser.ParseMap(lines);
+	int max_x = parser.w - 1, max_y = parser.h - 1;
+	Position goals[] = { Position(1, 11), Position(11, 1), Position(9, 9), Position(4, max_y - 4),
+		Position(max_x - 4, 4), Position(max_x - 1, max_y - 1) };
+	for (int mode = 0; mode<2; mode++)
+	{
+		std::shared_ptr<DISTCACHE> cache = std::make_shared<DISTCACHE>();
+		cache->CreateFromParser(parser, DISTCACHE::BIT_PARALLEL_BFS, 0,
+			mode == 0 ? DISTCACHE::AUTO : DISTCACHE::LANDMARKS16, mode == 0);
+		FLOW_FIELDS fields;
+		std::vector<Position> cells, walkable_goals;
+		for (int y = 0; y<cache->map_dy; y++)
+			for (int x = 0; x<cache->map_dx; x++)
+				if (cache->mMap[x + y*cache->map_dx]) cells.push_back(Position(x, y));
+		for (const Position &goal : goals)
+			if (cache->mMap[goal.x + goal.y*cache->map_dx]) walkable_goals.push_back(goal);
+		std::vector<double> direct_ns, field_ns, nearest_ns;
+		int sum = 0;
+		for (int tick = 0; tick<3; tick++)
+		{
+			fields.BeginTick(cache);
+			for (const Position &goal : walkable_goals)
+			{
+				CLOCK::time_point start = CLOCK::now();
+				for (const Position &p : cells)
+					if (!(p == goal)) sum += cache->GetNextTowards(p, goal).x;
+				direct_ns.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / cells.size());
+				start = CLOCK::now();
+				FLOW_FIELD field = fields.Toward(goal);
+				for (const Position &p : cells)
+					if (!(p == goal)) sum += field.Next(p).x;
+				field_ns.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count() / cells.size());
+			}
+			CLOCK::time_point start = CLOCK::now();
+			fields.TowardNearest(walkable_goals.data(), walkable_goals.size());
+			nearest_ns.push_back(std::chrono::duration<double, std::nano>(CLOCK::now() - start).count());
+		}
+		std::cout << (mode == 0 ? "next hop table" : "landmarks") << ": " << cells.size() << " cells, "
+			<< walkable_goals.size() << " goals, " << fields.Searches() << " searches in 3 ticks" << std::endl;
+		PrintStats("  GetNextTowards per cell", direct_ns);
+		PrintStats("  FLOW_FIELD::Next per cell", field_ns);
+		PrintStats("  multi goal search", nearest_ns);
+		if (sum == 42) std::cout << ""; // keeps the lookups
+	}
+	return 0;
+}
+
+static int BenchStorage(const char *map_file, const std::vector<int> &sizes)
+{
+	std::vector<std::string> lines;
+	if (!LoadLines(map_file, lines) || lines.empty())
+	{
+		std::cout << "cannot read " << map_file << std::endl;
+		return 1;
+	}
+	PARSER parser;
+	parser.ParseMap(lines);
+	BenchStorageMap(map_file, parser);
+	for (size_t i = 0; i<sizes.size(); i++)
+	{
+		PARSER synthetic;
+		MakeSyntheticMap(synthetic, sizes[i], 42 + i);
+		BenchStorageMap("synthetic", synthetic);
+	}
+	return 0;
+}
+
+static int BenchDistCache(const char *map_file, const std::vector<int> &sizes)
+{
+	std::vector<std::string> lines;
+	if (!LoadLines(map_file, lines) || lines.empty())
+	{
+		std::cout << "cannot read " << map_file << std::endl;
+		return 1;
+	}
+	PARSER parser;
+	parser.ParseMap(lines);
+	BenchDistCacheMap(map_file, parser);
+	for (size_t i = 0; i<sizes.size(); i++)
+	{
+		PARSER synthetic;
+		MakeSyntheticMap(synthetic, sizes[i], 42 + i);
+		BenchDistCacheMap("synthetic", synthetic);
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string what = argc>1 ? argv[1] : "";
+	if (what == "parse" && argc>2)
+	{
+		return BenchParse(argv[2], argc>3 ? atoi(argv[3]) : 20);
+	}
+	if (what == "distcache" && argc>2)
+	{
+		std::vector<int> sizes;
+		for (int i = 3; i<argc; i++) sizes.push_back(atoi(argv[i]));
+		return BenchDistCache(argv[2], sizes);
+	}
+	if (what == "grid" && argc>2)
+	{
+		return BenchGrid(argv[2], argc>3 ? atoi(argv[3]) : HERO_RANGE_SQ);
+	}
+	if (what == "tick" && argc>3)
+	{
+		return BenchTick(argv[2], argv[3], argc>4 ? atoi(argv[4]) : 3,
+			argc>5 ? atoll(argv[5]) : CLIENT::DEFAULT_TICK_BUDGET_US);
+	}
+	if (what == "matrix")
+	{
+		return BenchMatrix(argc>2 ? atoi(argv[2]) : 39);
+	}
+	if (what == "lookahead" && argc>2)
+	{
+		return BenchLookahead(argv[2], argc>3 ? atoi(argv[3]) : 3, argc>4 ? atoi(argv[4]) : 8,
+			argc>5 ? atoi(argv[5]) : 300);
+	}
+	if (what == "debuglog" && argc>2)
+	{
+		return BenchDebugLog(argv[2], argc>3 ? argv[3] : "bench-debug.log");
+	}
+	if (what == "commands")
+	{
+		return BenchCommands(argc>2 ? atoi(argv[2]) : 100000);
+	}
+	if (what == "history" && argc>2)
+	{
+		return BenchHistory(argv[2]);
+	}
+	if (what == "flow" && argc>2)
+	{
+		return BenchFlow(argv[2]);
+	}
+	if (what == "storage" && argc>2)
+	{
+		std::vector<int> sizes;
+		for (int i = 3; i<argc; i++) sizes.push_back(atoi(argv[i]));
+		return BenchStorage(argv[2], sizes);
+	}
+	std::cout << "usage: " << argv[0] << " parse <debug.log> [passes]" << std::endl;
+	std::cout << "       " << argv[0] << " distcache <map.txt> [synthetic map sizes...]" << std::endl;
+	std::cout << "       " << argv[0] << " storage <map.txt> [synthetic map sizes...]" << std::endl;
+	std::cout << "       " << argv[0] << " grid <debug.log> [radius_sq]" << std::endl;
+	std::cout << "       " << argv[0] << " tick <map.txt> <debug.log> [passes] [budget_us]" << std::endl;
+	std::cout << "       " << argv[0] << " matrix [size]" << std::endl;
+	std::cout << "       " << argv[0] << " lookahead <map.txt> [depth] [beam width] [ticks]" << std::endl;
+	std::cout << "       " << argv[0] << " debuglog <debug.log> [out.log]" << std::endl;
+	std::cout << "       " << argv[0] << " commands [answers]" << std::endl;
+	std::cout << "       " << argv[0] << " history <debug.log>" << std::endl;
+	std::cout << "       " << argv[0] << " flow <map.txt>" << std::endl;
+	return 1;
+}
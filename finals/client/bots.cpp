@@ -0,0 +1,34 @@
+#include "stdafx.h"
+#include "bots.h"
+
+void RUSH_CLIENT::Process()
+{
+	const MAP_OBJECT *pBase = mParser.GetUnitByID(12);
+	for (size_t c = 0; c<mParser.Controllers.size(); c++)
+	{
+		if (mParser.Controllers[c].controller_id != 0) continue;
+		const MAP_OBJECT *pHero = mParser.GetUnitByID(mParser.Controllers[c].hero_id);
+		if (pHero == NULL) continue; // respawning
+		const MAP_OBJECT *pTarget = NULL;
+		TICK_VECTOR<int> near_units;
+		for (const MAP_OBJECT &unit : mParser.GetUnitsNear(pHero->pos, HERO_RANGE_SQ, near_units))
+		{
+			if (unit.side == 0) continue;
+			if (pTarget == NULL || unit.hp<pTarget->hp || (unit.hp == pTarget->hp && unit.id<pTarget->id)) pTarget = &unit;
+		}
+		if (pTarget != NULL)
+		{
+			Attack(pHero->id, pTarget->id);
+		} else if (pBase != NULL && !mDistCache->Empty())
+		{
+			Move(pHero->id, mDistCache->GetNextTowards(pHero->pos, pBase->pos));
+		}
+	}
+}
+
+CLIENT *CreateBot(const std::string &name)
+{
+	if (name == "idle") return new IDLE_CLIENT;
+	if (name == "rush") return new RUSH_CLIENT;
+	return NULL;
+}
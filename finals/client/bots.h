@@ -0,0 +1,30 @@
+#pragma once
+#include "Client.h"
+#include <string>
+
+// Scripted opponents for offline matches, written the way a MYCLIENT would
+// be. They never connect, so there is no password or debug log.
+class SCRIPTED_CLIENT : public CLIENT
+{
+protected:
+	virtual std::string GetPassword() { return std::string(); }
+	virtual std::string GetPreferredOpponents() { return std::string("test"); }
+	virtual bool NeedDebugLog() { return false; }
+};
+
+// stands still
+class IDLE_CLIENT : public SCRIPTED_CLIENT
+{
+protected:
+	virtual void Process() {}
+};
+
+// shoots the weakest enemy in range, otherwise walks to the enemy base
+class RUSH_CLIENT : public SCRIPTED_CLIENT
+{
+protected:
+	virtual void Process();
+};
+
+// "idle" or "rush", NULL for other names
+CLIENT *CreateBot(const std::string &name);
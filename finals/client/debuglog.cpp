@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "debuglog.h"
+
+bool LoadLines(const char *filename, std::vector<std::string> &Lines)
+{
+	std::ifstream f(filename);
+	if (!f.is_open()) return false;
+	std::string line;
+	while (std::getline(f, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+		Lines.push_back(line);
+	}
+	return true;
+}
+
+bool LoadDebugLogFrames(const char *filename, std::vector<std::vector<std::string> > &Frames)
+{
+	std::ifstream f(filename);
+	if (!f.is_open()) return false;
+	std::string line;
+	std::vector<std::string> frame;
+	bool in_sent_block = false;
+	while (std::getline(f, line))
+	{
+		if (in_sent_block)
+		{
+			if (line == ".") in_sent_block = false;
+			continue;
+		}
+		if (line.compare(0, 6, "Sent: ") == 0)
+		{
+			// our tick answers span several lines up to the ".", pong and
+			// login are single lines
+			in_sent_block = line.compare(6, 4, "tick") == 0;
+			continue;
+		}
+		if (line.empty()) continue;
+		frame.push_back(line);
+		if (line == ".")
+		{
+			Frames.push_back(frame);
+			frame.clear();
+		}
+	}
+	return true;
+}
+
+bool LoadDebugLogAnswers(const char *filename, std::vector<std::string> &Answers)
+{
+	std::ifstream f(filename);
+	if (!f.is_open()) return false;
+	std::string line;
+	std::string answer;
+	bool in_sent_block = false;
+	while (std::getline(f, line))
+	{
+		if (!in_sent_block)
+		{
+			if (line.compare(0, 10, "Sent: tick") != 0) continue;
+			in_sent_block = true;
+			answer = line.substr(6);
+			continue;
+		}
+		answer += "\n";
+		answer += line;
+		if (line == ".")
+		{
+			Answers.push_back(answer);
+			in_sent_block = false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <vector>
+#include <string>
+
+// Every line of a text file (map.txt, a config), a trailing '\r' dropped.
+bool LoadLines(const char *filename, std::vector<std::string> &Lines);
+
+// Reads the frames the client received from a debug.log written by
+// CLIENT::Run, skipping the "Sent: ..." blocks. Every frame keeps its
+// terminating "." line, like the ServerResponse passed to the PARSER.
+bool LoadDebugLogFrames(const char *filename, std::vector<std::vector<std::string> > &Frames);
+
+// The tick answers a debug.log recorded ("Sent: tick ..." up to the "."),
+// joined the way CLIENT::DebugResponse returns them: lines separated
+// by '\n', no newline after the final ".". Pongs and match end answers are
+// skipped.
+bool LoadDebugLogAnswers(const char *filename, std::vector<std::string> &Answers);
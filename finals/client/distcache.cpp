@@ -3,138 +3,826 @@
 #include "distcache.h"
 
 #include <cstring>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <future>
 
+static const char DISTCACHE_MAGIC[8] = { 'D', 'I', 'S', 'T', 'C', 'A', 'C', 'H' };
 
+// AUTO never builds an exact table bigger than this, landmarks are used instead
+static const uint64_t MAX_TABLE_BYTES = uint64_t(256) << 20;
+
+// longest distance a storage can hold, farther cells count as unreachable
+static const int MAX_STORED_DIST8 = 0xFE;
+static const int MAX_STORED_DIST16 = 0xFFFE;
+
+// position of (i, j), i <= j, in the upper triangle of an n x n matrix
+static inline uint64_t TriIndex(uint64_t i, uint64_t j, uint64_t n)
+{
+	// row i starts after the rows of n, n-1, ..., n-i+1 items
+	return i*n - i*(i - 1)/2 + (j - i);
+}
+
+static inline size_t Pad8(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+// next hop codes, in the order GetNextTowards visits the neighbours
+static const int HOP_DX[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+static const int HOP_DY[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+
+static inline int HopCode(int dx, int dy)
+{
+	int code = (dx + 1) * 3 + (dy + 1);
+	return code>4 ? code - 1 : code;
+}
+
+// single source search into a 16 bit row, used for landmarks and on demand rows
+static void BreadthFirst16(const unsigned char *map, int dx, int dy, int source, uint16_t *row, std::vector<int32_t> &open_list)
+{
+	std::fill(row, row + size_t(dx)*dy, 0xFFFF);
+	row[source] = 0;
+	open_list.clear();
+	open_list.push_back(source);
+	for (size_t idx = 0; idx<open_list.size(); idx++)
+	{
+		int from = open_list[idx];
+		int d = row[from];
+		if (d >= MAX_STORED_DIST16) continue;
+		int x = from % dx, y = from / dx;
+		for (int ddx = -1; ddx <= 1; ddx++)
+			for (int ddy = -1; ddy <= 1; ddy++)
+			{
+				if (ddx == 0 && ddy == 0) continue;
+				int x1 = x + ddx, y1 = y + ddy;
+				if (x1<0 || x1 >= dx || y1<0 || y1 >= dy) continue;
+				int c = x1 + y1*dx;
+				if (!map[c] || row[c] != 0xFFFF) continue;
+				row[c] = d + 1;
+				open_list.push_back(c);
+			}
+	}
+}
+
+DISTCACHE::DISTCACHE()
+{
+	map_dx = map_dy = 0;
+	mMap = NULL;
+	mHeader = NULL;
+	mStorage = DENSE8;
+	mIndexOf = NULL;
+	mDist8 = NULL;
+	mDist16 = NULL;
+	mLandmarks = NULL;
+	mComponent = NULL;
+	mHops = NULL;
+	mHopStride = 0;
+	mMapping = NULL;
+	mMappingSize = 0;
+	mRowCacheClock = 0;
+}
+
+DISTCACHE::~DISTCACHE()
+{
+	Release();
+}
+
+void DISTCACHE::Release()
+{
+	if (mMapping)
+	{
+		munmap(mMapping, mMappingSize);
+		mMapping = NULL;
+		mMappingSize = 0;
+	}
+	mOwned.clear();
+	mOwned.shrink_to_fit();
+	mRowCache.clear();
+	map_dx = map_dy = 0;
+	mMap = NULL;
+	mHeader = NULL;
+	mStorage = DENSE8;
+	mIndexOf = NULL;
+	mDist8 = NULL;
+	mDist16 = NULL;
+	mLandmarks = NULL;
+	mComponent = NULL;
+	mHops = NULL;
+	mHopStride = 0;
+}
+
+size_t DISTCACHE::PayloadLayout(const DISTCACHE_HEADER &header, size_t &index_offset, size_t &landmark_offset, size_t &dist_offset, size_t &hop_offset)
+{
+	index_offset = sizeof(DISTCACHE_HEADER) + Pad8(header.cells);
+	landmark_offset = index_offset + Pad8(size_t(header.cells) * sizeof(int32_t));
+	dist_offset = landmark_offset + Pad8(size_t(header.landmarks) * sizeof(int32_t));
+	size_t dist_end = dist_offset;
+	switch (header.storage)
+	{
+	case DENSE8:
+		dist_end += size_t(header.rows) * header.cells;
+		break;
+	case TRIANGLE16:
+		dist_end += TriIndex(header.rows, header.rows, header.rows) * sizeof(uint16_t);
+		break;
+	case LANDMARKS16:
+		dist_end += size_t(header.landmarks) * header.cells * sizeof(uint16_t);
+		break;
+	}
+	hop_offset = Pad8(dist_end);
+	if (!(header.flags & NEXT_HOPS)) return dist_end;
+	// 8 more bytes, so a lookup can always read a whole word
+	return hop_offset + Pad8(size_t(header.cells) * sizeof(uint32_t)) + header.rows * HopStride(header.rows) + 8;
+}
+
+size_t DISTCACHE::GetTableBytes() const
+{
+	return Empty() ? 0 : sizeof(DISTCACHE_HEADER) + mHeader->payload_size;
+}
+
+// FNV-1a over 8 byte words, the tail bytewise
+uint64_t DISTCACHE::Checksum(const unsigned char *data, size_t size)
+{
+	uint64_t h = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		h = (h ^ word) * 1099511628211ull;
+	}
+	for (; i<size; i++)
+	{
+		h = (h ^ data[i]) * 1099511628211ull;
+	}
+	return h;
+}
+
+uint64_t DISTCACHE::HashMap(const PARSER &Parser)
+{
+	std::vector<unsigned char> bytes;
+	bytes.push_back((unsigned char)(Parser.w & 0xFF));
+	bytes.push_back((unsigned char)(Parser.w >> 8));
+	bytes.push_back((unsigned char)(Parser.h & 0xFF));
+	bytes.push_back((unsigned char)(Parser.h >> 8));
+	for (int y = 0; y<Parser.h; y++)
+		for (int x = 0; x<Parser.w; x++)
+			bytes.push_back(Parser.GetAt(Position(x, y)) == PARSER::WALL ? 0 : 1);
+	return Checksum(&bytes.front(), bytes.size());
+}
+
+bool DISTCACHE::Attach(const void *blob, size_t size)
+{
+	if (size<sizeof(DISTCACHE_HEADER)) return false;
+	const DISTCACHE_HEADER *header = (const DISTCACHE_HEADER *)blob;
+	if (memcmp(header->magic, DISTCACHE_MAGIC, sizeof(DISTCACHE_MAGIC)) != 0) return false;
+	if (header->version != VERSION || header->header_size != sizeof(DISTCACHE_HEADER)) return false;
+	if (uint64_t(header->cells) != uint64_t(header->map_dx) * header->map_dy || header->rows>header->cells) return false;
+	if (header->storage >= AUTO) return false;
+	if (header->storage == LANDMARKS16 ? header->landmarks>header->rows : header->landmarks != 0) return false;
+	if ((header->flags & ~uint32_t(NEXT_HOPS)) != 0) return false;
+	if ((header->flags & NEXT_HOPS) && header->storage == LANDMARKS16) return false;
+	size_t index_offset, landmark_offset, dist_offset, hop_offset;
+	size_t total = PayloadLayout(*header, index_offset, landmark_offset, dist_offset, hop_offset);
+	if (total != size || header->payload_size != size - sizeof(DISTCACHE_HEADER)) return false;
+	const unsigned char *bytes = (const unsigned char *)blob;
+	if (Checksum(bytes + sizeof(DISTCACHE_HEADER), header->payload_size) != header->checksum) return false;
+	mHeader = header;
+	mStorage = (STORAGE)header->storage;
+	map_dx = header->map_dx;
+	map_dy = header->map_dy;
+	mMap = bytes + sizeof(DISTCACHE_HEADER);
+	mIndexOf = (const int32_t *)(bytes + index_offset);
+	mLandmarks = header->landmarks ? (const int32_t *)(bytes + landmark_offset) : NULL;
+	mDist8 = mStorage == DENSE8 ? bytes + dist_offset : NULL;
+	mDist16 = mStorage == DENSE8 ? NULL : (const uint16_t *)(bytes + dist_offset);
+	if (header->flags & NEXT_HOPS)
+	{
+		mComponent = (const uint32_t *)(bytes + hop_offset);
+		mHops = bytes + hop_offset + Pad8(size_t(header->cells) * sizeof(uint32_t));
+		mHopStride = HopStride(header->rows);
+	}
+	if (mStorage == LANDMARKS16)
+	{
+		CACHED_ROW empty;
+		empty.target = -1;
+		empty.last_use = 0;
+		mRowCache.assign(CACHED_ROWS, empty);
+	}
+	return true;
+}
 
 bool DISTCACHE::LoadFromFile(const char * filename)
 {
-	FILE *f=fopen(filename, "rb");
-	if (f==NULL) return false;
-	unsigned char dimensions[2];
-	auto s = fread(dimensions, 1, 2, f);
-	(void)s;
-	map_dx = dimensions[0];
-	map_dy = dimensions[1];
-	mMap.resize(map_dx*map_dy);
-	mDistMap.clear();
-	mDistMap.resize(map_dx*map_dy);
-	s = fread(&mMap.front(), 1, mMap.size(), f);
-	(void)s;
-	int x, y;
-	for(y=0;y<map_dy;y++)
-		for(x=0;x<map_dx;x++)
-			if (mMap[x+y*map_dx])
-		{
-			std::vector<unsigned char> &data = mDistMap[x+y*map_dx];
-			data.resize(map_dx*map_dy);
-			s = fread(&data.front(), 1, data.size(), f);
-			(void)s;
-		}
-	fclose(f);
+	Release();
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size<(off_t)sizeof(DISTCACHE_HEADER))
+	{
+		close(fd);
+		return false;
+	}
+	void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return false;
+	mMapping = mapping;
+	mMappingSize = st.st_size;
+	if (!Attach(mapping, mMappingSize))
+	{
+		std::cout << "Ignoring " << filename << ": wrong version or corrupt" << std::endl;
+		Release();
+		return false;
+	}
 	return true;
 }
 
 void DISTCACHE::SaveToFile(const char * filename)
 {
-	FILE *f=fopen(filename, "wb");
+	if (Empty()) return;
+	// write a new file and rename it over the old one, so clients which
+	// still map the old file keep reading consistent pages
+	std::string tmp_name = std::string(filename) + ".tmp";
+	FILE *f=fopen(tmp_name.c_str(), "wb");
 	assert(f!=NULL);
-	unsigned char dimensions[2];
-	dimensions[0]=(unsigned char)map_dx;
-	dimensions[1]=(unsigned char)map_dy;
-	fwrite(dimensions, 1, 2, f);
-	fwrite(&mMap.front(), 1, mMap.size(), f);
-	int x, y;
-	for(y=0;y<map_dy;y++)
-		for(x=0;x<map_dx;x++)
-			if (mMap[x+y*map_dx])
+	size_t size = sizeof(DISTCACHE_HEADER) + mHeader->payload_size;
+	size_t written = fwrite(mHeader, 1, size, f);
+	fclose(f);
+	if (written != size || rename(tmp_name.c_str(), filename) != 0)
+	{
+		std::cout << "Error: Cannot write " << filename << "!" << std::endl;
+		remove(tmp_name.c_str());
+	}
+}
+
+std::shared_ptr<const DISTCACHE> DISTCACHE::GetShared(PARSER &Parser, const char *filename, bool save_built)
+{
+	// the lock only guards the registry: a build runs outside of it, so
+	// sessions of other maps never wait for it, and sessions of the same
+	// map wait for that build instead of starting another one
+	struct SHARED
+	{
+		int w, h;
+		uint64_t map_hash;
+		std::shared_future<std::shared_ptr<const DISTCACHE> > table;
+	};
+	static std::mutex shared_mutex;
+	static std::vector<SHARED> shared;
+	uint64_t map_hash = HashMap(Parser);
+	std::promise<std::shared_ptr<const DISTCACHE> > built;
+	std::shared_future<std::shared_ptr<const DISTCACHE> > table;
+	{
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		for (size_t i = 0; i<shared.size(); i++)
+		{
+			if (shared[i].w == Parser.w && shared[i].h == Parser.h && shared[i].map_hash == map_hash)
 			{
-				std::vector<unsigned char> &data = mDistMap[x+y*map_dx];
-				assert(!data.empty());
-				fwrite(&data.front(), 1, data.size(), f);
+				table = shared[i].table;
+				break;
 			}
-	fclose(f);
+		}
+		if (!table.valid())
+		{
+			SHARED entry = { Parser.w, Parser.h, map_hash, built.get_future().share() };
+			shared.push_back(entry);
+		}
+	}
+	if (table.valid()) return table.get(); // waits outside the lock
+	try
+	{
+		std::shared_ptr<DISTCACHE> cache = std::make_shared<DISTCACHE>();
+		if (!cache->LoadFromFile(filename) || !cache->IsValidFor(Parser))
+		{
+			cache->CreateFromParser(Parser);
+			if (save_built) cache->SaveToFile(filename);
+		}
+		built.set_value(cache);
+		return cache;
+	}
+	catch (...)
+	{
+		// forget the failed build, so the next session of the map tries again,
+		// and let the sessions waiting for it fail like this one
+		{
+			std::lock_guard<std::mutex> lock(shared_mutex);
+			for (size_t i = 0; i<shared.size(); i++)
+			{
+				if (shared[i].w == Parser.w && shared[i].h == Parser.h && shared[i].map_hash == map_hash)
+				{
+					shared.erase(shared.begin() + i);
+					break;
+				}
+			}
+		}
+		built.set_exception(std::current_exception());
+		throw;
+	}
+}
+
+bool DISTCACHE::IsValidFor(const PARSER &Parser) const
+{
+	return !Empty() && map_dx == Parser.w && map_dy == Parser.h && mHeader->map_hash == HashMap(Parser);
+}
+
+const uint16_t *DISTCACHE::GetRow16(int target) const
+{
+	CACHED_ROW *oldest = &mRowCache.front();
+	for (size_t i = 0; i<mRowCache.size(); i++)
+	{
+		CACHED_ROW &row = mRowCache[i];
+		if (row.target == target)
+		{
+			row.last_use = ++mRowCacheClock;
+			return &row.dist.front();
+		}
+		if (row.last_use<oldest->last_use) oldest = &row;
+	}
+	oldest->target = target;
+	oldest->last_use = ++mRowCacheClock;
+	oldest->dist.resize(mHeader->cells);
+	BreadthFirst16(mMap, map_dx, map_dy, target, &oldest->dist.front(), mOpenList);
+	return &oldest->dist.front();
+}
+
+int DISTCACHE::GetDistByCell(int c0, int c1) const
+{
+	switch (mStorage)
+	{
+	case DENSE8:
+		return mDist8[size_t(mIndexOf[c1]) * mHeader->cells + c0];
+	case TRIANGLE16:
+	{
+		uint64_t i = mIndexOf[c0], j = mIndexOf[c1];
+		if (i>j) std::swap(i, j);
+		return mDist16[TriIndex(i, j, mHeader->rows)];
+	}
+	default:
+	{
+		std::lock_guard<std::mutex> lock(mRowCacheMutex);
+		return GetRow16(c1)[c0];
+	}
+	}
 }
 
+int DISTCACHE::GetDist(const Position &p0, const Position &p1) const
+{
+	int c0 = p0.x+p0.y*map_dx, c1 = p1.x+p1.y*map_dx;
+	if (!mMap[c0] || !mMap[c1]) return -1;
+	return GetDistByCell(c0, c1);
+}
 
-Position DISTCACHE::GetNextTowards(const Position &p0, const Position &p1)
+// triangle inequality over the landmark rows: |d(l,a) - d(l,b)| <= d(a,b)
+int DISTCACHE::GetDistLowerBound(const Position &p0, const Position &p1) const
+{
+	if (mStorage != LANDMARKS16) return GetDist(p0, p1);
+	int c0 = p0.x+p0.y*map_dx, c1 = p1.x+p1.y*map_dx;
+	if (!mMap[c0] || !mMap[c1]) return -1;
+	int bound = 0;
+	for (uint32_t l = 0; l<mHeader->landmarks; l++)
+	{
+		const uint16_t *row = mDist16 + size_t(l) * mHeader->cells;
+		int d0 = row[c0], d1 = row[c1];
+		if (d0 == 0xFFFF && d1 == 0xFFFF) continue;
+		if (d0 == 0xFFFF || d1 == 0xFFFF) return 0xFFFF; // different components
+		bound = std::max(bound, std::abs(d0 - d1));
+	}
+	return bound;
+}
+
+Position DISTCACHE::GetNextTowards(const Position &p0, const Position &p1) const
+{
+	if (p0==p1) return Position(0,0);
+	int c0 = p0.x+p0.y*map_dx, c1 = p1.x+p1.y*map_dx;
+	if (!mMap[c0] || !mMap[c1]) return Position(0,0);
+	if (mHops && mComponent[c0] == mComponent[c1])
+	{
+		// little endian: the word read at byte bit/8 holds the code at bit%8
+		size_t bit = size_t(mIndexOf[c0]) * 3;
+		uint64_t word;
+		memcpy(&word, mHops + size_t(mIndexOf[c1]) * mHopStride + (bit >> 3), 8);
+		int hop = int(word >> (bit & 7)) & 7;
+		return Position(p0.x + HOP_DX[hop], p0.y + HOP_DY[hop]);
+	}
+	return GetNextTowardsBySearch(p0, p1);
+}
+
+Position DISTCACHE::GetNextTowardsBySearch(const Position &p0, const Position &p1) const
 {
 	if (p0==p1) return Position(0,0);
-	if (!mMap[p0.x+p0.y*map_dx] || !mMap[p1.x+p1.y*map_dx]) return Position(0,0);
-	int min_dist=0xFF;
-	int count = 0;
+	int c1 = p1.x+p1.y*map_dx;
+	if (!mMap[p0.x+p0.y*map_dx] || !mMap[c1]) return Position(0,0);
 	Position ret;
-	for(int dx=-1;dx<=1;dx++)
-		for(int dy=-1;dy<=1;dy++)
-	{
-		if (dx==0 && dy==0) continue;
-		Position p2(p0.x+dx, p0.y+dy);
-		if (!mMap[p2.x + p2.y*map_dx]) continue;
-		int d=GetDist(p2, p1);
-		assert(d>=0);
-		if (d<min_dist)
-		{
-			min_dist = d;
-			count = 1;
-			ret = p2;
-		} else if (d==min_dist)
-		{
-			count++;
-			if (((p0.x+p0.y)%count)==0)
-			{
-				ret = p2;
-			}
-		}
+	if (mStorage == LANDMARKS16)
+	{
+		// one row serves all eight neighbours, keep it for the whole loop
+		std::lock_guard<std::mutex> lock(mRowCacheMutex);
+		const uint16_t *row = GetRow16(c1);
+		ret = StepTowards(mMap, map_dx, p0, Unreachable(), [row](int c) { return int(row[c]); });
+	}
+	else
+	{
+		ret = StepTowards(mMap, map_dx, p0, Unreachable(), [this, c1](int c) { return GetDistByCell(c, c1); });
 	}
 	assert(ret.IsValid());
 	return ret;
 }
 
-void DISTCACHE::CreateFromParser(PARSER &Parser)
+// Rows of the distance table are independent, so the sources are handed out
+// to the workers in small batches from a shared counter. The batches are far
+// smaller than a worker's share, so a worker that finishes early just keeps
+// taking batches the others have not claimed yet. The table starts out all
+// unreachable (0xFF bytes), the kernels only store the cells they reach.
+struct DISTCACHE_BUILD
+{
+	int dx, dy;
+	uint32_t cells;
+	uint32_t rows;
+	const unsigned char *map;
+	const int32_t *index_of;
+	DISTCACHE::STORAGE storage;
+	unsigned char *dist8;
+	uint16_t *dist16;
+	int max_dist;
+	std::vector<int32_t> sources; // walkable cells
+	std::atomic<size_t> next_source;
+	std::atomic<bool> overflow; // some distance was longer than max_dist
+
+	void Store(int source, int cell, int level)
+	{
+		if (storage == DISTCACHE::DENSE8)
+		{
+			dist8[size_t(index_of[source]) * cells + cell] = (unsigned char)level;
+		}
+		else if (index_of[source] <= index_of[cell])
+		{
+			dist16[TriIndex(index_of[source], index_of[cell], rows)] = (uint16_t)level;
+		}
+	}
+	void ScalarWorker(size_t batch);
+	void BitParallelWorker();
+};
+
+void DISTCACHE_BUILD::ScalarWorker(size_t batch)
 {
-	map_dx = Parser.w;
-	map_dy = Parser.h;
-	mMap.resize(map_dx*map_dy);
-	mDistMap.clear();
-	mDistMap.resize(map_dx*map_dy);
+	std::vector<int> data(cells);
 	std::vector<Position> open_list;
-	int x, y;
-	for(y=0;y<map_dy;y++)
-		for(x=0;x<map_dx;x++)
-			mMap[x+y*map_dx] = Parser.GetAt(Position(x, y))==PARSER::WALL?0:1;
-	for(y=0;y<map_dy;y++)
-		for(x=0;x<map_dx;x++)
-			if (mMap[x+y*map_dx])
+	for (;;)
+	{
+		size_t begin = next_source.fetch_add(batch);
+		if (begin >= sources.size()) return;
+		size_t end = std::min(begin + batch, sources.size());
+		for (size_t s = begin; s<end; s++)
+		{
+			int x = sources[s] % dx, y = sources[s] / dx;
+			std::fill(data.begin(), data.end(), -1);
+			data[x+y*dx]=0;
+			Store(sources[s], x+y*dx, 0);
+			open_list.clear();
+			open_list.push_back(Position(x,y));
+			unsigned int idx;
+			for(idx=0;idx<open_list.size();idx++)
 			{
-				std::vector<unsigned char> &data = mDistMap[x+y*map_dx];
-				data.resize(map_dx*map_dy);
-				memset(&data.front(), 0xFF, data.size());
-				data[x+y*map_dx]=0;
-				open_list.clear();
-				open_list.push_back(Position(x,y));
-				unsigned int idx;
-				for(idx=0;idx<open_list.size();idx++)
+				Position from = open_list[idx];
+				int d = data[from.x+from.y*dx];
+				assert(d!=-1);
+				for(int ddx=-1;ddx<=1;ddx++)
+					for(int ddy=-1;ddy<=1;ddy++)
 				{
-					Position from = open_list[idx];
-					int dist = data[from.x+from.y*map_dx];
-					assert(dist!=0xFF);
-					for(int dx=-1;dx<=1;dx++)
-						for(int dy=-1;dy<=1;dy++)
+					if (ddx==0 && ddy==0) continue;
+					Position p1(from.x+ddx, from.y+ddy);
+					if (p1.x<0 || p1.x>=dx || p1.y<0 || p1.y>=dy) continue;
+					if (!map[p1.x + p1.y*dx]) continue;
+					if (data[p1.x+p1.y*dx]==-1)
 					{
-						if (dx==0 && dy==0) continue;
-						Position p1(from.x+dx, from.y+dy);
-						if (!mMap[p1.x + p1.y*map_dx]) continue;
-						if (data[p1.x+p1.y*map_dx]==0xFF)
+						if (d >= max_dist)
 						{
-							data[p1.x+p1.y*map_dx]=dist+1;
-							open_list.push_back(p1);
+							overflow = true;
+							continue;
 						}
+						data[p1.x+p1.y*dx]=d+1;
+						Store(sources[s], p1.x+p1.y*dx, d+1);
+						open_list.push_back(p1);
 					}
 				}
 			}
+		}
+	}
 }
 
-int DISTCACHE::GetDist(const Position &p0, const Position &p1) const
+// Breadth first search from 64 sources at once: bit k of a cell's mask
+// belongs to source k. A level expands all of them with a few ORs per cell
+// on a grid padded with an empty border, so no bounds checks are needed.
+void DISTCACHE_BUILD::BitParallelWorker()
+{
+	const int pw = dx + 2;
+	const size_t padded = size_t(pw) * (dy + 2);
+	std::vector<uint64_t> visited(padded), frontier(padded), next(padded);
+	std::vector<int32_t> walkable; // padded index of every walkable cell
+	std::vector<int32_t> cell_of; // and its unpadded index
+	for (int y = 0; y<dy; y++)
+		for (int x = 0; x<dx; x++)
+			if (map[x+y*dx])
+			{
+				walkable.push_back((x+1) + (y+1)*pw);
+				cell_of.push_back(x+y*dx);
+			}
+	for (;;)
+	{
+		size_t begin = next_source.fetch_add(64);
+		if (begin >= sources.size()) return;
+		int count = int(std::min<size_t>(64, sources.size() - begin));
+		const int32_t *batch = &sources[begin];
+		std::fill(visited.begin(), visited.end(), 0);
+		std::fill(frontier.begin(), frontier.end(), 0);
+		for (int k = 0; k<count; k++)
+		{
+			int c = batch[k];
+			Store(c, c, 0);
+			int pc = (c % dx + 1) + (c / dx + 1)*pw;
+			visited[pc] |= uint64_t(1) << k;
+			frontier[pc] |= uint64_t(1) << k;
+		}
+		for (int level = 1; ; level++)
+		{
+			uint64_t any = 0;
+			for (size_t i = 0; i<walkable.size(); i++)
+			{
+				int pc = walkable[i];
+				uint64_t m =
+					frontier[pc-pw-1] | frontier[pc-pw] | frontier[pc-pw+1] |
+					frontier[pc-1] | frontier[pc+1] |
+					frontier[pc+pw-1] | frontier[pc+pw] | frontier[pc+pw+1];
+				m &= ~visited[pc];
+				next[pc] = m;
+				any |= m;
+			}
+			if (!any) break;
+			if (level>max_dist)
+			{
+				overflow = true;
+				break;
+			}
+			for (size_t i = 0; i<walkable.size(); i++)
+			{
+				uint64_t m = next[walkable[i]];
+				if (!m) continue;
+				visited[walkable[i]] |= m;
+				int c = cell_of[i];
+				while (m)
+				{
+					int k = __builtin_ctzll(m);
+					m &= m - 1;
+					Store(batch[k], c, level);
+				}
+			}
+			frontier.swap(next);
+		}
+	}
+}
+
+// Landmarks are picked farthest point first: each is the cell farthest from
+// the ones already picked, the first one is the cell farthest from the first
+// walkable cell. Their rows double as the scratch space of the search.
+static void BuildLandmarks(const unsigned char *map, int dx, int dy, uint32_t count, int32_t *landmarks, uint16_t *dist)
 {
-	if (!mMap[p0.x+p0.y*map_dx] || !mMap[p1.x+p1.y*map_dx]) return -1;
-	return mDistMap[p1.x+p1.y*map_dx][p0.x+p0.y*map_dx];
+	size_t cells = size_t(dx)*dy;
+	std::vector<int32_t> open_list;
+	std::vector<uint16_t> closest(cells, 0xFFFF);
+	int next = -1;
+	for (size_t c = 0; c<cells && next == -1; c++)
+	{
+		if (map[c]) next = int(c);
+	}
+	if (next == -1) return;
+	BreadthFirst16(map, dx, dy, next, dist, open_list);
+	next = open_list.back(); // searches end on the farthest cell
+	for (uint32_t l = 0; l<count; l++)
+	{
+		landmarks[l] = next;
+		uint16_t *row = dist + size_t(l) * cells;
+		BreadthFirst16(map, dx, dy, next, row, open_list);
+		int farthest = -1;
+		for (size_t c = 0; c<cells; c++)
+		{
+			if (!map[c]) continue;
+			closest[c] = std::min(closest[c], row[c]);
+			if (closest[c] == 0xFFFF) continue; // not connected to any landmark yet
+			if (farthest<closest[c])
+			{
+				farthest = closest[c];
+				next = int(c);
+			}
+		}
+	}
+}
+
+// Components first, so pairs without a path keep going through the search
+// (and its assert). Every target row is filled by one worker, the rows are
+// whole words, so the workers never share a word.
+void DISTCACHE::BuildNextHops(int threads, uint32_t *component, unsigned char *hops) const
+{
+	size_t cells = size_t(map_dx) * map_dy;
+	std::vector<int32_t> open_list;
+	std::vector<int32_t> cell_of;
+	std::fill(component, component + cells, ~uint32_t(0));
+	uint32_t components = 0;
+	for (size_t c = 0; c<cells; c++)
+	{
+		if (!mMap[c]) continue;
+		cell_of.push_back(int32_t(c));
+		if (component[c] != ~uint32_t(0)) continue;
+		component[c] = components;
+		open_list.assign(1, int32_t(c));
+		for (size_t idx = 0; idx<open_list.size(); idx++)
+		{
+			int x = open_list[idx] % map_dx, y = open_list[idx] / map_dx;
+			for (int ddx = -1; ddx <= 1; ddx++)
+				for (int ddy = -1; ddy <= 1; ddy++)
+				{
+					int x1 = x + ddx, y1 = y + ddy;
+					if (x1<0 || x1 >= map_dx || y1<0 || y1 >= map_dy) continue;
+					int c1 = x1 + y1*map_dx;
+					if (!mMap[c1] || component[c1] != ~uint32_t(0)) continue;
+					component[c1] = components;
+					open_list.push_back(c1);
+				}
+		}
+		components++;
+	}
+
+	std::atomic<size_t> next_target(0);
+	auto worker = [&]()
+	{
+		std::vector<uint64_t> words(mHopStride / 8);
+		std::vector<int> dist(cells);
+		auto dist_at = [&dist](int c) { return dist[c]; };
+		for (;;)
+		{
+			size_t target = next_target.fetch_add(1);
+			if (target >= cell_of.size()) return;
+			// the row of the target once, instead of eight lookups per cell
+			for (size_t from = 0; from<cell_of.size(); from++)
+			{
+				dist[cell_of[from]] = GetDistByCell(cell_of[from], cell_of[target]);
+			}
+			std::fill(words.begin(), words.end(), 0);
+			for (size_t from = 0; from<cell_of.size(); from++)
+			{
+				if (from == target || component[cell_of[from]] != component[cell_of[target]]) continue;
+				Position p0(cell_of[from] % map_dx, cell_of[from] / map_dx);
+				Position step = StepTowards(mMap, map_dx, p0, Unreachable(), dist_at);
+				assert(step.IsValid());
+				uint64_t code = HopCode(step.x - p0.x, step.y - p0.y);
+				size_t bit = from * 3;
+				words[bit >> 6] |= code << (bit & 63);
+				if ((bit & 63)>61) words[(bit >> 6) + 1] |= code >> (64 - (bit & 63));
+			}
+			memcpy(hops + target * mHopStride, &words.front(), mHopStride);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int t = 0; t<threads; t++)
+	{
+		workers.push_back(std::thread(worker));
+	}
+	for (size_t t = 0; t<workers.size(); t++)
+	{
+		workers[t].join();
+	}
+}
+
+bool DISTCACHE::Build(PARSER &Parser, BUILD_KERNEL kernel, int threads, STORAGE storage, bool next_hops)
+{
+	Release();
+	uint32_t dx = Parser.w, dy = Parser.h;
+	uint32_t cells = dx*dy;
+	std::vector<unsigned char> walkable(cells);
+	uint32_t rows = 0;
+	int x, y;
+	for(y=0;y<(int)dy;y++)
+		for(x=0;x<(int)dx;x++)
+		{
+			walkable[x+y*dx] = Parser.GetAt(Position(x, y))==PARSER::WALL?0:1;
+			rows += walkable[x+y*dx];
+		}
+
+	DISTCACHE_HEADER layout;
+	memset(&layout, 0, sizeof(layout));
+	layout.cells = cells;
+	layout.rows = rows;
+	layout.storage = storage;
+	layout.landmarks = storage == LANDMARKS16 ? std::min<uint32_t>(LANDMARK_COUNT, rows) : 0;
+	size_t index_offset, landmark_offset, dist_offset, hop_offset;
+	size_t dist_end = PayloadLayout(layout, index_offset, landmark_offset, dist_offset, hop_offset);
+	next_hops = next_hops && storage != LANDMARKS16;
+	layout.flags = next_hops ? NEXT_HOPS : 0;
+	size_t total = PayloadLayout(layout, index_offset, landmark_offset, dist_offset, hop_offset);
+	mOwned.assign((total + 7) / 8, 0);
+	unsigned char *blob = (unsigned char *)&mOwned.front();
+	DISTCACHE_HEADER *header = (DISTCACHE_HEADER *)blob;
+	*header = layout;
+	memcpy(header->magic, DISTCACHE_MAGIC, sizeof(DISTCACHE_MAGIC));
+	header->version = VERSION;
+	header->header_size = sizeof(DISTCACHE_HEADER);
+	header->map_dx = dx;
+	header->map_dy = dy;
+	header->map_hash = HashMap(Parser);
+	// the next hops are added once the distances can be read
+	header->flags = 0;
+	header->payload_size = dist_end - sizeof(DISTCACHE_HEADER);
+
+	unsigned char *map = blob + sizeof(DISTCACHE_HEADER);
+	int32_t *index_of = (int32_t *)(blob + index_offset);
+	memcpy(map, &walkable.front(), cells);
+	int32_t row = 0;
+	for (uint32_t c = 0; c<cells; c++)
+	{
+		index_of[c] = walkable[c] ? row++ : -1;
+	}
+	memset(blob + dist_offset, 0xFF, dist_end - dist_offset);
+
+	if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	bool overflow = false;
+	if (storage == LANDMARKS16)
+	{
+		BuildLandmarks(map, dx, dy, header->landmarks, (int32_t *)(blob + landmark_offset), (uint16_t *)(blob + dist_offset));
+	}
+	else
+	{
+		DISTCACHE_BUILD build;
+		build.dx = dx;
+		build.dy = dy;
+		build.cells = cells;
+		build.rows = rows;
+		build.map = map;
+		build.index_of = index_of;
+		build.storage = storage;
+		build.dist8 = storage == DENSE8 ? blob + dist_offset : NULL;
+		build.dist16 = storage == DENSE8 ? NULL : (uint16_t *)(blob + dist_offset);
+		build.max_dist = storage == DENSE8 ? MAX_STORED_DIST8 : MAX_STORED_DIST16;
+		for (uint32_t c = 0; c<cells; c++)
+		{
+			if (map[c]) build.sources.push_back(c);
+		}
+		build.next_source = 0;
+		build.overflow = false;
+		std::vector<std::thread> workers;
+		for (int t = 0; t<threads; t++)
+		{
+			if (kernel == BIT_PARALLEL_BFS)
+				workers.push_back(std::thread([&build]() { build.BitParallelWorker(); }));
+			else
+				workers.push_back(std::thread([&build]() { build.ScalarWorker(16); }));
+		}
+		for (size_t t = 0; t<workers.size(); t++)
+		{
+			workers[t].join();
+		}
+		overflow = build.overflow;
+	}
+
+	header->checksum = Checksum(blob + sizeof(DISTCACHE_HEADER), header->payload_size);
+	bool ok = Attach(blob, dist_end);
+	assert(ok);
+	// steps past the stored distances would differ from the search
+	if (next_hops && !overflow)
+	{
+		mHopStride = HopStride(rows);
+		BuildNextHops(threads, (uint32_t *)(blob + hop_offset), blob + hop_offset + Pad8(size_t(cells) * sizeof(uint32_t)));
+		header->flags = NEXT_HOPS;
+		header->payload_size = total - sizeof(DISTCACHE_HEADER);
+		header->checksum = Checksum(blob + sizeof(DISTCACHE_HEADER), header->payload_size);
+		ok = Attach(blob, total);
+		assert(ok);
+	}
+	(void)ok;
+	return !overflow;
+}
+
+void DISTCACHE::CreateFromParser(PARSER &Parser, BUILD_KERNEL kernel, int threads, STORAGE storage, bool next_hops)
+{
+	if (storage != AUTO)
+	{
+		Build(Parser, kernel, threads, storage, next_hops);
+		return;
+	}
+	uint64_t cells = uint64_t(Parser.w) * Parser.h;
+	uint64_t walkable = 0;
+	for (int y = 0; y<Parser.h; y++)
+		for (int x = 0; x<Parser.w; x++)
+			if (Parser.GetAt(Position(x, y)) != PARSER::WALL) walkable++;
+	// bytes are the quickest to read, as long as every distance fits
+	if (walkable*cells <= MAX_TABLE_BYTES && Build(Parser, kernel, threads, DENSE8, next_hops)) return;
+	if (TriIndex(walkable, walkable, walkable) * sizeof(uint16_t) <= MAX_TABLE_BYTES)
+	{
+		Build(Parser, kernel, threads, TRIANGLE16, next_hops);
+		return;
+	}
+	Build(Parser, kernel, threads, LANDMARKS16, next_hops);
 }
@@ -1,19 +1,175 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
 
 #include "parser.h"
 #include "Position.h"
 
+// All pairs walking distances of the arena.
+//
+// The table lives in one contiguous blob, which is also the file format:
+//   DISTCACHE_HEADER
+//   walkable flags      [cells] (padded to 8 bytes)
+//   index of every cell int32[cells], -1 for walls
+//   distances, depending on the storage:
+//     DENSE8       uint8[walkable][cells], one row per target cell
+//     TRIANGLE16   uint16, upper triangle of walkable x walkable (symmetric)
+//     LANDMARKS16  int32[landmarks] (padded to 8 bytes),
+//                  uint16[landmarks][cells]
+//   with NEXT_HOPS (padded to 8 bytes):
+//     component of every cell uint32[cells], ~0 for walls
+//     first step from every walkable cell to every other one, 3 bits each,
+//     one row per target, rows padded to whole 64 bit words
+// LoadFromFile maps the file read-only, so nothing is copied and clients on
+// the same box share the pages. The header carries a hash of the map it was
+// built from and a checksum of the payload.
+struct DISTCACHE_HEADER
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t map_dx, map_dy;
+	uint32_t cells;
+	uint32_t rows; // walkable cells
+	uint64_t map_hash;
+	uint64_t payload_size;
+	uint64_t checksum; // of the payload
+	uint32_t storage;
+	uint32_t landmarks;
+	uint32_t flags;
+	uint32_t reserved;
+};
+
 class DISTCACHE
 {
 public:
+	static const uint32_t VERSION = 3;
+
+	DISTCACHE();
+	~DISTCACHE();
+	DISTCACHE(const DISTCACHE &) = delete;
+	DISTCACHE &operator=(const DISTCACHE &) = delete;
+
 	int map_dx, map_dy;
-	std::vector<unsigned char> mMap;
-	std::vector<std::vector<unsigned char> > mDistMap;
+	const unsigned char *mMap; // 1 if walkable
+
+	enum BUILD_KERNEL
+	{
+		SCALAR_BFS, // one breadth first search per source cell
+		BIT_PARALLEL_BFS // 64 sources per search, one bit each
+	};
+	enum STORAGE
+	{
+		DENSE8, // byte per (from, to), up to 254 steps
+		TRIANGLE16, // 16 bit, each unordered pair stored once
+		LANDMARKS16, // only landmark rows, exact distances by BFS on demand
+		AUTO // the smallest exact table that fits, landmarks for huge arenas
+	};
+	static const int LANDMARK_COUNT = 16;
+	enum FLAGS
+	{
+		NEXT_HOPS = 1 // GetNextTowards is a table lookup
+	};
+
 	bool LoadFromFile(const char *filename);
 	void SaveToFile(const char *filename);
-	void CreateFromParser(PARSER &Parser);
+	// threads == 0 uses every core; next hops are only built for exact tables
+	void CreateFromParser(PARSER &Parser, BUILD_KERNEL kernel = BIT_PARALLEL_BFS, int threads = 0, STORAGE storage = AUTO, bool next_hops = true);
+	// The table of the map the parser holds, one instance per map for the
+	// whole process, so every client of moba-host or a tournament reads the
+	// same pages. Kept until the process exits; the first caller loads it
+	// from filename, or builds it (and saves it if save_built). A build
+	// stalls the calling thread only; call it before the event loops start
+	// where the map is known, moba-host does so for map.txt.
+	static std::shared_ptr<const DISTCACHE> GetShared(PARSER &Parser, const char *filename, bool save_built);
+	bool Empty() const { return mMap == NULL; }
+	bool IsValidFor(const PARSER &Parser) const; // built from the map the parser holds
+	static uint64_t HashMap(const PARSER &Parser);
+	STORAGE GetStorage() const { return mStorage; }
+	bool HasNextHops() const { return mHops != NULL; }
+	size_t GetTableBytes() const; // size of the blob
+
+	// unreachable pairs give Unreachable(), walls -1
 	int GetDist(const Position &p0, const Position &p1) const;
-	Position GetNextTowards(const Position &p0, const Position &p1);
+	int Unreachable() const { return mStorage == DENSE8 ? 0xFF : 0xFFFF; }
+	// admissible estimate, exact unless the storage is LANDMARKS16
+	int GetDistLowerBound(const Position &p0, const Position &p1) const;
+	Position GetNextTowards(const Position &p0, const Position &p1) const;
+
+	// The neighbour of p0 closest to the target, dist(cell) giving the
+	// distance of a cell to it. Ties go by the parity of p0, which keeps the
+	// heroes from all taking the same diagonal. The next hop table and
+	// FLOW_FIELD are built on the same code.
+	template<class DIST>
+	static Position StepTowards(const unsigned char *map, int map_dx, const Position &p0, int unreachable, DIST dist)
+	{
+		int min_dist=unreachable;
+		int count = 0;
+		Position ret;
+		for(int dx=-1;dx<=1;dx++)
+			for(int dy=-1;dy<=1;dy++)
+		{
+			if (dx==0 && dy==0) continue;
+			Position p2(p0.x+dx, p0.y+dy);
+			int c2 = p2.x + p2.y*map_dx;
+			if (!map[c2]) continue;
+			int d = dist(c2);
+			if (d<min_dist)
+			{
+				min_dist = d;
+				count = 1;
+				ret = p2;
+			} else if (d==min_dist)
+			{
+				count++;
+				if (((p0.x+p0.y)%count)==0)
+				{
+					ret = p2;
+				}
+			}
+		}
+		return ret;
+	}
+
+private:
+	const DISTCACHE_HEADER *mHeader;
+	STORAGE mStorage;
+	const int32_t *mIndexOf;
+	const unsigned char *mDist8;
+	const uint16_t *mDist16;
+	const int32_t *mLandmarks;
+	const uint32_t *mComponent;
+	const unsigned char *mHops;
+	size_t mHopStride; // bytes per row
+	std::vector<uint64_t> mOwned; // blob built in this process (8 byte aligned)
+	void *mMapping;
+	size_t mMappingSize;
+
+	// LANDMARKS16: rows of recently asked targets, least recently used goes
+	struct CACHED_ROW
+	{
+		int target; // cell, -1 if empty
+		uint64_t last_use;
+		std::vector<uint16_t> dist;
+	};
+	static const int CACHED_ROWS = 16;
+	mutable std::mutex mRowCacheMutex;
+	mutable std::vector<CACHED_ROW> mRowCache;
+	mutable uint64_t mRowCacheClock;
+	mutable std::vector<int32_t> mOpenList;
+	const uint16_t *GetRow16(int target) const; // lock mRowCacheMutex first
+
+	int GetDistByCell(int c0, int c1) const;
+	Position GetNextTowardsBySearch(const Position &p0, const Position &p1) const;
+	void BuildNextHops(int threads, uint32_t *component, unsigned char *hops) const;
+	void Release();
+	bool Attach(const void *blob, size_t size); // validates and sets up the pointers
+	static size_t PayloadLayout(const DISTCACHE_HEADER &header, size_t &index_offset, size_t &landmark_offset, size_t &dist_offset, size_t &hop_offset);
+	static size_t HopStride(uint32_t rows) { return (size_t(rows) * 3 + 63) / 64 * 8; }
+	static uint64_t Checksum(const unsigned char *data, size_t size);
+	bool Build(PARSER &Parser, BUILD_KERNEL kernel, int threads, STORAGE storage, bool next_hops);
 };
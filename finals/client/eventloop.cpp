@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "eventloop.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+static uint32_t ToEpollEvents(int events)
+{
+	uint32_t ev = 0;
+	if (events & EVENTLOOP::READABLE) ev |= EPOLLIN | EPOLLRDHUP;
+	if (events & EVENTLOOP::WRITABLE) ev |= EPOLLOUT;
+	return ev;
+}
+
+EVENTLOOP::EVENTLOOP()
+{
+	mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	mStopped = false;
+	mGeneration = 0;
+	if (mEpollFd == -1)
+	{
+		std::cout << "Error: Cannot create epoll instance!" << std::endl;
+	}
+}
+
+EVENTLOOP::~EVENTLOOP()
+{
+	for (int fd = 0; fd<(int)mWatches.size(); fd++)
+	{
+		if (mWatches[fd].generation != 0 && mWatches[fd].timer)
+		{
+			close(fd);
+		}
+	}
+	if (mEpollFd != -1)
+	{
+		close(mEpollFd);
+	}
+}
+
+bool EVENTLOOP::Register(int fd, int events, IO_HANDLER handler, bool timer)
+{
+	if (fd<0 || mEpollFd == -1) return false;
+	if (fd >= (int)mWatches.size()) mWatches.resize(fd + 1);
+	WATCH &w = mWatches[fd];
+	w.handler = std::move(handler);
+	w.generation = ++mGeneration;
+	w.timer = timer;
+	epoll_event ev;
+	ev.events = ToEpollEvents(events);
+	ev.data.u64 = (uint64_t(w.generation) << 32) | uint32_t(fd);
+	if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		w.handler = nullptr;
+		w.generation = 0;
+		return false;
+	}
+	return true;
+}
+
+bool EVENTLOOP::Add(int fd, int events, IO_HANDLER handler)
+{
+	return Register(fd, events, std::move(handler), false);
+}
+
+bool EVENTLOOP::Modify(int fd, int events)
+{
+	if (fd<0 || fd >= (int)mWatches.size() || mWatches[fd].generation == 0) return false;
+	epoll_event ev;
+	ev.events = ToEpollEvents(events);
+	ev.data.u64 = (uint64_t(mWatches[fd].generation) << 32) | uint32_t(fd);
+	return epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EVENTLOOP::Remove(int fd)
+{
+	if (fd<0 || fd >= (int)mWatches.size() || mWatches[fd].generation == 0) return;
+	epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+	// events already fetched for this fd are dropped by the generation check;
+	// the handler itself may be the one running, RunOnce releases it
+	mWatches[fd].generation = 0;
+}
+
+int EVENTLOOP::AddTimer(int64_t delay_us, int64_t interval_us, TIMER_HANDLER handler)
+{
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd == -1) return -1;
+	itimerspec spec;
+	if (delay_us <= 0) delay_us = 1; // zero would disarm the timer
+	spec.it_value.tv_sec = delay_us / 1000000;
+	spec.it_value.tv_nsec = (delay_us % 1000000) * 1000;
+	spec.it_interval.tv_sec = interval_us / 1000000;
+	spec.it_interval.tv_nsec = (interval_us % 1000000) * 1000;
+	timerfd_settime(fd, 0, &spec, NULL);
+	bool one_shot = interval_us == 0;
+	bool ok = Register(fd, READABLE, [this, fd, one_shot, handler](int)
+	{
+		uint64_t expirations;
+		ssize_t r = read(fd, &expirations, sizeof(expirations));
+		if (r != (ssize_t)sizeof(expirations)) return;
+		// the handler may cancel this timer and reuse the fd, so only
+		// locals are touched after the call
+		int timer_fd = fd;
+		bool once = one_shot;
+		uint32_t generation = mWatches[timer_fd].generation;
+		handler();
+		if (once && mWatches[timer_fd].generation == generation)
+		{
+			CancelTimer(timer_fd);
+		}
+	}, true);
+	if (!ok)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void EVENTLOOP::CancelTimer(int timer_id)
+{
+	if (timer_id<0 || timer_id >= (int)mWatches.size() || !mWatches[timer_id].timer) return;
+	if (mWatches[timer_id].generation == 0) return;
+	Remove(timer_id);
+	mWatches[timer_id].timer = false;
+	close(timer_id);
+}
+
+void EVENTLOOP::RunOnce(int timeout_ms)
+{
+	const int MaxEvents = 16;
+	epoll_event events[MaxEvents];
+	int n = epoll_wait(mEpollFd, events, MaxEvents, timeout_ms);
+	if (n<0)
+	{
+		if (errno != EINTR)
+		{
+			std::cout << "Error: epoll_wait failed!" << std::endl;
+			mStopped = true;
+		}
+		return;
+	}
+	for (int i = 0; i<n; i++)
+	{
+		int fd = int(events[i].data.u64 & 0xFFFFFFFFu);
+		uint32_t generation = uint32_t(events[i].data.u64 >> 32);
+		if (fd >= (int)mWatches.size()) continue;
+		if (mWatches[fd].generation != generation) continue;
+		int ready = 0;
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ready |= READABLE;
+		if (events[i].events & EPOLLOUT) ready |= WRITABLE;
+		// keep the handler alive even if it removes or re-registers its fd
+		IO_HANDLER handler = std::move(mWatches[fd].handler);
+		handler(ready);
+		if (mWatches[fd].generation == generation && !mWatches[fd].handler)
+		{
+			mWatches[fd].handler = std::move(handler);
+		}
+	}
+}
+
+void EVENTLOOP::Run()
+{
+	mStopped = false;
+	while (!mStopped)
+	{
+		RunOnce(-1);
+	}
+}
+
+void EVENTLOOP::Stop()
+{
+	mStopped = true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+// Single threaded epoll reactor. Sockets are registered with a readiness
+// callback, timers are timerfds living in the same epoll set, so a blocked
+// epoll_wait is the only place where the client ever waits.
+class EVENTLOOP
+{
+public:
+	enum
+	{
+		READABLE = 1,
+		WRITABLE = 2
+	};
+	typedef std::function<void(int events)> IO_HANDLER;
+	typedef std::function<void()> TIMER_HANDLER;
+
+	EVENTLOOP();
+	~EVENTLOOP();
+
+	bool Add(int fd, int events, IO_HANDLER handler);
+	bool Modify(int fd, int events);
+	void Remove(int fd);
+
+	// returns a timer id, or -1 on failure. interval_us == 0 means one-shot.
+	int AddTimer(int64_t delay_us, int64_t interval_us, TIMER_HANDLER handler);
+	void CancelTimer(int timer_id);
+
+	// waits at most timeout_ms (-1: forever) and dispatches ready events
+	void RunOnce(int timeout_ms);
+	void Run();
+	void Stop();
+
+private:
+	struct WATCH
+	{
+		IO_HANDLER handler;
+		uint32_t generation;
+		bool timer;
+	};
+	int mEpollFd;
+	bool mStopped;
+	uint32_t mGeneration;
+	std::vector<WATCH> mWatches; // indexed by fd
+	bool Register(int fd, int events, IO_HANDLER handler, bool timer);
+};
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "flowfield.h"
+#include <algorithm>
+
+FLOW_FIELD::FLOW_FIELD()
+{
+	mCache = NULL;
+	mDist = NULL;
+}
+
+int FLOW_FIELD::Dist(const Position &p) const
+{
+	if (mCache == NULL || mCache->Empty()) return -1;
+	if (mDist == NULL) return mCache->GetDist(p, mGoal);
+	int c = p.x + p.y*mCache->map_dx;
+	if (!mCache->mMap[c]) return -1;
+	return mDist[c] == 0xFFFF ? mCache->Unreachable() : int(mDist[c]);
+}
+
+Position FLOW_FIELD::Next(const Position &p) const
+{
+	if (mCache == NULL || mCache->Empty()) return p;
+	if (mDist == NULL)
+	{
+		if (p == mGoal) return p;
+		int c0 = p.x + p.y*mCache->map_dx, c1 = mGoal.x + mGoal.y*mCache->map_dx;
+		if (!mCache->mMap[c0] || !mCache->mMap[c1]) return p;
+		return mCache->GetNextTowards(p, mGoal);
+	}
+	int c = p.x + p.y*mCache->map_dx;
+	if (!mCache->mMap[c] || mDist[c] == 0 || mDist[c] == 0xFFFF) return p;
+	const uint16_t *dist = mDist;
+	return DISTCACHE::StepTowards(mCache->mMap, mCache->map_dx, p, 0xFFFF, [dist](int c2) { return int(dist[c2]); });
+}
+
+FLOW_FIELDS::FLOW_FIELDS()
+{
+	mTickUsed = 0;
+	mSearches = 0;
+}
+
+void FLOW_FIELDS::BeginTick(const std::shared_ptr<const DISTCACHE> &Cache)
+{
+	if (Cache != mCache)
+	{
+		mCache = Cache;
+		mKept.clear();
+	}
+	// evicted here only, so no handle dies within a tick
+	if (mKept.size()>MAX_KEPT) mKept.erase(mKept.begin(), mKept.end() - MAX_KEPT);
+	mTickUsed = 0;
+}
+
+FLOW_FIELDS::SEARCHED *FLOW_FIELDS::Find(std::vector<std::unique_ptr<SEARCHED> > &fields, size_t count, const std::vector<int32_t> &goals)
+{
+	for (size_t i = 0; i<count; i++)
+	{
+		if (fields[i]->goals == goals) return fields[i].get();
+	}
+	return NULL;
+}
+
+void FLOW_FIELDS::Search(SEARCHED &field)
+{
+	// breadth first from all the goals at once, 8 neighbours like DISTCACHE
+	const DISTCACHE &cache = *mCache;
+	int dx = cache.map_dx, dy = cache.map_dy;
+	field.dist.assign(size_t(dx)*dy, 0xFFFF);
+	mOpenList.clear();
+	for (size_t i = 0; i<field.goals.size(); i++)
+	{
+		int32_t goal = field.goals[i];
+		if (!cache.mMap[goal]) continue;
+		field.dist[goal] = 0;
+		mOpenList.push_back(goal);
+	}
+	for (size_t idx = 0; idx<mOpenList.size(); idx++)
+	{
+		int from = mOpenList[idx];
+		int d = field.dist[from];
+		if (d >= 0xFFFE) continue;
+		int x = from % dx, y = from / dx;
+		for (int ddx = -1; ddx <= 1; ddx++)
+			for (int ddy = -1; ddy <= 1; ddy++)
+			{
+				if (ddx == 0 && ddy == 0) continue;
+				int x1 = x + ddx, y1 = y + ddy;
+				if (x1<0 || x1 >= dx || y1<0 || y1 >= dy) continue;
+				int c = x1 + y1*dx;
+				if (!cache.mMap[c] || field.dist[c] != 0xFFFF) continue;
+				field.dist[c] = uint16_t(d + 1);
+				mOpenList.push_back(c);
+			}
+	}
+	mSearches++;
+}
+
+FLOW_FIELD FLOW_FIELDS::Handle(const SEARCHED &field) const
+{
+	FLOW_FIELD handle;
+	handle.mCache = mCache.get();
+	handle.mDist = &field.dist.front();
+	return handle;
+}
+
+FLOW_FIELD FLOW_FIELDS::Toward(const Position &goal)
+{
+	FLOW_FIELD handle;
+	handle.mCache = mCache.get();
+	handle.mGoal = goal;
+	if (mCache == NULL || mCache->Empty() || mCache->HasNextHops()) return handle;
+	mGoals.assign(1, goal.x + goal.y*mCache->map_dx);
+	SEARCHED *field = Find(mKept, mKept.size(), mGoals);
+	if (field == NULL)
+	{
+		mKept.push_back(std::unique_ptr<SEARCHED>(new SEARCHED));
+		field = mKept.back().get();
+		field->goals = mGoals;
+		Search(*field);
+	}
+	return Handle(*field);
+}
+
+FLOW_FIELD FLOW_FIELDS::TowardNearest(const Position *goals, size_t count)
+{
+	if (count == 1) return Toward(goals[0]);
+	FLOW_FIELD handle;
+	handle.mCache = mCache.get();
+	if (mCache == NULL || mCache->Empty() || count == 0) return handle;
+	mGoals.clear();
+	for (size_t i = 0; i<count; i++)
+	{
+		mGoals.push_back(goals[i].x + goals[i].y*mCache->map_dx);
+	}
+	std::sort(mGoals.begin(), mGoals.end());
+	mGoals.erase(std::unique(mGoals.begin(), mGoals.end()), mGoals.end());
+	SEARCHED *field = Find(mTick, mTickUsed, mGoals);
+	if (field == NULL)
+	{
+		// the storage of earlier ticks is reused
+		if (mTickUsed == mTick.size()) mTick.push_back(std::unique_ptr<SEARCHED>(new SEARCHED));
+		field = mTick[mTickUsed++].get();
+		field->goals = mGoals;
+		Search(*field);
+	}
+	return Handle(*field);
+}
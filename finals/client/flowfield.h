@@ -0,0 +1,66 @@
+#pragma once
+#include "distcache.h"
+#include "Position.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Which way to step toward a goal, from any cell. A handle: the distances
+// belong to the FLOW_FIELDS that returned it and stay valid until its next
+// BeginTick.
+class FLOW_FIELD
+{
+public:
+	FLOW_FIELD();
+	// steps to the nearest goal, Unreachable() of the table if none, -1 on walls
+	int Dist(const Position &p) const;
+	// the next cell from p, the same one DISTCACHE::GetNextTowards gives for
+	// a single goal; p itself on a goal, on a wall or without a path
+	Position Next(const Position &p) const;
+
+private:
+	friend class FLOW_FIELDS;
+	const DISTCACHE *mCache;
+	Position mGoal; // read from mCache if mDist is NULL
+	const uint16_t *mDist; // by cell, from a search
+};
+
+// Per client flow fields toward the goals the heroes share this tick (the
+// enemy base, lane rally points, the lane objects to fall back to), so each
+// one is worked out once however many heroes head there.
+//  - A single goal is a row of the DISTCACHE next hop table when there is
+//    one, nothing to build. Without it (LANDMARKS16 arenas) the goal is
+//    searched once and kept over ticks, the walls do not move.
+//  - The nearest of several goals is one multi-source search, kept for the
+//    tick and shared by every caller asking for the same set.
+class FLOW_FIELDS
+{
+public:
+	static const size_t MAX_KEPT = 64; // searched single goal fields kept between ticks
+
+	FLOW_FIELDS();
+	// the table of this tick; multi goal fields of the previous tick go
+	void BeginTick(const std::shared_ptr<const DISTCACHE> &Cache);
+	FLOW_FIELD Toward(const Position &goal);
+	FLOW_FIELD TowardNearest(const Position *goals, size_t count); // in any order
+
+	uint64_t Searches() const { return mSearches; } // since construction
+
+private:
+	struct SEARCHED
+	{
+		std::vector<int32_t> goals; // cells, sorted
+		std::vector<uint16_t> dist;
+	};
+	SEARCHED *Find(std::vector<std::unique_ptr<SEARCHED> > &fields, size_t count, const std::vector<int32_t> &goals);
+	void Search(SEARCHED &field);
+	FLOW_FIELD Handle(const SEARCHED &field) const;
+
+	std::shared_ptr<const DISTCACHE> mCache;
+	std::vector<std::unique_ptr<SEARCHED> > mKept; // single goals, oldest first
+	std::vector<std::unique_ptr<SEARCHED> > mTick; // the first mTickUsed are this tick's
+	size_t mTickUsed;
+	std::vector<int32_t> mGoals; // scratch
+	std::vector<int32_t> mOpenList;
+	uint64_t mSearches;
+};
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+#include "framing.h"
+#include <algorithm>
+#include <cstring>
+
+FRAMER::FRAMER()
+{
+	mArena.resize(1<<16);
+	Reset();
+}
+
+void FRAMER::Reset()
+{
+	mReadPos = mEnd = 0;
+	mFrameLines.clear();
+	mFrame.clear();
+}
+
+char *FRAMER::GetWriteBuffer(size_t min_free, size_t &free)
+{
+	// everything before keep is consumed and not referenced by the frame
+	size_t keep = mFrameLines.empty() ? mReadPos : mFrameLines.front().begin;
+	if (keep>0 && mArena.size() - mEnd < min_free)
+	{
+		memmove(&mArena[0], &mArena[keep], mEnd - keep);
+		for (size_t i = 0; i<mFrameLines.size(); i++)
+		{
+			mFrameLines[i].begin -= keep;
+		}
+		mReadPos -= keep;
+		mEnd -= keep;
+	}
+	if (mArena.size() - mEnd < min_free)
+	{
+		size_t size = mArena.size();
+		while (size - mEnd < min_free) size *= 2;
+		mArena.resize(size);
+	}
+	free = mArena.size() - mEnd;
+	return &mArena[mEnd];
+}
+
+void FRAMER::CommitWrite(size_t length)
+{
+	mEnd += length;
+}
+
+bool FRAMER::NextLine(LINE_VIEW &line)
+{
+	if (mReadPos == mEnd) return false;
+	const char *start = &mArena[mReadPos];
+	const char *eol = (const char *)memchr(start, '\n', mEnd - mReadPos);
+	if (!eol) return false;
+	size_t length = eol - start;
+	mReadPos += length + 1;
+	if (length>0 && start[length - 1] == '\r') length--;
+	line = LINE_VIEW(start, length);
+	return true;
+}
+
+void FRAMER::PushFrameLine(const LINE_VIEW &line)
+{
+	SPAN span;
+	span.begin = line.data() - &mArena[0];
+	span.length = line.size();
+	mFrameLines.push_back(span);
+}
+
+const std::vector<LINE_VIEW> &FRAMER::GetFrame()
+{
+	mFrame.clear();
+	for (size_t i = 0; i<mFrameLines.size(); i++)
+	{
+		mFrame.push_back(LINE_VIEW(&mArena[mFrameLines[i].begin], mFrameLines[i].length));
+	}
+	return mFrame;
+}
+
+void FRAMER::ClearFrame()
+{
+	mFrameLines.clear();
+	mFrame.clear();
+}
+
+COMMAND_WRITER::COMMAND_WRITER(size_t capacity)
+{
+	mBuffer.resize(std::max(capacity, MAX_LINE));
+	mSize = 0;
+}
+
+char *COMMAND_WRITER::Line()
+{
+	if (mBuffer.size() - mSize < MAX_LINE) mBuffer.resize(mBuffer.size()*2);
+	return &mBuffer[mSize];
+}
+
+char *COMMAND_WRITER::Int(char *out, int value)
+{
+	// the digits backwards into a scratch, then forwards; unsigned so that
+	// INT_MIN negates
+	char digits[10];
+	int n = 0;
+	unsigned int v = (unsigned int)value;
+	if (value<0)
+	{
+		*out++ = '-';
+		v = 0u - v;
+	}
+	do
+	{
+		digits[n++] = char('0' + v%10);
+		v /= 10;
+	} while (v>0);
+	while (n>0) *out++ = digits[--n];
+	return out;
+}
+
+char *COMMAND_WRITER::Text(char *out, const char *text, size_t length)
+{
+	memcpy(out, text, length);
+	return out + length;
+}
+
+void COMMAND_WRITER::Tick(int tick)
+{
+	char *begin = Line(), *out = begin;
+	out = Text(out, "tick ", 5);
+	out = Int(out, tick);
+	*out++ = '\n';
+	mSize += out - begin;
+}
+
+void COMMAND_WRITER::Attack(int hero_id, int target_id)
+{
+	char *begin = Line(), *out = begin;
+	out = Text(out, "attack ", 7);
+	out = Int(out, hero_id);
+	*out++ = ' ';
+	out = Int(out, target_id);
+	*out++ = '\n';
+	mSize += out - begin;
+}
+
+void COMMAND_WRITER::Move(int hero_id, int x, int y)
+{
+	char *begin = Line(), *out = begin;
+	out = Text(out, "move ", 5);
+	out = Int(out, hero_id);
+	*out++ = ' ';
+	out = Int(out, x);
+	*out++ = ' ';
+	out = Int(out, y);
+	*out++ = '\n';
+	mSize += out - begin;
+}
+
+void COMMAND_WRITER::End()
+{
+	char *out = Line();
+	out[0] = '.';
+	out[1] = '\n';
+	mSize += 2;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "parser.h"
+#include <vector>
+#include <cstddef>
+
+// Splits the server stream into lines without copying them. Bytes are
+// received straight into a reusable arena; complete lines are handed out as
+// views into it. Lines pushed into the current frame stay valid until
+// ClearFrame, the arena is only compacted or grown behind them, so in steady
+// state (frames no bigger than the largest one seen) nothing is allocated.
+class FRAMER
+{
+public:
+	FRAMER();
+	void Reset();
+
+	// returns space for at least min_free bytes, free is the usable size
+	char *GetWriteBuffer(size_t min_free, size_t &free);
+	void CommitWrite(size_t length);
+
+	// next complete line without the line break; valid until GetWriteBuffer
+	bool NextLine(LINE_VIEW &line);
+
+	// keeps a line returned by NextLine until ClearFrame
+	void PushFrameLine(const LINE_VIEW &line);
+	const std::vector<LINE_VIEW> &GetFrame();
+	bool FrameEmpty() const { return mFrameLines.empty(); }
+	void ClearFrame();
+
+private:
+	struct SPAN
+	{
+		size_t begin, length;
+	};
+	std::vector<char> mArena;
+	size_t mReadPos; // first byte not yet returned as a line
+	size_t mEnd; // end of the received data
+	std::vector<SPAN> mFrameLines; // offsets, so the arena may move
+	std::vector<LINE_VIEW> mFrame;
+};
+
+// The send side: a tick answer formatted straight into a reusable buffer,
+// "tick N", the commands and "." each followed by '\n', ready for a single
+// send. Lines are appended to a buffer of fixed capacity, which only grows
+// for an answer longer than any before it.
+class COMMAND_WRITER
+{
+public:
+	static const size_t DEFAULT_CAPACITY = 4096;
+	static const size_t MAX_LINE = 64; // "move" and three ints with room to spare
+
+	explicit COMMAND_WRITER(size_t capacity = DEFAULT_CAPACITY);
+	void Clear() { mSize = 0; }
+
+	void Tick(int tick);
+	void Attack(int hero_id, int target_id);
+	void Move(int hero_id, int x, int y);
+	void End(); // the final "."
+
+	const char *Data() const { return &mBuffer[0]; }
+	size_t Size() const { return mSize; }
+
+private:
+	char *Line(); // room for MAX_LINE bytes at the end
+	static char *Int(char *out, int value);
+	static char *Text(char *out, const char *text, size_t length);
+
+	std::vector<char> mBuffer;
+	size_t mSize;
+};
@@ -0,0 +1,108 @@
+// Runs several sessions of the client in one process, e.g. a duel and a
+// melee bot side by side. Every session logs in with its own slot, the "#n"
+// of the team password, and plays against its own preferred opponents.
+// Sessions are spread over a few event loops, one thread each, and all of
+// them read the same distance table (DISTCACHE::GetShared), so a session
+// costs its own game state only. The table of the last map.txt is loaded,
+// or built, before the loops start, so no session builds it on its loop.
+//   moba-host [options] <slot>:<opponents> ...
+//     -a <address>    server address
+//     -t <threads>    event loops, 1 by default: Process runs one session
+//                     at a time, which is enough while it stays well within
+//                     the tick budget
+//     -b <budget_ms>  tick budget of every session
+//     -f replay       log into replay<slot>.bin instead of debug<slot>.log
+#include "stdafx.h"
+#include "Client.h"
+#include "debuglog.h"
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+static const int MAX_SLOTS = 5; // connections per team the server accepts
+
+static int Usage(const char *argv0)
+{
+	std::cout << "usage: " << argv0 << " [-a address] [-t threads] [-b budget_ms] [-f replay] <slot>:<opponents> ..." << std::endl;
+	std::cout << "  slot is 1.." << MAX_SLOTS << ", each at most once" << std::endl;
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	// std::cout stays synced with stdio: every loop thread writes to it, and
+	// only the synced stream may be used from several threads at once
+	std::string server_address = "172.22.22.239";
+	int threads = 1;
+	int64_t budget_us = CLIENT::DEFAULT_TICK_BUDGET_US;
+	ASYNC_LOG::FORMAT log_format = ASYNC_LOG::FORMAT_TEXT;
+	std::vector<std::pair<int, std::string> > sessions;
+	bool used[MAX_SLOTS + 1] = {};
+	for (int i = 1; i<argc; i++)
+	{
+		if (argv[i][0] == '-' && argv[i][1] != 0 && argv[i][2] == 0 && i + 1<argc)
+		{
+			const char *value = argv[++i];
+			switch (argv[i - 1][1])
+			{
+				case 'a': server_address = value; break;
+				case 't': threads = atoi(value); break;
+				case 'b': budget_us = atoll(value)*1000; break;
+				case 'f':
+					if (std::string(value) != "replay") return Usage(argv[0]);
+					log_format = ASYNC_LOG::FORMAT_REPLAY;
+					break;
+				default: return Usage(argv[0]);
+			}
+			continue;
+		}
+		const char *colon = strchr(argv[i], ':');
+		int slot = atoi(argv[i]);
+		if (colon == NULL || slot<1 || slot>MAX_SLOTS || used[slot] || colon[1] == 0) return Usage(argv[0]);
+		used[slot] = true;
+		sessions.push_back(std::make_pair(slot, std::string(colon + 1)));
+	}
+	if (sessions.empty() || threads<1) return Usage(argv[0]);
+	threads = std::min(threads, (int)sessions.size());
+
+	std::vector<std::string> map_lines;
+	if (LoadLines("map.txt", map_lines) && !map_lines.empty())
+	{
+		PARSER parser;
+		parser.ParseMap(map_lines);
+		DISTCACHE::GetShared(parser, "distcache.bin", true);
+		std::cout << "distance table of map.txt ready" << std::endl;
+	}
+
+	std::vector<std::unique_ptr<EVENTLOOP> > loops;
+	for (int t = 0; t<threads; t++) loops.push_back(std::unique_ptr<EVENTLOOP>(new EVENTLOOP));
+	std::vector<std::unique_ptr<CLIENT> > clients;
+	for (size_t s = 0; s<sessions.size(); s++)
+	{
+		int slot = sessions[s].first;
+		std::cout << "session #" << slot << " playing against " << sessions[s].second << std::endl;
+		CLIENT *client = CreateClient(sessions[s].second);
+		clients.push_back(std::unique_ptr<CLIENT>(client));
+		client->SetSlot(slot);
+		client->SetTickBudget(budget_us);
+		client->SetDebugLogFormat(log_format);
+		client->SetDebugLogFile((log_format == ASYNC_LOG::FORMAT_REPLAY ? "replay" : "debug") +
+			std::to_string(slot) + (log_format == ASYNC_LOG::FORMAT_REPLAY ? ".bin" : ".log"));
+		client->strIPAddress = server_address;
+		// attached before the loops run, so each loop is only ever touched
+		// by its own thread afterwards
+		client->Attach(*loops[s%threads]);
+	}
+	std::cout << sessions.size() << " sessions on " << threads << " event loops" << std::endl;
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t<threads; t++)
+	{
+		EVENTLOOP *loop = loops[t].get();
+		workers.push_back(std::thread([loop]() { loop->Run(); }));
+	}
+	loops[0]->Run();
+	for (size_t t = 0; t<workers.size(); t++) workers[t].join();
+	return 0;
+}
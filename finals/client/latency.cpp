@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "latency.h"
+#include <cstring>
+
+void LATENCY_HISTOGRAM::Reset()
+{
+	memset(mBuckets, 0, sizeof(mBuckets));
+	mCount = mSum = mMax = 0;
+}
+
+int LATENCY_HISTOGRAM::BucketOf(int64_t ns)
+{
+	if (ns<(int64_t(1)<<MIN_SHIFT)) return 0;
+#if defined(__GNUC__)
+	int shift = 63 - __builtin_clzll((unsigned long long)ns);
+#else
+	int shift = MIN_SHIFT;
+	while ((ns>>(shift + 1))!=0) shift++;
+#endif
+	if (shift>=MAX_SHIFT) return BUCKETS - 1;
+	int sub = int(ns>>(shift - SUB_BITS)) & (SUB_BUCKETS - 1);
+	return 1 + (shift - MIN_SHIFT)*SUB_BUCKETS + sub;
+}
+
+int64_t LATENCY_HISTOGRAM::UpperEdge(int bucket)
+{
+	if (bucket==0) return int64_t(1)<<MIN_SHIFT;
+	if (bucket==BUCKETS - 1) return INT64_MAX;
+	int shift = MIN_SHIFT + (bucket - 1)/SUB_BUCKETS;
+	int sub = (bucket - 1)%SUB_BUCKETS;
+	return int64_t(SUB_BUCKETS + sub + 1)<<(shift - SUB_BITS);
+}
+
+void LATENCY_HISTOGRAM::Add(int64_t ns)
+{
+	if (ns<0) ns = 0;
+	mBuckets[BucketOf(ns)]++;
+	mCount++;
+	mSum += ns;
+	if (ns>mMax) mMax = ns;
+}
+
+int64_t LATENCY_HISTOGRAM::Percentile(double p) const
+{
+	if (mCount==0) return 0;
+	int64_t rank = int64_t(p*mCount);
+	if (rank>=mCount) rank = mCount - 1;
+	int64_t seen = 0;
+	for (int b = 0; b<BUCKETS; b++)
+	{
+		seen += mBuckets[b];
+		if (seen>rank)
+		{
+			int64_t edge = UpperEdge(b);
+			return edge<mMax ? edge : mMax;
+		}
+	}
+	return mMax;
+}
+
+LATENCY_PROFILE::STAGE LATENCY_PROFILE::AddStage(const std::string &name)
+{
+	for (size_t i = 0; i<mNames.size(); i++)
+	{
+		if (mNames[i]==name) return (STAGE)i;
+	}
+	mNames.push_back(name);
+	mHistograms.push_back(LATENCY_HISTOGRAM());
+	return (STAGE)mNames.size() - 1;
+}
+
+void LATENCY_PROFILE::Reset()
+{
+	for (size_t i = 0; i<mHistograms.size(); i++)
+	{
+		mHistograms[i].Reset();
+	}
+}
+
+void LATENCY_PROFILE::Print(std::ostream &os) const
+{
+	for (size_t i = 0; i<mNames.size(); i++)
+	{
+		const LATENCY_HISTOGRAM &h = mHistograms[i];
+		if (h.Count()==0) continue;
+		os << "latency " << mNames[i] << ": " << h.Count() << " samples, mean " << h.Mean()/1000.0
+			<< "us p50 " << h.Percentile(0.5)/1000.0 << "us p99 " << h.Percentile(0.99)/1000.0
+			<< "us max " << h.Max()/1000.0 << "us" << std::endl;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <ostream>
+#include <chrono>
+#include <cstdint>
+
+// Fixed bucket histogram of durations in nanoseconds: 8 buckets per power of
+// two (about 12% resolution) from 64ns up to a minute, so adding a sample is
+// a few instructions and nothing is allocated.
+class LATENCY_HISTOGRAM
+{
+public:
+	static const int SUB_BUCKETS = 8; // per power of two
+	static const int SUB_BITS = 3;
+	static const int MIN_SHIFT = 6; // below 64ns is one bucket
+	static const int MAX_SHIFT = 36; // from ~69s on is one bucket
+	static const int BUCKETS = (MAX_SHIFT - MIN_SHIFT) * SUB_BUCKETS + 2;
+
+	LATENCY_HISTOGRAM() { Reset(); }
+	void Reset();
+	void Add(int64_t ns);
+
+	int64_t Count() const { return mCount; }
+	int64_t Max() const { return mMax; }
+	int64_t Mean() const { return mCount ? mSum / mCount : 0; }
+	// upper edge of the bucket holding the p quantile (0..1), at most Max()
+	int64_t Percentile(double p) const;
+
+private:
+	static int BucketOf(int64_t ns);
+	static int64_t UpperEdge(int bucket);
+	uint32_t mBuckets[BUCKETS];
+	int64_t mCount, mSum, mMax;
+};
+
+// Named histograms of the stages of a tick. Stages are registered once and
+// timed with a scoped TIMER; Print dumps p50, p99 and max of each.
+class LATENCY_PROFILE
+{
+public:
+	typedef int STAGE;
+	typedef std::chrono::steady_clock CLOCK;
+
+	STAGE AddStage(const std::string &name); // the same name gives the same stage
+	LATENCY_HISTOGRAM &Get(STAGE stage) { return mHistograms[stage]; }
+	const LATENCY_HISTOGRAM &Get(STAGE stage) const { return mHistograms[stage]; }
+	const std::string &GetName(STAGE stage) const { return mNames[stage]; }
+	int GetStageCount() const { return (int)mNames.size(); }
+	void Reset(); // clears the samples, keeps the stages
+	void Print(std::ostream &os) const; // stages that have samples
+
+	class TIMER
+	{
+	public:
+		TIMER(LATENCY_PROFILE &profile, STAGE stage) : mHistogram(profile.Get(stage)), mStart(CLOCK::now()) {}
+		~TIMER() { mHistogram.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(CLOCK::now() - mStart).count()); }
+		TIMER(const TIMER &) = delete;
+		TIMER &operator=(const TIMER &) = delete;
+	private:
+		LATENCY_HISTOGRAM &mHistogram;
+		CLOCK::time_point mStart;
+	};
+
+private:
+	std::vector<std::string> mNames;
+	std::vector<LATENCY_HISTOGRAM> mHistograms;
+};
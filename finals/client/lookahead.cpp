@@ -0,0 +1,161 @@
+#include "stdafx.h"
+#include "lookahead.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+typedef std::chrono::steady_clock CLOCK;
+
+// an hp point of the hero counts twice an hp point taken from the enemy, a
+// level ten of them; a dead hero is worse than one at 0 hp
+static const int OWN_HP_WEIGHT = 2;
+static const int LEVEL_WEIGHT = 20;
+static const int DEATH_HP = -HERO_MAX_HP_BASE;
+
+LOOKAHEAD::LOOKAHEAD()
+{
+	mNodes = 0;
+	mNanoseconds = 0;
+}
+
+void LOOKAHEAD::Reserve(int beam_width)
+{
+	size_t capacity = (size_t)beam_width*(MAX_ACTIONS + 1);
+	if (mStates.size()<capacity) mStates.resize(capacity);
+	mFirst.reserve(MAX_ACTIONS);
+	mBeam.reserve(beam_width);
+	mNext.reserve(capacity);
+	for (int side = 0; side<2; side++)
+	{
+		mCommands[side].reserve(5 + 1); // its heroes, and the searched action
+	}
+}
+
+int LOOKAHEAD::GetActions(const SIMULATOR &Sim, const SIM_STATE &state, int hero_id, COMMAND *actions) const
+{
+	const MAP_OBJECT &hero = state.units[hero_id - 1].unit;
+	int count = 0;
+	// staying comes first, so it wins ties: the search only moves the hero
+	// when that is better
+	for (int k = 0; k<9; k++)
+	{
+		int d = (k + 4)%9;
+		Position to(hero.pos.x + d%3 - 1, hero.pos.y + d/3 - 1);
+		if (!Sim.Walkable(to)) continue;
+		COMMAND &c = actions[count++];
+		c.type = COMMAND::MOVE; // to its own cell: stays
+		c.hero_id = hero_id;
+		c.target_id = 0;
+		c.target_pos = to;
+	}
+	for (int i = 0; i<state.unit_count && count<MAX_ACTIONS; i++)
+	{
+		const SIM_UNIT &u = state.units[i];
+		if (!u.alive || u.unit.side == hero.side || hero.pos.DistSquare(u.unit.pos)>HERO_RANGE_SQ) continue;
+		COMMAND &c = actions[count++];
+		c.type = COMMAND::ATTACK;
+		c.hero_id = hero_id;
+		c.target_id = u.unit.id;
+	}
+	return count;
+}
+
+int LOOKAHEAD::Evaluate(const SIM_STATE &state, int hero_id)
+{
+	const SIM_UNIT &hero = state.units[hero_id - 1];
+	int score = OWN_HP_WEIGHT*(hero.alive ? hero.unit.hp : DEATH_HP);
+	score += LEVEL_WEIGHT*(state.level[0] - state.level[1]);
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		const SIM_UNIT &u = state.units[i];
+		if (u.alive && u.unit.side == 1) score -= u.unit.hp;
+	}
+	if (state.result == PARSER::VICTORY) score += BASE_MAX_HP;
+	if (state.result == PARSER::DEFEAT) score -= BASE_MAX_HP;
+	return score;
+}
+
+bool LOOKAHEAD::Search(const SIMULATOR &Sim, const SIM_STATE &root, int hero_id, int depth, int beam_width,
+	const std::function<bool()> &stop, COMMAND &first)
+{
+	CLOCK::time_point start = CLOCK::now();
+	if (hero_id<1 || hero_id>5 || !root.units[hero_id - 1].alive || root.result != PARSER::ONGOING ||
+		depth<1 || beam_width<1) return false;
+	Reserve(beam_width);
+	mFirst.clear();
+
+	// states [0, beam_width) hold the beam, the children follow
+	memcpy(&mStates[0], &root, sizeof(SIM_STATE));
+	mBeam.clear();
+	NODE node = { 0, -1, 0 };
+	mBeam.push_back(node);
+	bool found = false;
+	int best_first = -1;
+	for (int d = 0; d<depth; d++)
+	{
+		mNext.clear();
+		bool stopped = false;
+		for (size_t b = 0; b<mBeam.size() && !stopped; b++)
+		{
+			const SIM_STATE &parent = mStates[mBeam[b].state];
+			if (!parent.units[hero_id - 1].alive || parent.result != PARSER::ONGOING)
+			{
+				// nothing left to choose, it goes on as it is
+				NODE same = mBeam[b];
+				same.state = beam_width + (int)mNext.size();
+				memcpy(&mStates[same.state], &parent, sizeof(SIM_STATE));
+				mNext.push_back(same);
+				continue;
+			}
+			COMMAND actions[MAX_ACTIONS];
+			int count = GetActions(Sim, parent, hero_id, actions);
+			for (int a = 0; a<count; a++)
+			{
+				if (stop())
+				{
+					stopped = true;
+					break;
+				}
+				int child = beam_width + (int)mNext.size();
+				SIM_STATE &state = mStates[child];
+				memcpy(&state, &parent, sizeof(SIM_STATE));
+				mCommands[0].clear();
+				mCommands[1].clear();
+				mCommands[0].push_back(actions[a]);
+				Sim.GreedyCommands(state, 0, hero_id, mCommands[0]);
+				Sim.GreedyCommands(state, 1, 0, mCommands[1]);
+				Sim.Step(state, mCommands);
+				NODE next = { child, mBeam[b].first, Evaluate(state, hero_id) };
+				if (d == 0)
+				{
+					next.first = (int)mFirst.size();
+					mFirst.push_back(actions[a]);
+				}
+				mNext.push_back(next);
+				mNodes++;
+			}
+		}
+		// a partly expanded depth is only trusted for the first action
+		if (mNext.empty() || (stopped && d>0)) break;
+		// children take states in the order they are made, so ties broken by
+		// state keep that order without the buffer std::stable_sort allocates
+		std::sort(mNext.begin(), mNext.end(), [](const NODE &a, const NODE &b) {
+			return a.score>b.score || (a.score == b.score && a.state<b.state); });
+		best_first = mNext[0].first;
+		found = true;
+		if (stopped) break;
+		// the best children become the beam, their states move to the front
+		if ((int)mNext.size()>beam_width) mNext.resize(beam_width);
+		mBeam.clear();
+		for (size_t n = 0; n<mNext.size(); n++)
+		{
+			NODE kept = mNext[n];
+			if (kept.state != (int)n) memcpy(&mStates[n], &mStates[kept.state], sizeof(SIM_STATE));
+			kept.state = (int)n;
+			mBeam.push_back(kept);
+		}
+	}
+	if (found) first = mFirst[best_first];
+	mNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(CLOCK::now() - start).count();
+	return found;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "sim.h"
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// Bounded beam search over one of our heroes' actions, on copies of a
+// SIM_STATE. Each tick the hero stays, steps to one of the 8 cells around
+// it or attacks an enemy in range; every other hero, ours and theirs,
+// attacks what a turret would. The best beam_width states of a depth are
+// expanded into the next one, and the first action of the best state at
+// the deepest depth reached is the answer. The search is anytime: when
+// stop() says so, the depth being expanded is scored as far as it got.
+class LOOKAHEAD
+{
+public:
+	static const int MAX_ACTIONS = 9 + 16; // moves, then attacks
+
+	LOOKAHEAD();
+	// sizes the buffers of a search with beam_width, so searches do not
+	// allocate; Search calls it too, call it ahead where that is cheaper
+	void Reserve(int beam_width);
+	// false if the hero is not alive in root or stop() hit before a single
+	// state was scored; first is in side 0's view
+	bool Search(const SIMULATOR &Sim, const SIM_STATE &root, int hero_id, int depth, int beam_width,
+		const std::function<bool()> &stop, COMMAND &first);
+
+	// since the last ResetStats, over every Search
+	int64_t Nodes() const { return mNodes; }
+	double Milliseconds() const { return mNanoseconds / 1e6; }
+	double NodesPerMillisecond() const { return mNanoseconds>0 ? mNodes*1e6 / mNanoseconds : 0; }
+	void ResetStats() { mNodes = 0; mNanoseconds = 0; }
+
+private:
+	struct NODE
+	{
+		int state; // index into mStates
+		int first; // index into mFirst, the action it started with
+		int score;
+	};
+
+	int GetActions(const SIMULATOR &Sim, const SIM_STATE &state, int hero_id, COMMAND *actions) const;
+	static int Evaluate(const SIM_STATE &state, int hero_id);
+
+	// reused from search to search; states are big, so nodes refer to them
+	std::vector<SIM_STATE> mStates;
+	std::vector<COMMAND> mFirst;
+	std::vector<NODE> mBeam, mNext;
+	std::vector<COMMAND> mCommands[2];
+	int64_t mNodes;
+	int64_t mNanoseconds;
+};
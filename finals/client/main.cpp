@@ -0,0 +1,69 @@
+#include "Client.h"
+#include "stdafx.h"
+
+bool LoadPacket(const char *filename, std::vector<std::string> &Lines)
+{
+	std::ifstream debug_file(filename);
+	if (debug_file.is_open())
+	{
+		std::string line;
+		while (std::getline(debug_file, line))
+		{
+			Lines.push_back(line);
+		}
+		debug_file.close();
+		return true;
+	}
+	return false;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout.sync_with_stdio(false);
+	std::string server_address = "172.22.22.239";
+	std::string preferredOpponents = "test";
+	if (argc>1)
+	{
+		preferredOpponents = argv[1];
+	}
+	std::cout<<"playing against " + preferredOpponents<<std::endl;
+	CLIENT *pClient = CreateClient(preferredOpponents);
+	if (argc>2)
+	{
+		pClient->SetTickBudget(atoi(argv[2])*1000LL); // ms
+	}
+	if (argc>3 && std::string(argv[3]) == "replay")
+	{
+		pClient->SetDebugLogFormat(ASYNC_LOG::FORMAT_REPLAY); // replay.bin, see moba-pack
+	}
+	/* for debugging:  */
+	std::vector<std::string> test_state;
+	if (LoadPacket("test.txt", test_state))
+	{
+		std::vector<std::string> players, map;
+		if (LoadPacket("players.txt", players) &&
+			LoadPacket("map.txt", map))
+		{
+			pClient->mParser.ParsePlayers(players);
+			pClient->mParser.ParseMap(map);
+			pClient->UpdateDistCache(false);
+
+			std::string resp = pClient->DebugResponse(test_state);
+			std::cout<<"response: "<<resp <<std::endl;
+		}
+	}
+	/**/
+
+	pClient->strIPAddress = server_address;
+	if (!pClient->Init())
+	{
+		std::cout<<"Connection failed"<<std::endl;
+	} else
+	{
+		pClient->Run();
+	}
+	delete pClient;
+	return 0;
+}
+
+
@@ -0,0 +1,192 @@
+// Converts between debug.log and the binary replay.bin of replayfile.h.
+// Both directions stream, neither holds more than a frame in memory.
+//   moba-pack pack <debug.log> <replay.bin>   encode, prints the size ratio
+//   moba-pack text <replay.bin> <debug.log>   decode, byte for byte the log
+//                                             the text client would write
+//   moba-pack seek <replay.bin> <match> <tick> [count]
+//                                             print count frames from tick,
+//                                             with the time the seek took
+#include "stdafx.h"
+#include "replayfile.h"
+#include <chrono>
+#include <cstdlib>
+
+typedef std::chrono::steady_clock CLOCK;
+
+static int Usage(const char *argv0)
+{
+	std::cout << "usage: " << argv0 << " pack <debug.log> <replay.bin>" << std::endl;
+	std::cout << "       " << argv0 << " text <replay.bin> <debug.log>" << std::endl;
+	std::cout << "       " << argv0 << " seek <replay.bin> <match> <tick> [count]" << std::endl;
+	return 1;
+}
+
+static uint64_t FileSize(const char *filename)
+{
+	std::ifstream f(filename, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+	return f.is_open() ? (uint64_t)f.tellg() : 0;
+}
+
+static int Pack(const char *in_file, const char *out_file)
+{
+	std::ifstream in(in_file, std::ifstream::in | std::ifstream::binary);
+	if (!in.is_open())
+	{
+		std::cout << "Error: cannot open " << in_file << std::endl;
+		return 1;
+	}
+	std::ofstream out(out_file, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "Error: cannot write " << out_file << std::endl;
+		return 1;
+	}
+	out.write(REPLAY_FORMAT::MAGIC, REPLAY_FORMAT::MAGIC_SIZE);
+	REPLAY_WRITER writer;
+	std::vector<std::string> frame;
+	std::vector<LINE_VIEW> views;
+	std::string line, sent;
+	bool in_sent_block = false;
+	int frames = 0, answers = 0;
+	// the layout CLIENT::Run writes: frames up to their ".", what was sent
+	// after "Sent: ", tick answers on several lines up to their "."
+	while (std::getline(in, line))
+	{
+		if (in_sent_block)
+		{
+			sent += line;
+			sent += '\n';
+			if (line != ".") continue;
+			in_sent_block = false;
+		} else if (line.compare(0, 6, "Sent: ") == 0)
+		{
+			sent.assign(line, 6, std::string::npos);
+			sent += '\n';
+			in_sent_block = line.compare(6, 4, "tick") == 0;
+			if (in_sent_block) continue;
+		} else
+		{
+			frame.push_back(line);
+			if (line != ".") continue;
+			views.assign(frame.begin(), frame.end());
+			writer.AddFrame(views);
+			frame.clear();
+			frames++;
+		}
+		if (!sent.empty())
+		{
+			writer.AddSent(sent);
+			sent.clear();
+			answers++;
+		}
+		out.write(writer.Buffer().data(), writer.Buffer().size());
+		writer.ClearBuffer();
+	}
+	if (!frame.empty() || in_sent_block)
+	{
+		std::cout << "WARNING " << in_file << " ends inside a message, the rest is not packed" << std::endl;
+	}
+	out.close();
+	uint64_t in_size = FileSize(in_file), out_size = FileSize(out_file);
+	std::cout << frames << " frames, " << answers << " sent messages" << std::endl;
+	std::cout << in_size << " -> " << out_size << " bytes";
+	if (out_size>0) std::cout << ", " << double(in_size)/out_size << "x";
+	std::cout << std::endl;
+	return 0;
+}
+
+static int Text(const char *in_file, const char *out_file)
+{
+	REPLAY_READER reader;
+	if (!reader.Open(in_file))
+	{
+		std::cout << "Error: " << in_file << " is not a replay" << std::endl;
+		return 1;
+	}
+	std::ofstream out(out_file, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	if (!out.is_open())
+	{
+		std::cout << "Error: cannot write " << out_file << std::endl;
+		return 1;
+	}
+	REPLAY_FRAME frame;
+	std::string sent;
+	std::vector<std::string> lines;
+	for (;;)
+	{
+		REPLAY_READER::ITEM item = reader.Next(frame, sent);
+		if (item == REPLAY_READER::ITEM_END) break;
+		if (item == REPLAY_READER::ITEM_SENT)
+		{
+			out << "Sent: " << sent;
+			continue;
+		}
+		frame.WriteText(lines);
+		for (size_t i = 0; i<lines.size(); i++)
+		{
+			out << lines[i] << '\n';
+		}
+	}
+	if (reader.Corrupt())
+	{
+		std::cout << "WARNING " << in_file << " is truncated or corrupt, converted up to the broken record" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+static int Seek(const char *in_file, int match_id, int tick, int count)
+{
+	REPLAY_READER reader;
+	if (!reader.Open(in_file))
+	{
+		std::cout << "Error: " << in_file << " is not a replay" << std::endl;
+		return 1;
+	}
+	// the first seek builds the keyframe index, time a second one as well
+	for (int pass = 0; pass<2; pass++)
+	{
+		CLOCK::time_point start = CLOCK::now();
+		bool found = reader.Seek(match_id, tick);
+		int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(CLOCK::now() - start).count();
+		std::cout << (pass == 0 ? "seek with indexing: " : "seek: ") << us << "us" << std::endl;
+		if (!found)
+		{
+			std::cout << "match " << match_id << " has no tick " << tick << " or later" << std::endl;
+			return 1;
+		}
+	}
+	REPLAY_FRAME frame;
+	std::string sent;
+	std::vector<std::string> lines;
+	while (count>0)
+	{
+		REPLAY_READER::ITEM item = reader.Next(frame, sent);
+		if (item == REPLAY_READER::ITEM_END) break;
+		if (item == REPLAY_READER::ITEM_SENT)
+		{
+			std::cout << "Sent: " << sent;
+			continue;
+		}
+		if (frame.match_id != match_id) break;
+		frame.WriteText(lines);
+		for (size_t i = 0; i<lines.size(); i++)
+		{
+			std::cout << lines[i] << '\n';
+		}
+		count--;
+	}
+	std::cout << std::flush;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout.sync_with_stdio(false);
+	if (argc<4) return Usage(argv[0]);
+	std::string command = argv[1];
+	if (command == "pack" && argc == 4) return Pack(argv[2], argv[3]);
+	if (command == "text" && argc == 4) return Text(argv[2], argv[3]);
+	if (command == "seek" && (argc == 5 || argc == 6)) return Seek(argv[2], atoi(argv[3]), atoi(argv[4]), argc == 6 ? atoi(argv[5]) : 1);
+	return Usage(argv[0]);
+}
@@ -10,6 +10,244 @@ PARSER::PARSER()
 	match_result = PARSER::ONGOING;
 	w=h=0;
 	match_id = 0;
+	Units.reserve(UNIT_TABLE::RESERVED_UNITS);
+	Attacks.reserve(UNIT_TABLE::RESERVED_UNITS);
+	Respawns.reserve(UNIT_TABLE::FIXED_ID_LIMIT);
+}
+
+UNIT_TABLE::UNIT_TABLE()
+{
+	mSlots.reserve(FIXED_ID_LIMIT + RESERVED_UNITS);
+	mAlive.reserve(RESERVED_UNITS);
+	mNextAlive.reserve(RESERVED_UNITS);
+	mFreeSlots.reserve(RESERVED_UNITS);
+	mPending.reserve(RESERVED_UNITS);
+	mRemoved.reserve(RESERVED_UNITS);
+	// Rebuild keeps the hash tables at most half full
+	mHashIds.reserve(2 * RESERVED_UNITS);
+	mHashSlots.reserve(2 * RESERVED_UNITS);
+	mPrevHashIds.reserve(2 * RESERVED_UNITS);
+	mPrevHashSlots.reserve(2 * RESERVED_UNITS);
+	mSlots.resize(FIXED_ID_LIMIT);
+	Reset();
+}
+
+void UNIT_TABLE::Reset()
+{
+	mSlots.resize(FIXED_ID_LIMIT);
+	for (int i = 0; i<FIXED_ID_LIMIT; i++)
+	{
+		mSlots[i].id = -1;
+		mSlots[i].index = -1;
+		mSlots[i].changed = false;
+		mSlots[i].seen = false;
+	}
+	mAlive.clear();
+	mFreeSlots.clear();
+	mRemoved.clear();
+	mHashIds.assign(mHashIds.size(), -1);
+	mPrevHashIds.assign(mPrevHashIds.size(), -1);
+}
+
+int UNIT_TABLE::Find(const std::vector<int> &ids, const std::vector<int> &slots, int id)
+{
+	if (ids.empty()) return -1;
+	size_t mask = ids.size() - 1;
+	for (size_t h = (size_t(id) * 2654435761u) & mask;; h = (h + 1) & mask)
+	{
+		if (ids[h] == id) return slots[h];
+		if (ids[h] == -1) return -1;
+	}
+}
+
+void UNIT_TABLE::Insert(std::vector<int> &ids, std::vector<int> &slots, int id, int slot)
+{
+	size_t mask = ids.size() - 1;
+	size_t h = (size_t(id) * 2654435761u) & mask;
+	while (ids[h] != -1) h = (h + 1) & mask;
+	ids[h] = id;
+	slots[h] = slot;
+}
+
+void UNIT_TABLE::Rebuild(const std::vector<MAP_OBJECT> &Units)
+{
+	mRemoved.clear();
+	mPending.clear();
+	mNextAlive.clear();
+	mHashIds.swap(mPrevHashIds);
+	mHashSlots.swap(mPrevHashSlots);
+
+	// units that were already on the map keep their slot
+	for (int i = 0; i<(int)Units.size(); i++)
+	{
+		const MAP_OBJECT &unit = Units[i];
+		int slot = unit.id >= 0 && unit.id<FIXED_ID_LIMIT ? unit.id : Find(mPrevHashIds, mPrevHashSlots, unit.id);
+		if (slot == -1)
+		{
+			mPending.push_back(i);
+			continue;
+		}
+		SLOT &s = mSlots[slot];
+		if (s.seen) continue; // duplicate id, the first one wins like it used to
+		s.changed = s.id != unit.id || s.last.pos != unit.pos || s.last.hp != unit.hp;
+		s.id = unit.id;
+		s.index = i;
+		s.seen = true;
+		s.last = unit;
+		mNextAlive.push_back(slot);
+	}
+	for (size_t i = 0; i<mAlive.size(); i++)
+	{
+		SLOT &s = mSlots[mAlive[i]];
+		if (s.seen) continue;
+		mRemoved.push_back(s.last);
+		s.id = -1;
+		s.index = -1;
+		if (mAlive[i] >= FIXED_ID_LIMIT) mFreeSlots.push_back(mAlive[i]);
+	}
+	for (size_t i = 0; i<mPending.size(); i++)
+	{
+		int slot;
+		if (!mFreeSlots.empty())
+		{
+			slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		} else
+		{
+			slot = (int)mSlots.size();
+			mSlots.push_back(SLOT());
+		}
+		SLOT &s = mSlots[slot];
+		s.id = Units[mPending[i]].id;
+		s.index = mPending[i];
+		s.changed = true;
+		s.seen = false;
+		s.last = Units[mPending[i]];
+		mNextAlive.push_back(slot);
+	}
+
+	// fresh id -> slot map for the next tick, kept at most half full
+	size_t capacity = mHashIds.empty() ? 64 : mHashIds.size();
+	while (capacity < 2 * mNextAlive.size()) capacity *= 2;
+	mHashIds.assign(capacity, -1);
+	mHashSlots.resize(capacity);
+	for (size_t i = 0; i<mNextAlive.size(); i++)
+	{
+		SLOT &s = mSlots[mNextAlive[i]];
+		s.seen = false;
+		if (s.id >= FIXED_ID_LIMIT)
+		{
+			Insert(mHashIds, mHashSlots, s.id, mNextAlive[i]);
+		}
+	}
+	mAlive.swap(mNextAlive);
+}
+
+int UNIT_TABLE::GetSlot(int id) const
+{
+	if (id >= 0 && id<FIXED_ID_LIMIT) return mSlots[id].id == id ? id : -1;
+	return Find(mHashIds, mHashSlots, id);
+}
+
+int UNIT_TABLE::GetIndex(int id) const
+{
+	int slot = GetSlot(id);
+	return slot == -1 ? -1 : mSlots[slot].index;
+}
+
+bool UNIT_TABLE::Changed(int id) const
+{
+	int slot = GetSlot(id);
+	return slot != -1 && mSlots[slot].changed;
+}
+
+SPATIAL_GRID::SPATIAL_GRID()
+{
+	mBucketsX = mBucketsY = 1;
+	mBucketStart.assign(2, 0);
+	mEntries.reserve(UNIT_TABLE::RESERVED_UNITS);
+	mBucketOf.reserve(UNIT_TABLE::RESERVED_UNITS);
+	mPos.reserve(UNIT_TABLE::RESERVED_UNITS);
+}
+
+// units off the arena go to the edge buckets, queries are clamped the same way
+int SPATIAL_GRID::BucketX(int x) const
+{
+	return std::min(std::max(x / BUCKET, 0), mBucketsX - 1);
+}
+
+int SPATIAL_GRID::BucketY(int y) const
+{
+	return std::min(std::max(y / BUCKET, 0), mBucketsY - 1);
+}
+
+void SPATIAL_GRID::Rebuild(const std::vector<MAP_OBJECT> &Units, int w, int h)
+{
+	if (w<=0 || h<=0)
+	{
+		// no map yet (replays of ticks only), the units tell the extent
+		for (size_t i = 0; i<Units.size(); i++)
+		{
+			w = std::max(w, Units[i].pos.x + 1);
+			h = std::max(h, Units[i].pos.y + 1);
+		}
+	}
+	mBucketsX = std::max(1, (w + BUCKET - 1) / BUCKET);
+	mBucketsY = std::max(1, (h + BUCKET - 1) / BUCKET);
+	// counting sort, stable, so every bucket keeps the order of Units
+	mBucketStart.assign(mBucketsX*mBucketsY + 1, 0);
+	mBucketOf.resize(Units.size());
+	mPos.resize(Units.size());
+	for (size_t i = 0; i<Units.size(); i++)
+	{
+		mPos[i] = Units[i].pos;
+		mBucketOf[i] = BucketX(Units[i].pos.x) + BucketY(Units[i].pos.y)*mBucketsX;
+		mBucketStart[mBucketOf[i] + 1]++;
+	}
+	for (size_t b = 1; b<mBucketStart.size(); b++)
+	{
+		mBucketStart[b] += mBucketStart[b - 1];
+	}
+	mEntries.resize(Units.size());
+	for (size_t i = 0; i<Units.size(); i++)
+	{
+		mEntries[mBucketStart[mBucketOf[i]]++] = (int)i;
+	}
+	// the placement loop advanced every start to the next bucket's start
+	for (size_t b = mBucketStart.size() - 1; b>0; b--)
+	{
+		mBucketStart[b] = mBucketStart[b - 1];
+	}
+	mBucketStart[0] = 0;
+}
+
+void SPATIAL_GRID::Query(const Position &pos, int distance_sq, TICK_VECTOR<int> &out) const
+{
+	out.clear();
+	if (distance_sq<0) return;
+	int r = 0;
+	while ((r + 1)*(r + 1) <= distance_sq) r++;
+	int bx0 = BucketX(pos.x - r), bx1 = BucketX(pos.x + r);
+	int by0 = BucketY(pos.y - r), by1 = BucketY(pos.y + r);
+	for (int by = by0; by <= by1; by++)
+	{
+		for (int bx = bx0; bx <= bx1; bx++)
+		{
+			int b = bx + by*mBucketsX;
+			for (int e = mBucketStart[b]; e<mBucketStart[b + 1]; e++)
+			{
+				if (pos.DistSquare(mPos[mEntries[e]]) <= distance_sq) out.push_back(mEntries[e]);
+			}
+		}
+	}
+	std::sort(out.begin(), out.end());
+}
+
+SPATIAL_GRID::UNIT_RANGE SPATIAL_GRID::Near(const std::vector<MAP_OBJECT> &Units, const Position &pos, int distance_sq, TICK_VECTOR<int> &buffer) const
+{
+	Query(pos, distance_sq, buffer);
+	const int *indices = buffer.data();
+	return UNIT_RANGE(UNIT_ITERATOR(Units.begin(), indices), UNIT_ITERATOR(Units.begin(), indices + buffer.size()));
 }
 
 void PARSER::ParseMap(const std::vector<std::string> &ServerResponse)
@@ -112,93 +350,173 @@ int PARSER::GetDamageOfUnit(const MAP_OBJECT& unit) const {
 	return -1;
 }
 
-void PARSER::Parse(const std::vector<std::string> &ServerResponse)
+// Hand written scanners for the tick frames: no sscanf, no substr.
+static bool StartsWith(const LINE_VIEW &line, const char *keyword, size_t length)
+{
+	return line.size() >= length && memcmp(line.data(), keyword, length) == 0;
+}
+
+static const char *ScanInt(const char *p, const char *end, int &value)
+{
+	while (p<end && *p == ' ') p++;
+	bool negative = false;
+	if (p<end && *p == '-')
+	{
+		negative = true;
+		p++;
+	}
+	int v = 0;
+	while (p<end && *p >= '0' && *p <= '9')
+	{
+		v = v*10 + (*p - '0');
+		p++;
+	}
+	value = negative ? -v : v;
+	return p;
+}
+
+static LINE_VIEW ScanWord(const char *&p, const char *end)
+{
+	while (p<end && *p == ' ') p++;
+	const char *start = p;
+	while (p<end && *p != ' ') p++;
+	return LINE_VIEW(start, p - start);
+}
+
+// value of "keyword <int>" lines
+static int ParamInt(const LINE_VIEW &line, size_t keyword_length)
+{
+	int value = 0;
+	if (line.size()>keyword_length)
+	{
+		ScanInt(line.data() + keyword_length, line.data() + line.size(), value);
+	}
+	return value;
+}
+
+void PARSER::Parse(const std::vector<LINE_VIEW> &ServerResponse)
 {
 	tick = 0;
 	match_result = PARSER::ONGOING;
 	Units.clear();
 	Attacks.clear();
 	Controllers.clear();
+	Respawns.clear();
+	int prev_match_id = match_id;
 
+	const int lines = (int)ServerResponse.size();
 	int i;
-	for(i=0;i<(int)ServerResponse.size();i++)
+	for(i=0;i<lines;i++)
 	{
-		if (ServerResponse[i].empty()) continue;
-		char c = ServerResponse[i][0];
-		if (c=='t' && ServerResponse[i].substr(0, 4)=="tick")
+		const LINE_VIEW &line = ServerResponse[i];
+		if (line.empty()) continue;
+		const char *end = line.data() + line.size();
+		char c = line[0];
+		if (c=='t' && StartsWith(line, "tick", 4))
 		{
-			tick = atoi(ServerResponse[i].substr(5).c_str());
-		} else if (c=='m' && ServerResponse[i].substr(0, 5)=="match")
+			tick = ParamInt(line, 4);
+		} else if (c=='m' && StartsWith(line, "match", 5))
 		{
-			std::string param = ServerResponse[i].substr(6);
-			char type_name[20];
-			if (sscanf(param.c_str(), "%d %s", &match_id, type_name) == 2)
+			const char *p = line.data() + 5;
+			int id;
+			const char *after_id = ScanInt(p, end, id);
+			LINE_VIEW type_name = ScanWord(after_id, end);
+			if (!type_name.empty())
 			{
-				if (!strcmp(type_name, "melee")) match_type = PARSER::MELEE;
+				match_id = id;
+				if (type_name == "melee") match_type = PARSER::MELEE;
 				else match_type = PARSER::DUEL;
 			}
-		} else if (c == 'c' && ServerResponse[i].substr(0, 11)=="controllers")
+		} else if (c == 'c' && StartsWith(line, "controllers", 11))
 		{
-			int count = atoi(ServerResponse[i].substr(12).c_str());
-			for (int r = 0; r<count; r++)
+			int count = ParamInt(line, 11);
+			for (int r = 0; r<count && i+1<lines; r++)
 			{
+				const LINE_VIEW &l = ServerResponse[++i];
+				const char *p = l.data(), *e = l.data() + l.size();
 				CONTROLLER_INFO info;
-				sscanf(ServerResponse[i + r + 1].c_str(), "%d %d", &info.hero_id, &info.controller_id);
+				p = ScanInt(p, e, info.hero_id);
+				ScanInt(p, e, info.controller_id);
 				Controllers.push_back(info);
 			}
-		} else if (c == 'l' && ServerResponse[i].substr(0, 5) == "level")
+		} else if (c == 'l' && StartsWith(line, "level", 5))
 		{
-			std::string param = ServerResponse[i].substr(6);
-			if (sscanf(param.c_str(), "%d %d", &level[0], &level[1]) != 2)
+			const char *p = line.data() + 5;
+			while (p<end && *p == ' ') p++;
+			if (p == end)
 			{
 				level[0] = level[1] = 0;
+			} else
+			{
+				p = ScanInt(p, end, level[0]);
+				ScanInt(p, end, level[1]);
 			}
-		} else if (c == 'a' && ServerResponse[i].substr(0, 7) == "attacks")
+		} else if (c == 'a' && StartsWith(line, "attacks", 7))
 		{
-			int count = atoi(ServerResponse[i].substr(8).c_str());
-			for (int r = 0; r<count; r++)
+			int count = ParamInt(line, 7);
+			for (int r = 0; r<count && i+1<lines; r++)
 			{
+				const LINE_VIEW &l = ServerResponse[++i];
+				const char *p = l.data(), *e = l.data() + l.size();
 				ATTACK_INFO info;
-				sscanf(ServerResponse[i + r + 1].c_str(), "%d %d %d %d %d %d", &info.attacker_id, &info.attacker_pos.x, &info.attacker_pos.y, &info.target_id, &info.target_pos.x, &info.target_pos.y);
+				p = ScanInt(p, e, info.attacker_id);
+				p = ScanInt(p, e, info.attacker_pos.x);
+				p = ScanInt(p, e, info.attacker_pos.y);
+				p = ScanInt(p, e, info.target_id);
+				p = ScanInt(p, e, info.target_pos.x);
+				ScanInt(p, e, info.target_pos.y);
 				Attacks.push_back(info);
 			}
 		}
-		else if (c == 'r' && ServerResponse[i].substr(0, 8) == "respawns")
+		else if (c == 'r' && StartsWith(line, "respawns", 8))
 		{
-			int count = atoi(ServerResponse[i].substr(9).c_str());
-			for (int r = 0; r<count; r++)
+			int count = ParamInt(line, 8);
+			for (int r = 0; r<count && i+1<lines; r++)
 			{
+				const LINE_VIEW &l = ServerResponse[++i];
+				const char *p = l.data(), *e = l.data() + l.size();
 				RESPAWN_INFO info;
-				sscanf(ServerResponse[i + r + 1].c_str(), "%d %d %d", &info.hero_id, &info.side, &info.tick);
+				p = ScanInt(p, e, info.hero_id);
+				p = ScanInt(p, e, info.side);
+				ScanInt(p, e, info.tick);
 				Respawns.push_back(info);
 			}
-		} else if (c == 'u' && ServerResponse[i].substr(0, 5)=="units")
+		} else if (c == 'u' && StartsWith(line, "units", 5))
 		{
-			int count = atoi(ServerResponse[i].substr(6).c_str());
-			for (int r = 0; r<count; r++)
+			int count = ParamInt(line, 5);
+			for (int r = 0; r<count && i+1<lines; r++)
 			{
+				const LINE_VIEW &l = ServerResponse[++i];
+				const char *p = l.data(), *e = l.data() + l.size();
 				MAP_OBJECT ob;
-				char type_name[20];
-				sscanf(ServerResponse[i+r+1].c_str(), "%s %d %d %d %d %d", type_name, &ob.id, &ob.side, &ob.hp, &ob.pos.x, &ob.pos.y);
-				if (!strcmp(type_name, "hero"))
+				LINE_VIEW type_name = ScanWord(p, e);
+				if (type_name == "hero")
 				{
 					ob.t = HERO;
-				} else if (!strcmp(type_name, "minion"))
+				} else if (type_name == "minion")
 				{
 					ob.t = MINION;
-				} else if (!strcmp(type_name, "turret"))
+				} else if (type_name == "turret")
 				{
 					ob.t = TURRET;
 				}
-				else if (!strcmp(type_name, "base"))
+				else if (type_name == "base")
 				{
 					ob.t = BASE;
+				} else
+				{
+					continue;
 				}
+				p = ScanInt(p, e, ob.id);
+				p = ScanInt(p, e, ob.side);
+				p = ScanInt(p, e, ob.hp);
+				p = ScanInt(p, e, ob.pos.x);
+				ScanInt(p, e, ob.pos.y);
 				Units.push_back(ob);
 			}
-		} else if (c == 'f' && ServerResponse[i].substr(0, 8)=="finished")
+		} else if (c == 'f' && StartsWith(line, "finished", 8))
 		{
-			std::string res = ServerResponse[i].substr(9);
+			LINE_VIEW res = line.size()>9 ? line.substr(9) : LINE_VIEW();
 			if (res=="victory")
 				match_result = PARSER::VICTORY;
 			else if (res=="draw")
@@ -207,18 +525,24 @@ void PARSER::Parse(const std::vector<std::string> &ServerResponse)
 				match_result = PARSER::DEFEAT;
 		}
 	}
+	if (match_id != prev_match_id)
+	{
+		UnitTable.Reset();
+	}
+	UnitTable.Rebuild(Units);
+	Grid.Rebuild(Units, w, h);
 }
 
 const MAP_OBJECT *PARSER::GetUnitByID(int id) const
 {
-	for (std::vector<MAP_OBJECT>::const_iterator it=Units.begin();it!=Units.end();++it) { if (it->id == id) return &*it; }
-	return NULL;
+	int index = UnitTable.GetIndex(id);
+	return index == -1 ? NULL : &Units[index];
 }
 
 MAP_OBJECT *PARSER::GetUnitByID(int id)
 {
-	for (std::vector<MAP_OBJECT>::iterator it=Units.begin();it!=Units.end();++it) { if (it->id == id) return &*it; }
-	return NULL;
+	int index = UnitTable.GetIndex(id);
+	return index == -1 ? NULL : &Units[index];
 }
 
 PLAYER_INFO *PARSER::GetPlayerByID(int player_id)
@@ -1,7 +1,14 @@
 #pragma once
 #include "Position.h"
+#include "arena.h"
 #include <vector>
 #include <string>
+#include <boost/utility/string_view.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/iterator/permutation_iterator.hpp>
+
+// a line of a server frame, pointing into the receive buffer
+typedef boost::string_view LINE_VIEW;
 
 static const int BASE_MAX_HP = 10000;
 static const int TURRET_MAX_HP = 2000;
@@ -52,6 +59,89 @@ struct PLAYER_INFO
 	std::string name;
 };
 
+// Dense id -> unit lookup, rebuilt in place by PARSER::Parse every tick.
+// Every unit on the map owns a slot. Ids below FIXED_ID_LIMIT (heroes, bases,
+// turrets) use their id as slot, other ids (minions) get a slot from a free
+// list and keep it for as long as they are alive. Storage only grows to the
+// peak number of units seen at once, so it stays flat over long sessions.
+class UNIT_TABLE
+{
+public:
+	static const int FIXED_ID_LIMIT = 64;
+	// storage for this many units is reserved up front, by the other per tick
+	// containers too, so busy ticks of a match do not allocate
+	static const int RESERVED_UNITS = 256;
+
+	UNIT_TABLE();
+	void Reset(); // forget the previous tick, e.g. when a new match starts
+	void Rebuild(const std::vector<MAP_OBJECT> &Units);
+
+	int GetSlot(int id) const; // -1 if the unit is not on the map
+	int GetIndex(int id) const; // index into PARSER::Units, -1 if not on the map
+	bool Changed(int id) const; // appeared, moved or lost hp since the previous tick
+	bool SlotChanged(int slot) const { return mSlots[slot].changed; }
+	int SlotId(int slot) const { return mSlots[slot].id; } // -1 for free slots
+	int SlotIndex(int slot) const { return mSlots[slot].index; } // into Units, -1 for free slots
+	int SlotCount() const { return (int)mSlots.size(); }
+
+	// units of the previous tick which are gone now, as they were last seen
+	const std::vector<MAP_OBJECT> &Removed() const { return mRemoved; }
+
+private:
+	struct SLOT
+	{
+		int id; // -1 if free
+		int index; // into Units
+		bool changed;
+		bool seen; // scratch flag of Rebuild
+		MAP_OBJECT last;
+	};
+	std::vector<SLOT> mSlots;
+	std::vector<int> mAlive; // slots in use after the last Rebuild
+	std::vector<int> mNextAlive;
+	std::vector<int> mFreeSlots;
+	std::vector<int> mPending; // indices of units which need a new slot
+	std::vector<MAP_OBJECT> mRemoved;
+
+	// open addressing id -> slot map for the ids above FIXED_ID_LIMIT;
+	// rebuilt from scratch each tick, so it needs no tombstones
+	std::vector<int> mHashIds, mHashSlots;
+	std::vector<int> mPrevHashIds, mPrevHashSlots;
+	static int Find(const std::vector<int> &ids, const std::vector<int> &slots, int id);
+	static void Insert(std::vector<int> &ids, std::vector<int> &slots, int id, int slot);
+};
+
+// Units bucketed by position, rebuilt in place by PARSER::Parse every tick.
+// The arena is cut into BUCKET x BUCKET squares and a radius query only
+// visits the buckets its bounding box touches. Results are indices into
+// Units in Units order, so code which breaks ties by order (first found,
+// front()) gives the same answer as a scan over all of Units.
+class SPATIAL_GRID
+{
+public:
+	static const int BUCKET = 4;
+	typedef boost::permutation_iterator<std::vector<MAP_OBJECT>::const_iterator, const int *> UNIT_ITERATOR;
+	typedef boost::iterator_range<UNIT_ITERATOR> UNIT_RANGE;
+
+	SPATIAL_GRID();
+	void Rebuild(const std::vector<MAP_OBJECT> &Units, int w, int h);
+
+	// indices of the units with DistSquare(pos) <= distance_sq; out is cleared first
+	void Query(const Position &pos, int distance_sq, TICK_VECTOR<int> &out) const;
+	// the same units, through the indices Query put into buffer; valid while
+	// buffer is left alone and until the next Rebuild
+	UNIT_RANGE Near(const std::vector<MAP_OBJECT> &Units, const Position &pos, int distance_sq, TICK_VECTOR<int> &buffer) const;
+
+private:
+	int mBucketsX, mBucketsY;
+	std::vector<int> mBucketStart; // first entry of each bucket, plus the end
+	std::vector<int> mEntries; // unit indices grouped by bucket, in Units order
+	std::vector<int> mBucketOf; // scratch of Rebuild
+	std::vector<Position> mPos; // of each unit, so queries do not touch Units
+	int BucketX(int x) const;
+	int BucketY(int y) const;
+};
+
 class PARSER
 {
 public:
@@ -81,10 +171,15 @@ public:
 	std::vector<CONTROLLER_INFO> Controllers;
 	std::vector<ATTACK_INFO> Attacks;
 	std::vector<RESPAWN_INFO> Respawns;
+	UNIT_TABLE UnitTable; // id lookups into Units, rebuilt by Parse
+	SPATIAL_GRID Grid; // position lookups into Units, rebuilt by Parse
 
 	GROUND_TYPE GetAt(const Position &p) const;
 	MAP_OBJECT *GetUnitByID(int id);
 	const MAP_OBJECT *GetUnitByID(int id) const;
+	bool UnitChanged(int id) const { return UnitTable.Changed(id); }
+	// units with DistSquare(pos) <= distance_sq, valid until the next call
+	SPATIAL_GRID::UNIT_RANGE GetUnitsNear(const Position &pos, int distance_sq, TICK_VECTOR<int> &buffer) const { return Grid.Near(Units, pos, distance_sq, buffer); }
 	PLAYER_INFO *GetPlayerByID(int player_id);
 	enum MATCH_RESULT {
 		ONGOING,
@@ -93,7 +188,7 @@ public:
 		DEFEAT
 	};
 	MATCH_RESULT match_result;
-	void Parse(const std::vector<std::string> &ServerResponse);
+	void Parse(const std::vector<LINE_VIEW> &ServerResponse); // does not allocate once Units etc. are warmed up
 	void ParseMap(const std::vector<std::string> &ServerResponse);
 	void ParsePlayers(const std::vector<std::string> &ServerResponse);
 
@@ -0,0 +1,160 @@
+// Offline replay: streams the frames of a recorded debug.log through
+// CLIENT::HandleServerResponse as fast as it can, reports ticks per second
+// and the latency of the ticks, and optionally checks the answers against a
+// golden log.
+//   moba-replay [options] <map.txt> <debug.log>
+//     -p <players.txt>  parse the players first (names in the match banner)
+//     -g <golden.log>   compare the tick answers with the "Sent: tick" blocks
+//                       of this log; the debug.log itself works too
+//     -r <out.log>      write the tick answers in debug.log format, to be
+//                       used as -g for a later build
+//     -b <budget_us>    tick budget, 0 (no deadline) by default so the
+//                       answers do not depend on the machine
+//     -n <passes>       replay the log this many times, answers are only
+//                       checked and recorded in the first pass
+#include "stdafx.h"
+#include "Client.h"
+#include "debuglog.h"
+#include "latency.h"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+typedef std::chrono::steady_clock CLOCK;
+
+static const int MAX_REPORTED_DIFFS = 5;
+
+static std::string OneLine(std::string text)
+{
+	for (size_t i = 0; i<text.size(); i++)
+	{
+		if (text[i] == '\n') text[i] = '|';
+	}
+	return text;
+}
+
+static int Usage(const char *argv0)
+{
+	std::cout << "usage: " << argv0 << " [-p players.txt] [-g golden.log] [-r out.log] [-b budget_us] [-n passes] <map.txt> <debug.log>" << std::endl;
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout.sync_with_stdio(false);
+	const char *players_file = NULL;
+	const char *golden_file = NULL;
+	const char *record_file = NULL;
+	int64_t budget_us = 0;
+	int passes = 1;
+	std::vector<const char *> positional;
+	for (int i = 1; i<argc; i++)
+	{
+		if (argv[i][0] == '-' && argv[i][1] != 0 && argv[i][2] == 0 && i + 1<argc)
+		{
+			const char *value = argv[++i];
+			switch (argv[i - 1][1])
+			{
+				case 'p': players_file = value; break;
+				case 'g': golden_file = value; break;
+				case 'r': record_file = value; break;
+				case 'b': budget_us = atoll(value); break;
+				case 'n': passes = atoi(value); break;
+				default: return Usage(argv[0]);
+			}
+		} else
+		{
+			positional.push_back(argv[i]);
+		}
+	}
+	if (positional.size() != 2 || passes<1) return Usage(argv[0]);
+	const char *map_file = positional[0];
+	const char *log_file = positional[1];
+
+	std::vector<std::string> players, map;
+	std::vector<std::vector<std::string> > frames;
+	if (!LoadLines(map_file, map))
+	{
+		std::cout << "Error: cannot read " << map_file << std::endl;
+		return 1;
+	}
+	if (players_file != NULL && !LoadLines(players_file, players))
+	{
+		std::cout << "Error: cannot read " << players_file << std::endl;
+		return 1;
+	}
+	if (!LoadDebugLogFrames(log_file, frames) || frames.empty())
+	{
+		std::cout << "Error: no frames in " << log_file << std::endl;
+		return 1;
+	}
+	std::vector<std::string> golden;
+	if (golden_file != NULL && !LoadDebugLogAnswers(golden_file, golden))
+	{
+		std::cout << "Error: cannot read " << golden_file << std::endl;
+		return 1;
+	}
+	std::ofstream record;
+	if (record_file != NULL)
+	{
+		record.open(record_file);
+		if (!record.is_open())
+		{
+			std::cout << "Error: cannot write " << record_file << std::endl;
+			return 1;
+		}
+	}
+
+	std::unique_ptr<CLIENT> client(CreateClient());
+	client->SetTickBudget(budget_us);
+	if (!players.empty()) client->mParser.ParsePlayers(players);
+	client->mParser.ParseMap(map);
+	client->UpdateDistCache(false);
+
+	LATENCY_HISTOGRAM latency;
+	size_t answers = 0, diffs = 0;
+	CLOCK::time_point start = CLOCK::now();
+	for (int pass = 0; pass<passes; pass++)
+	{
+		for (size_t f = 0; f<frames.size(); f++)
+		{
+			CLOCK::time_point tick_start = CLOCK::now();
+			std::string response = client->DebugResponse(frames[f]);
+			latency.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(CLOCK::now() - tick_start).count());
+			if (pass>0 || response.compare(0, 4, "tick") != 0) continue;
+			if (record.is_open()) record << "Sent: " << response << "\n";
+			if (golden_file != NULL && answers<golden.size() && response != golden[answers])
+			{
+				if (diffs<MAX_REPORTED_DIFFS)
+				{
+					std::cout << "DIFF answer " << answers << " (frame " << f << ")" << std::endl;
+					std::cout << "  expected: " << OneLine(golden[answers]) << std::endl;
+					std::cout << "  got:      " << OneLine(response) << std::endl;
+				}
+				diffs++;
+			}
+			answers++;
+		}
+	}
+	double seconds = std::chrono::duration<double>(CLOCK::now() - start).count();
+
+	std::cout << "replayed " << frames.size() << " frames x " << passes << " in " << seconds << "s, "
+		<< latency.Count() / seconds << " ticks/s" << std::endl;
+	std::cout << "tick latency: mean " << latency.Mean() / 1000.0 << "us p50 " << latency.Percentile(0.5) / 1000.0
+		<< "us p90 " << latency.Percentile(0.9) / 1000.0 << "us p99 " << latency.Percentile(0.99) / 1000.0
+		<< "us max " << latency.Max() / 1000.0 << "us" << std::endl;
+	client->mLatency.Print(std::cout); // the stages of a match that did not end in the log
+	if (golden_file == NULL) return 0;
+	if (answers != golden.size())
+	{
+		std::cout << "DIFF " << answers << " answers, golden has " << golden.size() << std::endl;
+		return 1;
+	}
+	if (diffs>0)
+	{
+		std::cout << "DIFF " << diffs << " of " << answers << " answers differ" << std::endl;
+		return 1;
+	}
+	std::cout << "all " << answers << " answers match " << golden_file << std::endl;
+	return 0;
+}
@@ -0,0 +1,802 @@
+#include "stdafx.h"
+#include "replayfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+const char REPLAY_FORMAT::MAGIC[] = "MOBAREPLAY1\n";
+
+static void PutVarint(std::string &out, uint64_t v)
+{
+	while (v>=0x80)
+	{
+		out.push_back(char(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back(char(v));
+}
+
+static void PutSigned(std::string &out, int64_t v)
+{
+	PutVarint(out, (uint64_t(v)<<1) ^ uint64_t(v>>63)); // zigzag
+}
+
+// reads a record body; a read past its end sets failed and returns zeros
+struct BODY_READER
+{
+	const std::string &in;
+	size_t &pos;
+	bool failed;
+
+	BODY_READER(const std::string &body, size_t &at) : in(body), pos(at), failed(false) {}
+	uint64_t Varint()
+	{
+		uint64_t v = 0;
+		for (int shift = 0; shift<64; shift += 7)
+		{
+			if (pos>=in.size()) break;
+			unsigned char c = (unsigned char)in[pos++];
+			v |= uint64_t(c & 0x7f)<<shift;
+			if (c<0x80) return v;
+		}
+		failed = true;
+		return 0;
+	}
+	int Signed()
+	{
+		uint64_t v = Varint();
+		return int(int64_t(v>>1) ^ -int64_t(v & 1));
+	}
+	bool Bytes(std::string &out, size_t length)
+	{
+		if (length>in.size() - pos)
+		{
+			failed = true;
+			return false;
+		}
+		out.assign(in, pos, length);
+		pos += length;
+		return true;
+	}
+};
+
+static const char *TypeName(UNIT_TYPE t)
+{
+	switch (t)
+	{
+		case HERO: return "hero";
+		case BASE: return "base";
+		case TURRET: return "turret";
+		case MINION: return "minion";
+	}
+	return "?";
+}
+
+static void IndexById(const std::vector<MAP_OBJECT> &Units, std::vector<std::pair<int, int> > &ById)
+{
+	ById.clear();
+	for (size_t i = 0; i<Units.size(); i++)
+	{
+		ById.push_back(std::make_pair(Units[i].id, (int)i));
+	}
+	std::sort(ById.begin(), ById.end());
+}
+
+static const MAP_OBJECT *FindById(const std::vector<MAP_OBJECT> &Units, const std::vector<std::pair<int, int> > &ById, int id)
+{
+	std::vector<std::pair<int, int> >::const_iterator it = std::lower_bound(ById.begin(), ById.end(), std::make_pair(id, -1));
+	return it != ById.end() && it->first == id ? &Units[it->second] : NULL;
+}
+
+// a step of at most one cell as 0..8, 9 if farther
+static int StepCode(int dx, int dy)
+{
+	return std::abs(dx)<=1 && std::abs(dy)<=1 ? (dx + 1) + 3*(dy + 1) : 9;
+}
+
+static const int FAR_ATTACK = 81; // the attack positions are not all within a cell of their units
+
+static bool SameRespawns(const std::vector<RESPAWN_INFO> &a, const std::vector<RESPAWN_INFO> &b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i<a.size(); i++)
+	{
+		if (a[i].hero_id != b[i].hero_id || a[i].side != b[i].side || a[i].tick != b[i].tick) return false;
+	}
+	return true;
+}
+
+static bool SameControllers(const std::vector<CONTROLLER_INFO> &a, const std::vector<CONTROLLER_INFO> &b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i<a.size(); i++)
+	{
+		if (a[i].hero_id != b[i].hero_id || a[i].controller_id != b[i].controller_id) return false;
+	}
+	return true;
+}
+
+// Frame against prev, an empty frame for keyframes. by_id holds prev's units
+// on entry and frame's when it returns.
+static void EncodeFrame(const REPLAY_FRAME &prev, const REPLAY_FRAME &frame, std::vector<std::pair<int, int> > &by_id, std::string &out)
+{
+	bool controllers = !SameControllers(prev.Controllers, frame.Controllers);
+	bool respawns = !SameRespawns(prev.Respawns, frame.Respawns);
+	out.push_back(char((frame.match_type == PARSER::MELEE ? 1 : 0) | frame.match_result<<1 | (controllers ? 8 : 0) | (respawns ? 16 : 0)));
+	PutSigned(out, frame.level[0] - prev.level[0]);
+	PutSigned(out, frame.level[1] - prev.level[1]);
+	if (controllers)
+	{
+		PutVarint(out, frame.Controllers.size());
+		for (size_t i = 0; i<frame.Controllers.size(); i++)
+		{
+			PutSigned(out, frame.Controllers[i].hero_id);
+			PutSigned(out, frame.Controllers[i].controller_id);
+		}
+	}
+
+	// units: a flag byte each, bit 0 for the id after the previous one, bit
+	// 1 for a unit not in prev, bits 2..5 its step, bit 6 if its hp changed
+	PutVarint(out, frame.Units.size());
+	int last_id = 0;
+	for (size_t i = 0; i<frame.Units.size(); i++)
+	{
+		const MAP_OBJECT &u = frame.Units[i];
+		const MAP_OBJECT *p = FindById(prev.Units, by_id, u.id);
+		int flags = u.id == last_id + 1 ? 1 : 0;
+		bool is_new = p == NULL || p->t != u.t || p->side != u.side;
+		int dx = 0, dy = 0, code = 0;
+		if (is_new)
+		{
+			flags |= 2;
+		} else
+		{
+			dx = u.pos.x - p->pos.x;
+			dy = u.pos.y - p->pos.y;
+			code = StepCode(dx, dy);
+			flags |= code<<2;
+			if (u.hp != p->hp) flags |= 64;
+		}
+		out.push_back(char(flags));
+		if (!(flags & 1)) PutSigned(out, u.id - last_id);
+		if (is_new)
+		{
+			PutVarint(out, u.t);
+			PutSigned(out, u.side);
+			PutSigned(out, u.hp);
+			PutSigned(out, u.pos.x);
+			PutSigned(out, u.pos.y);
+		} else
+		{
+			if (code == 9)
+			{
+				PutSigned(out, dx);
+				PutSigned(out, dy);
+			}
+			if (flags & 64) PutSigned(out, u.hp - p->hp);
+		}
+		last_id = u.id;
+	}
+
+	// attacks: ids against the previous attack, positions against where
+	// the units are in this frame
+	IndexById(frame.Units, by_id);
+	PutVarint(out, frame.Attacks.size());
+	int last_attacker = 0, last_target = 0;
+	for (size_t i = 0; i<frame.Attacks.size(); i++)
+	{
+		const ATTACK_INFO &a = frame.Attacks[i];
+		PutSigned(out, a.attacker_id - last_attacker);
+		PutSigned(out, a.target_id - last_target);
+		last_attacker = a.attacker_id;
+		last_target = a.target_id;
+		const MAP_OBJECT *attacker = FindById(frame.Units, by_id, a.attacker_id);
+		const MAP_OBJECT *target = FindById(frame.Units, by_id, a.target_id);
+		Position base_a = attacker != NULL ? attacker->pos : Position(0, 0);
+		Position base_t = target != NULL ? target->pos : a.attacker_pos;
+		int code_a = StepCode(a.attacker_pos.x - base_a.x, a.attacker_pos.y - base_a.y);
+		int code_t = StepCode(a.target_pos.x - base_t.x, a.target_pos.y - base_t.y);
+		if (code_a<9 && code_t<9)
+		{
+			PutVarint(out, code_a + 9*code_t);
+			continue;
+		}
+		PutVarint(out, FAR_ATTACK);
+		PutSigned(out, a.attacker_pos.x - base_a.x);
+		PutSigned(out, a.attacker_pos.y - base_a.y);
+		PutSigned(out, a.target_pos.x - base_t.x);
+		PutSigned(out, a.target_pos.y - base_t.y);
+	}
+
+	if (respawns)
+	{
+		PutVarint(out, frame.Respawns.size());
+		for (size_t i = 0; i<frame.Respawns.size(); i++)
+		{
+			PutSigned(out, frame.Respawns[i].hero_id);
+			PutSigned(out, frame.Respawns[i].side);
+			PutSigned(out, frame.Respawns[i].tick - frame.tick);
+		}
+	}
+}
+
+// the other way around; by_id holds prev's units on entry, frame's after
+static bool DecodeFrameBody(BODY_READER &in, const REPLAY_FRAME &prev, std::vector<std::pair<int, int> > &by_id, REPLAY_FRAME &frame)
+{
+	if (in.pos>=in.in.size()) return false;
+	int flags = (unsigned char)in.in[in.pos++];
+	frame.match_type = flags & 1 ? PARSER::MELEE : PARSER::DUEL;
+	frame.match_result = PARSER::MATCH_RESULT((flags>>1) & 3);
+	frame.level[0] = prev.level[0] + in.Signed();
+	frame.level[1] = prev.level[1] + in.Signed();
+	if (flags & 8)
+	{
+		frame.Controllers.resize(std::min<uint64_t>(in.Varint(), in.in.size()));
+		for (size_t i = 0; i<frame.Controllers.size(); i++)
+		{
+			frame.Controllers[i].hero_id = in.Signed();
+			frame.Controllers[i].controller_id = in.Signed();
+		}
+	} else
+	{
+		frame.Controllers = prev.Controllers;
+	}
+
+	frame.Units.resize(std::min<uint64_t>(in.Varint(), in.in.size()));
+	int last_id = 0;
+	for (size_t i = 0; i<frame.Units.size() && !in.failed; i++)
+	{
+		MAP_OBJECT &u = frame.Units[i];
+		if (in.pos>=in.in.size()) return false;
+		int unit_flags = (unsigned char)in.in[in.pos++];
+		u.id = unit_flags & 1 ? last_id + 1 : last_id + in.Signed();
+		if (unit_flags & 2)
+		{
+			u.t = UNIT_TYPE(in.Varint() & 3);
+			u.side = in.Signed();
+			u.hp = in.Signed();
+			u.pos.x = in.Signed();
+			u.pos.y = in.Signed();
+		} else
+		{
+			const MAP_OBJECT *p = FindById(prev.Units, by_id, u.id);
+			if (p == NULL) return false;
+			u = *p;
+			int code = (unit_flags>>2) & 15;
+			if (code == 9)
+			{
+				u.pos.x += in.Signed();
+				u.pos.y += in.Signed();
+			} else
+			{
+				u.pos.x += code%3 - 1;
+				u.pos.y += code/3 - 1;
+			}
+			if (unit_flags & 64) u.hp += in.Signed();
+		}
+		last_id = u.id;
+	}
+
+	IndexById(frame.Units, by_id);
+	frame.Attacks.resize(std::min<uint64_t>(in.Varint(), in.in.size()));
+	int last_attacker = 0, last_target = 0;
+	for (size_t i = 0; i<frame.Attacks.size() && !in.failed; i++)
+	{
+		ATTACK_INFO &a = frame.Attacks[i];
+		a.attacker_id = last_attacker + in.Signed();
+		a.target_id = last_target + in.Signed();
+		last_attacker = a.attacker_id;
+		last_target = a.target_id;
+		const MAP_OBJECT *attacker = FindById(frame.Units, by_id, a.attacker_id);
+		const MAP_OBJECT *target = FindById(frame.Units, by_id, a.target_id);
+		Position base_a = attacker != NULL ? attacker->pos : Position(0, 0);
+		int code = (int)in.Varint();
+		if (code == FAR_ATTACK)
+		{
+			// one read per statement, argument order is unspecified
+			int dx = in.Signed();
+			int dy = in.Signed();
+			a.attacker_pos = Position(base_a.x + dx, base_a.y + dy);
+			Position base_t = target != NULL ? target->pos : a.attacker_pos;
+			dx = in.Signed();
+			dy = in.Signed();
+			a.target_pos = Position(base_t.x + dx, base_t.y + dy);
+		} else
+		{
+			int code_a = code%9, code_t = code/9;
+			a.attacker_pos = Position(base_a.x + code_a%3 - 1, base_a.y + code_a/3 - 1);
+			Position base_t = target != NULL ? target->pos : a.attacker_pos;
+			a.target_pos = Position(base_t.x + code_t%3 - 1, base_t.y + code_t/3 - 1);
+		}
+	}
+
+	if (flags & 16)
+	{
+		frame.Respawns.resize(std::min<uint64_t>(in.Varint(), in.in.size()));
+		for (size_t i = 0; i<frame.Respawns.size(); i++)
+		{
+			frame.Respawns[i].hero_id = in.Signed();
+			frame.Respawns[i].side = in.Signed();
+			frame.Respawns[i].tick = frame.tick + in.Signed();
+		}
+	} else
+	{
+		frame.Respawns = prev.Respawns;
+	}
+	frame.RawLines.clear();
+	return !in.failed;
+}
+
+// a SENT_COMMANDS body back to the answer text; moves are encoded as steps
+// from where the hero stands in frame, by_id holds frame's units
+static bool DecodeCommands(BODY_READER &in, const REPLAY_FRAME &frame, const std::vector<std::pair<int, int> > &by_id, std::string &out)
+{
+	char line[64];
+	sprintf(line, "tick %d\n", frame.tick + in.Signed());
+	out = line;
+	for (uint64_t count = in.Varint(); count>0 && !in.failed; count--)
+	{
+		uint64_t kind = in.Varint();
+		int hero_id = int(kind/2);
+		if (kind%2 == 0)
+		{
+			sprintf(line, "attack %d %d\n", hero_id, in.Signed());
+		} else
+		{
+			const MAP_OBJECT *hero = FindById(frame.Units, by_id, hero_id);
+			Position base = hero != NULL ? hero->pos : Position(0, 0);
+			int code = (int)in.Varint();
+			int dx = code%3 - 1, dy = code/3 - 1;
+			if (code == 9)
+			{
+				dx = in.Signed();
+				dy = in.Signed();
+			}
+			sprintf(line, "move %d %d %d\n", hero_id, base.x + dx, base.y + dy);
+		}
+		out += line;
+	}
+	out += ".\n";
+	return !in.failed;
+}
+
+REPLAY_FRAME::REPLAY_FRAME()
+{
+	Clear();
+}
+
+void REPLAY_FRAME::Clear()
+{
+	match_id = 0;
+	tick = 0;
+	match_type = PARSER::DUEL;
+	match_result = PARSER::ONGOING;
+	level[0] = level[1] = 0;
+	Controllers.clear();
+	Units.clear();
+	Attacks.clear();
+	Respawns.clear();
+	RawLines.clear();
+}
+
+void REPLAY_FRAME::Assign(const PARSER &Parser)
+{
+	match_id = Parser.match_id;
+	tick = Parser.tick;
+	match_type = Parser.match_type;
+	match_result = Parser.match_result;
+	level[0] = Parser.level[0];
+	level[1] = Parser.level[1];
+	Controllers.assign(Parser.Controllers.begin(), Parser.Controllers.end());
+	Units.assign(Parser.Units.begin(), Parser.Units.end());
+	Attacks.assign(Parser.Attacks.begin(), Parser.Attacks.end());
+	Respawns.assign(Parser.Respawns.begin(), Parser.Respawns.end());
+	RawLines.clear();
+}
+
+void REPLAY_FRAME::WriteText(std::vector<std::string> &Lines) const
+{
+	Lines.clear();
+	if (!RawLines.empty())
+	{
+		Lines = RawLines;
+		return;
+	}
+	char line[128];
+	sprintf(line, "tick %d", tick);
+	Lines.push_back(line);
+	sprintf(line, "match %d %s", match_id, match_type == PARSER::MELEE ? "melee" : "duel");
+	Lines.push_back(line);
+	sprintf(line, "controllers %d", (int)Controllers.size());
+	Lines.push_back(line);
+	for (size_t i = 0; i<Controllers.size(); i++)
+	{
+		sprintf(line, "%d %d", Controllers[i].hero_id, Controllers[i].controller_id);
+		Lines.push_back(line);
+	}
+	sprintf(line, "level %d %d", level[0], level[1]);
+	Lines.push_back(line);
+	sprintf(line, "units %d", (int)Units.size());
+	Lines.push_back(line);
+	for (size_t i = 0; i<Units.size(); i++)
+	{
+		const MAP_OBJECT &u = Units[i];
+		sprintf(line, "%s %d %d %d %d %d", TypeName(u.t), u.id, u.side, u.hp, u.pos.x, u.pos.y);
+		Lines.push_back(line);
+	}
+	sprintf(line, "attacks %d", (int)Attacks.size());
+	Lines.push_back(line);
+	for (size_t i = 0; i<Attacks.size(); i++)
+	{
+		const ATTACK_INFO &a = Attacks[i];
+		sprintf(line, "%d %d %d %d %d %d", a.attacker_id, a.attacker_pos.x, a.attacker_pos.y, a.target_id, a.target_pos.x, a.target_pos.y);
+		Lines.push_back(line);
+	}
+	sprintf(line, "respawns %d", (int)Respawns.size());
+	Lines.push_back(line);
+	for (size_t i = 0; i<Respawns.size(); i++)
+	{
+		sprintf(line, "%d %d %d", Respawns[i].hero_id, Respawns[i].side, Respawns[i].tick);
+		Lines.push_back(line);
+	}
+	if (match_result != PARSER::ONGOING)
+	{
+		Lines.push_back(match_result == PARSER::VICTORY ? "finished victory" : match_result == PARSER::DRAW ? "finished draw" : "finished defeat");
+	}
+	Lines.push_back(".");
+}
+
+REPLAY_WRITER::REPLAY_WRITER()
+{
+	mFramesSinceKeyframe = -1;
+}
+
+void REPLAY_WRITER::Reset()
+{
+	mFramesSinceKeyframe = -1;
+	mPrev.Clear();
+	mFrame.Clear();
+}
+
+void REPLAY_WRITER::AddRecord(REPLAY_FORMAT::RECORD_TYPE type, const std::string &body)
+{
+	// the length, then type, match id and tick in front of the body
+	mHeader.clear();
+	mHeader.push_back(char(type));
+	PutVarint(mHeader, (uint64_t)std::max(mFrame.match_id, 0));
+	PutVarint(mHeader, (uint64_t)std::max(mFrame.tick, 0));
+	PutVarint(mOut, mHeader.size() + body.size());
+	mOut += mHeader;
+	mOut += body;
+}
+
+void REPLAY_WRITER::AddFrame(const std::vector<LINE_VIEW> &Lines)
+{
+	mParser.Parse(Lines);
+	mFrame.Assign(mParser);
+	mFrame.WriteText(mText);
+	bool same = mText.size() == Lines.size();
+	for (size_t i = 0; same && i<Lines.size(); i++)
+	{
+		same = Lines[i] == mText[i];
+	}
+	if (!same)
+	{
+		for (size_t i = 0; i<Lines.size(); i++)
+		{
+			mFrame.RawLines.push_back(std::string(Lines[i].data(), Lines[i].size()));
+		}
+	}
+	EncodeFrame();
+}
+
+void REPLAY_WRITER::AddFrame(const REPLAY_FRAME &Frame)
+{
+	mFrame = Frame;
+	EncodeFrame();
+}
+
+void REPLAY_WRITER::EncodeFrame()
+{
+	static const REPLAY_FRAME empty;
+	bool keyframe = mFramesSinceKeyframe<0 || mFramesSinceKeyframe>=REPLAY_FORMAT::KEYFRAME_INTERVAL - 1 ||
+		mFrame.match_id != mPrev.match_id;
+	mBody.clear();
+	if (!mFrame.RawLines.empty())
+	{
+		PutVarint(mBody, mFrame.RawLines.size());
+		for (size_t i = 0; i<mFrame.RawLines.size(); i++)
+		{
+			PutVarint(mBody, mFrame.RawLines[i].size());
+			mBody += mFrame.RawLines[i];
+		}
+		AddRecord(REPLAY_FORMAT::FRAME_TEXT, mBody);
+		// a keyframe that was due comes with the next frame
+		mFramesSinceKeyframe = keyframe ? -1 : mFramesSinceKeyframe + 1;
+	} else
+	{
+		IndexById(keyframe ? empty.Units : mPrev.Units, mById);
+		::EncodeFrame(keyframe ? empty : mPrev, mFrame, mById, mBody);
+		AddRecord(keyframe ? REPLAY_FORMAT::KEYFRAME : REPLAY_FORMAT::DELTA, mBody);
+		mFramesSinceKeyframe = keyframe ? 0 : mFramesSinceKeyframe + 1;
+	}
+	mPrev = mFrame;
+	mPrev.RawLines.clear();
+}
+
+bool REPLAY_WRITER::EncodeCommands(const std::string &Text)
+{
+	// "tick N\n", commands one per line, ".\n"; anything else stays text
+	mBody.clear();
+	int tick = 0, n = 0;
+	if (sscanf(Text.c_str(), "tick %d\n%n", &tick, &n)<1 || n == 0) return false;
+	std::string commands;
+	int count = 0;
+	size_t pos = n;
+	IndexById(mFrame.Units, mById);
+	while (pos<Text.size() && Text.compare(pos, 2, ".\n") != 0)
+	{
+		int a = 0, b = 0, c = 0, used = 0;
+		const char *line = Text.c_str() + pos;
+		if (sscanf(line, "attack %d %d\n%n", &a, &b, &used) == 2 && used>0)
+		{
+			PutVarint(commands, uint64_t(a)*2);
+			PutSigned(commands, b);
+		} else if (sscanf(line, "move %d %d %d\n%n", &a, &b, &c, &used) == 3 && used>0)
+		{
+			PutVarint(commands, uint64_t(a)*2 + 1);
+			const MAP_OBJECT *hero = FindById(mFrame.Units, mById, a);
+			Position base = hero != NULL ? hero->pos : Position(0, 0);
+			int code = StepCode(b - base.x, c - base.y);
+			PutVarint(commands, code);
+			if (code == 9)
+			{
+				PutSigned(commands, b - base.x);
+				PutSigned(commands, c - base.y);
+			}
+		} else
+		{
+			return false;
+		}
+		if (a<0) return false;
+		pos += used;
+		count++;
+	}
+	if (pos + 2 != Text.size()) return false;
+	PutSigned(mBody, tick - mFrame.tick);
+	PutVarint(mBody, count);
+	mBody += commands;
+	return true;
+}
+
+void REPLAY_WRITER::AddSent(const std::string &Text)
+{
+	if (EncodeCommands(Text))
+	{
+		// only if it comes back the same, e.g. "move 1 +2 3" would not
+		size_t pos = 0;
+		BODY_READER in(mBody, pos);
+		if (DecodeCommands(in, mFrame, mById, mDecoded) && mDecoded == Text)
+		{
+			AddRecord(REPLAY_FORMAT::SENT_COMMANDS, mBody);
+			return;
+		}
+	}
+	mBody.clear();
+	PutVarint(mBody, Text.size());
+	mBody += Text;
+	AddRecord(REPLAY_FORMAT::SENT_TEXT, mBody);
+}
+
+REPLAY_READER::REPLAY_READER()
+{
+	mOffset = 0;
+	mType = mMatchId = mTick = 0;
+	mPos = 0;
+	mCorrupt = false;
+	mIndexed = false;
+}
+
+bool REPLAY_READER::Open(const char *filename)
+{
+	mFile.open(filename, std::ifstream::in | std::ifstream::binary);
+	if (!mFile.is_open()) return false;
+	char magic[REPLAY_FORMAT::MAGIC_SIZE];
+	if (!mFile.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != REPLAY_FORMAT::MAGIC) return false;
+	mOffset = sizeof(magic);
+	mPrev.Clear();
+	mIndex.clear();
+	mIndexed = false;
+	return true;
+}
+
+bool REPLAY_READER::ReadRecord()
+{
+	uint64_t length = 0;
+	int shift = 0;
+	for (;;)
+	{
+		int c = mFile.get();
+		if (c == EOF)
+		{
+			mCorrupt = shift>0;
+			return false;
+		}
+		length |= uint64_t(c & 0x7f)<<shift;
+		shift += 7;
+		if (c<0x80) break;
+		if (shift>=64)
+		{
+			mCorrupt = true;
+			return false;
+		}
+	}
+	mBody.resize((size_t)length);
+	if (length == 0 || !mFile.read(&mBody[0], (std::streamsize)length))
+	{
+		mCorrupt = true;
+		return false;
+	}
+	mOffset += shift/7 + length;
+	mPos = 1;
+	BODY_READER in(mBody, mPos);
+	mType = (unsigned char)mBody[0];
+	mMatchId = (int)in.Varint();
+	mTick = (int)in.Varint();
+	if (in.failed) mCorrupt = true;
+	return !in.failed;
+}
+
+bool REPLAY_READER::DecodeFrame(REPLAY_FRAME &Frame)
+{
+	static const REPLAY_FRAME empty;
+	BODY_READER in(mBody, mPos);
+	if (mType == REPLAY_FORMAT::FRAME_TEXT)
+	{
+		// read as the client's parser read it: match and levels carry over
+		Frame.RawLines.resize(std::min<uint64_t>(in.Varint(), mBody.size()));
+		std::vector<LINE_VIEW> lines;
+		for (size_t i = 0; i<Frame.RawLines.size(); i++)
+		{
+			in.Bytes(Frame.RawLines[i], in.Varint());
+		}
+		if (in.failed) return false;
+		for (size_t i = 0; i<Frame.RawLines.size(); i++)
+		{
+			lines.push_back(Frame.RawLines[i]);
+		}
+		mParser.match_id = mPrev.match_id;
+		mParser.match_type = mPrev.match_type;
+		mParser.level[0] = mPrev.level[0];
+		mParser.level[1] = mPrev.level[1];
+		mParser.Parse(lines);
+		std::vector<std::string> raw;
+		raw.swap(Frame.RawLines);
+		Frame.Assign(mParser);
+		Frame.RawLines.swap(raw);
+	} else
+	{
+		bool keyframe = mType == REPLAY_FORMAT::KEYFRAME;
+		Frame.match_id = mMatchId;
+		Frame.tick = mTick;
+		IndexById(keyframe ? empty.Units : mPrev.Units, mById);
+		if (!DecodeFrameBody(in, keyframe ? empty : mPrev, mById, Frame)) return false;
+	}
+	mPrev = Frame;
+	mPrev.RawLines.clear();
+	return true;
+}
+
+bool REPLAY_READER::DecodeSent(std::string &Sent)
+{
+	BODY_READER in(mBody, mPos);
+	if (mType == REPLAY_FORMAT::SENT_TEXT)
+	{
+		return in.Bytes(Sent, in.Varint());
+	}
+	IndexById(mPrev.Units, mById);
+	return DecodeCommands(in, mPrev, mById, Sent);
+}
+
+REPLAY_READER::ITEM REPLAY_READER::Next(REPLAY_FRAME &Frame, std::string &Sent)
+{
+	while (ReadRecord())
+	{
+		switch (mType)
+		{
+			case REPLAY_FORMAT::KEYFRAME:
+			case REPLAY_FORMAT::DELTA:
+			case REPLAY_FORMAT::FRAME_TEXT:
+				if (DecodeFrame(Frame)) return ITEM_FRAME;
+				break;
+			case REPLAY_FORMAT::SENT_COMMANDS:
+			case REPLAY_FORMAT::SENT_TEXT:
+				if (DecodeSent(Sent)) return ITEM_SENT;
+				break;
+			default:
+				continue; // a newer record type, skipped
+		}
+		mCorrupt = true;
+		return ITEM_END;
+	}
+	return ITEM_END;
+}
+
+void REPLAY_READER::BuildIndex()
+{
+	mIndex.clear();
+	mFile.clear();
+	mFile.seekg((std::streamoff)REPLAY_FORMAT::MAGIC_SIZE);
+	mOffset = REPLAY_FORMAT::MAGIC_SIZE;
+	for (;;)
+	{
+		// only the header of each record is read, the bodies are skipped
+		uint64_t start = mOffset, length = 0;
+		int shift = 0, c = 0;
+		while ((c = mFile.get()) != EOF)
+		{
+			length |= uint64_t(c & 0x7f)<<shift;
+			shift += 7;
+			if (c<0x80 || shift>=64) break;
+		}
+		if (c == EOF || length == 0) break;
+		char header[21];
+		size_t head = (size_t)std::min<uint64_t>(length, sizeof(header));
+		if (!mFile.read(header, head)) break;
+		if (header[0] == REPLAY_FORMAT::KEYFRAME)
+		{
+			std::string h(header, head);
+			size_t pos = 1;
+			BODY_READER in(h, pos);
+			KEYFRAME_ENTRY entry;
+			entry.match_id = (int)in.Varint();
+			entry.tick = (int)in.Varint();
+			entry.offset = start;
+			if (!in.failed) mIndex.push_back(entry);
+		}
+		mOffset = start + shift/7 + length;
+		mFile.seekg((std::streamoff)mOffset);
+	}
+	mIndexed = true;
+}
+
+bool REPLAY_READER::Seek(int match_id, int tick)
+{
+	if (!mIndexed) BuildIndex();
+	// the last keyframe of the match at or before tick, else its first one
+	int best = -1;
+	for (size_t i = 0; i<mIndex.size(); i++)
+	{
+		const KEYFRAME_ENTRY &e = mIndex[i];
+		if (e.match_id != match_id) continue;
+		if (best == -1)
+		{
+			best = (int)i;
+			continue;
+		}
+		const KEYFRAME_ENTRY &b = mIndex[best];
+		bool before = e.tick<=tick, best_before = b.tick<=tick;
+		if (before ? !best_before || e.tick>=b.tick : !best_before && e.tick<b.tick) best = (int)i;
+	}
+	if (best == -1) return false;
+	mFile.clear();
+	mFile.seekg((std::streamoff)mIndex[best].offset);
+	mOffset = mIndex[best].offset;
+	mCorrupt = false;
+	// decode up to the frame before tick, so Next returns the one at it
+	for (;;)
+	{
+		uint64_t start = mOffset;
+		if (!ReadRecord()) return false;
+		bool frame = mType == REPLAY_FORMAT::KEYFRAME || mType == REPLAY_FORMAT::DELTA || mType == REPLAY_FORMAT::FRAME_TEXT;
+		if (frame && (mMatchId != match_id || mTick>=tick))
+		{
+			mFile.clear();
+			mFile.seekg((std::streamoff)start);
+			mOffset = start;
+			return mMatchId == match_id;
+		}
+		REPLAY_FRAME skipped;
+		if (frame && !DecodeFrame(skipped)) return false;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "parser.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A tick frame as the PARSER reads it, the unit of the binary replay.
+struct REPLAY_FRAME
+{
+	int match_id;
+	int tick;
+	PARSER::MATCH_TYPE match_type;
+	PARSER::MATCH_RESULT match_result;
+	int level[2];
+	std::vector<CONTROLLER_INFO> Controllers;
+	std::vector<MAP_OBJECT> Units;
+	std::vector<ATTACK_INFO> Attacks;
+	std::vector<RESPAWN_INFO> Respawns;
+	// the frame as received, if the text the server sent is not what
+	// WriteText would write for it; empty otherwise
+	std::vector<std::string> RawLines;
+
+	REPLAY_FRAME();
+	void Clear();
+	void Assign(const PARSER &Parser);
+	// the frame in the server's text format, ending with "."
+	void WriteText(std::vector<std::string> &Lines) const;
+};
+
+// replay.bin: the bytes "MOBAREPLAY1\n", then records of
+//   varint length of the body
+//   body: type byte, varint match id, varint tick, payload
+// Frames are varint encoded against the previous frame of the same match
+// (units by id: hp and position changes; attack ids and positions relative
+// to the units), a keyframe against nothing every KEYFRAME_INTERVAL frames
+// and when a match starts. What the client sent follows its frame, tick
+// answers as commands. A file may hold several sessions appended.
+struct REPLAY_FORMAT
+{
+	static const char MAGIC[];
+	static const size_t MAGIC_SIZE = 12;
+	static const int KEYFRAME_INTERVAL = 100;
+
+	enum RECORD_TYPE
+	{
+		KEYFRAME,
+		DELTA,
+		FRAME_TEXT, // a frame whose text would not come back the same
+		SENT_COMMANDS, // a "tick ..." answer as written by HandleServerResponse
+		SENT_TEXT // anything else the client sent
+	};
+};
+
+// Encodes frames and sent messages into Buffer(), to be appended to a
+// replay.bin that starts with REPLAY_FORMAT::MAGIC. Buffers are reused, so a
+// warmed up writer does not allocate.
+class REPLAY_WRITER
+{
+public:
+	REPLAY_WRITER();
+	void Reset(); // the next frame is a keyframe
+
+	// a frame as received; frames the parser does not read back exactly are
+	// kept as text
+	void AddFrame(const std::vector<LINE_VIEW> &Lines);
+	void AddFrame(const REPLAY_FRAME &Frame);
+	// a message as the client sent it, with its final '\n'
+	void AddSent(const std::string &Text);
+
+	const std::string &Buffer() const { return mOut; }
+	void ClearBuffer() { mOut.clear(); }
+
+private:
+	void EncodeFrame(); // mFrame
+	void AddRecord(REPLAY_FORMAT::RECORD_TYPE type, const std::string &body);
+	bool EncodeCommands(const std::string &Text); // into mBody, false if not a tick answer
+
+	PARSER mParser;
+	REPLAY_FRAME mFrame, mPrev;
+	int mFramesSinceKeyframe;
+	std::string mOut, mBody, mHeader, mDecoded;
+	std::vector<std::string> mText;
+	std::vector<std::pair<int, int> > mById; // (id, index) of mPrev's or mFrame's units
+};
+
+// Streams a replay.bin back. Seek jumps to a tick through the keyframes:
+// the first call scans the record headers once, every later one decodes at
+// most KEYFRAME_INTERVAL frames.
+class REPLAY_READER
+{
+public:
+	enum ITEM
+	{
+		ITEM_END,
+		ITEM_FRAME,
+		ITEM_SENT
+	};
+
+	REPLAY_READER();
+	bool Open(const char *filename); // false if missing or not a replay
+	ITEM Next(REPLAY_FRAME &Frame, std::string &Sent);
+	// positions on the first frame of match_id at or after tick; false if
+	// the match has no such frame
+	bool Seek(int match_id, int tick);
+	bool Corrupt() const { return mCorrupt; } // Next stopped on a broken record
+
+private:
+	struct KEYFRAME_ENTRY
+	{
+		int match_id, tick;
+		uint64_t offset;
+	};
+	bool ReadRecord(); // into mBody, the type and header into the members below
+	bool DecodeFrame(REPLAY_FRAME &Frame);
+	bool DecodeSent(std::string &Sent);
+	void BuildIndex();
+
+	std::ifstream mFile;
+	uint64_t mOffset; // of the next record
+	std::string mBody;
+	int mType, mMatchId, mTick;
+	size_t mPos; // into mBody
+	bool mCorrupt;
+	REPLAY_FRAME mPrev;
+	PARSER mParser;
+	std::vector<std::pair<int, int> > mById;
+	std::vector<KEYFRAME_ENTRY> mIndex;
+	bool mIndexed;
+};
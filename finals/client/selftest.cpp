@@ -0,0 +1,1139 @@
+// Checks that the optimized paths still give what the code they replaced
+// gave. Run by ctest (see finals/CMakeLists.txt); each exits with 0 if the
+// check holds. Frames come from matches played on the SIMULATOR, so no
+// recorded debug.log is needed.
+//   moba-selftest parse <map.txt>       FRAMER and PARSER against the old sscanf parser
+//   moba-selftest grid <map.txt>        GetUnitsNear against a scan of every unit
+//   moba-selftest commands [answers]    COMMAND_WRITER against the old stringstream answers
+//   moba-selftest matrix                fused Matrix expressions against element loops
+//   moba-selftest rangemasks <map.txt>  RangeMasks against the old IsNeighbourOfCircle
+//   moba-selftest sim <map.txt>         SIMULATOR determinism, rules, views and Load
+//   moba-selftest replay <map.txt> <replay.bin>
+//                                       replay.bin back to text and seeks against the log
+//   moba-selftest distcache <map.txt>   every build kernel and thread count against one scalar search
+//   moba-selftest storage <map.txt>     every DISTCACHE storage against the byte table
+//   moba-selftest nexthop <map.txt>     next hop table against GetNextTowards by search
+//   moba-selftest flow <map.txt>        FLOW_FIELD against GetDist and GetNextTowards
+//   moba-selftest history <map.txt>     UnitHistory against std::map bookkeeping
+//   moba-selftest evil <map.txt>        GetMostEvilEnemyHeroes against the old tracker
+//   moba-selftest allocations <map.txt> [lookahead depth]
+//                                       no heap allocations in steady state ticks
+#include "stdafx.h"
+#include "Hypno.h"
+#include "parser.h"
+#include "framing.h"
+#include "distcache.h"
+#include "alloctrack.h"
+#include "sim.h"
+#include "UnitHistory.h"
+#include "flowfield.h"
+#include "Matrix.h"
+#include "Bitboard.h"
+#include "replayfile.h"
+#include "debuglog.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+
+static bool LoadMap(const char *map_file, PARSER &Parser)
+{
+	std::vector<std::string> lines;
+	if (!LoadLines(map_file, lines) || lines.empty())
+	{
+		std::cout << "cannot read " << map_file << std::endl;
+		return false;
+	}
+	Parser.ParseMap(lines);
+	return true;
+}
+
+// Player (side 0, still owned by the caller) against Hypno on the arena of
+// map_file, side 0's frames into Frames, side 1's into OtherFrames and side
+// 0's answers as sent, with their '\n', into Answers if given.
+// allocating_ticks: side 0's steady state ticks that allocated, counted up
+// to the last frame, after which the client resets the count.
+static bool PlayMatch(const char *map_file, uint32_t seed, CLIENT *Player,
+	std::vector<std::vector<std::string> > &Frames, int &allocating_ticks,
+	std::vector<std::vector<std::string> > *OtherFrames = NULL, std::vector<std::string> *Answers = NULL)
+{
+	std::unique_ptr<CLIENT> opponent(CreateClient());
+	CLIENT *clients[2] = { Player, opponent.get() };
+	for (int side = 0; side<2; side++)
+	{
+		clients[side]->SetTickBudget(0);
+		if (!LoadMap(map_file, clients[side]->mParser)) return false;
+		clients[side]->UpdateDistCache(false);
+	}
+	SIMULATOR sim;
+	if (!sim.Init(clients[0]->mParser))
+	{
+		std::cout << "the arena of " << map_file << " cannot be simulated" << std::endl;
+		return false;
+	}
+	std::unique_ptr<SIM_STATE> state(new SIM_STATE);
+	sim.Reset(*state, seed);
+	std::vector<std::string> frame;
+	std::vector<COMMAND> commands[2];
+	for (;;)
+	{
+		for (int side = 0; side<2; side++)
+		{
+			sim.WriteFrame(*state, side, 1, frame);
+			std::string answer = clients[side]->DebugResponse(frame);
+			SIMULATOR::ParseCommands(answer, commands[side]);
+			if (side == 0)
+			{
+				Frames.push_back(frame);
+				if (Answers) Answers->push_back(answer + '\n');
+				if (state->result == PARSER::ONGOING) allocating_ticks = clients[0]->GetTickAllocations().allocating_ticks;
+			}
+			else if (OtherFrames) OtherFrames->push_back(frame);
+		}
+		if (state->result != PARSER::ONGOING) return true;
+		sim.Step(*state, commands);
+	}
+}
+
+// A tick as PARSER read it before it parsed LINE_VIEWs in place: substr,
+// atoi and sscanf on std::string lines. Respawns are per tick, as they are
+// since UNIT_TABLE.
+struct OLD_TICK
+{
+	int tick, match_id, level[2];
+	PARSER::MATCH_TYPE match_type;
+	PARSER::MATCH_RESULT match_result;
+	std::vector<MAP_OBJECT> Units;
+	std::vector<CONTROLLER_INFO> Controllers;
+	std::vector<ATTACK_INFO> Attacks;
+	std::vector<RESPAWN_INFO> Respawns;
+};
+
+static void OldParse(const std::vector<std::string> &ServerResponse, OLD_TICK &Tick)
+{
+	Tick.tick = 0;
+	Tick.match_result = PARSER::ONGOING;
+	Tick.Units.clear();
+	Tick.Attacks.clear();
+	Tick.Controllers.clear();
+	Tick.Respawns.clear();
+	for (int i = 0; i<(int)ServerResponse.size(); i++)
+	{
+		if (ServerResponse[i].empty()) continue;
+		char c = ServerResponse[i][0];
+		if (c=='t' && ServerResponse[i].substr(0, 4)=="tick")
+		{
+			Tick.tick = atoi(ServerResponse[i].substr(5).c_str());
+		} else if (c=='m' && ServerResponse[i].substr(0, 5)=="match")
+		{
+			std::string param = ServerResponse[i].substr(6);
+			char type_name[20];
+			if (sscanf(param.c_str(), "%d %19s", &Tick.match_id, type_name) == 2)
+			{
+				Tick.match_type = !strcmp(type_name, "melee") ? PARSER::MELEE : PARSER::DUEL;
+			}
+		} else if (c == 'c' && ServerResponse[i].substr(0, 11)=="controllers")
+		{
+			int count = atoi(ServerResponse[i].substr(12).c_str());
+			for (int r = 0; r<count; r++)
+			{
+				CONTROLLER_INFO info;
+				sscanf(ServerResponse[i + r + 1].c_str(), "%d %d", &info.hero_id, &info.controller_id);
+				Tick.Controllers.push_back(info);
+			}
+		} else if (c == 'l' && ServerResponse[i].substr(0, 5) == "level")
+		{
+			std::string param = ServerResponse[i].substr(6);
+			if (sscanf(param.c_str(), "%d %d", &Tick.level[0], &Tick.level[1]) != 2)
+			{
+				Tick.level[0] = Tick.level[1] = 0;
+			}
+		} else if (c == 'a' && ServerResponse[i].substr(0, 7) == "attacks")
+		{
+			int count = atoi(ServerResponse[i].substr(8).c_str());
+			for (int r = 0; r<count; r++)
+			{
+				ATTACK_INFO info;
+				sscanf(ServerResponse[i + r + 1].c_str(), "%d %d %d %d %d %d", &info.attacker_id, &info.attacker_pos.x, &info.attacker_pos.y, &info.target_id, &info.target_pos.x, &info.target_pos.y);
+				Tick.Attacks.push_back(info);
+			}
+		} else if (c == 'r' && ServerResponse[i].substr(0, 8) == "respawns")
+		{
+			int count = atoi(ServerResponse[i].substr(9).c_str());
+			for (int r = 0; r<count; r++)
+			{
+				RESPAWN_INFO info;
+				sscanf(ServerResponse[i + r + 1].c_str(), "%d %d %d", &info.hero_id, &info.side, &info.tick);
+				Tick.Respawns.push_back(info);
+			}
+		} else if (c == 'u' && ServerResponse[i].substr(0, 5)=="units")
+		{
+			int count = atoi(ServerResponse[i].substr(6).c_str());
+			for (int r = 0; r<count; r++)
+			{
+				MAP_OBJECT ob;
+				char type_name[20];
+				sscanf(ServerResponse[i+r+1].c_str(), "%19s %d %d %d %d %d", type_name, &ob.id, &ob.side, &ob.hp, &ob.pos.x, &ob.pos.y);
+				if (!strcmp(type_name, "hero")) ob.t = HERO;
+				else if (!strcmp(type_name, "minion")) ob.t = MINION;
+				else if (!strcmp(type_name, "turret")) ob.t = TURRET;
+				else if (!strcmp(type_name, "base")) ob.t = BASE;
+				Tick.Units.push_back(ob);
+			}
+		} else if (c == 'f' && ServerResponse[i].substr(0, 8)=="finished")
+		{
+			std::string res = ServerResponse[i].substr(9);
+			if (res=="victory") Tick.match_result = PARSER::VICTORY;
+			else if (res=="draw") Tick.match_result = PARSER::DRAW;
+			else if (res=="defeat") Tick.match_result = PARSER::DEFEAT;
+		}
+	}
+}
+
+static bool SameTick(const PARSER &Parser, const OLD_TICK &Tick)
+{
+	if (Parser.tick != Tick.tick || Parser.match_id != Tick.match_id || Parser.match_type != Tick.match_type ||
+		Parser.level[0] != Tick.level[0] || Parser.level[1] != Tick.level[1] || Parser.match_result != Tick.match_result ||
+		Parser.Units.size() != Tick.Units.size() || Parser.Controllers.size() != Tick.Controllers.size() ||
+		Parser.Attacks.size() != Tick.Attacks.size() || Parser.Respawns.size() != Tick.Respawns.size()) return false;
+	for (size_t i = 0; i<Tick.Units.size(); i++)
+	{
+		const MAP_OBJECT &a = Parser.Units[i], &b = Tick.Units[i];
+		if (a.id != b.id || a.side != b.side || a.hp != b.hp || !(a.pos == b.pos) || a.t != b.t) return false;
+	}
+	for (size_t i = 0; i<Tick.Controllers.size(); i++)
+	{
+		const CONTROLLER_INFO &a = Parser.Controllers[i], &b = Tick.Controllers[i];
+		if (a.hero_id != b.hero_id || a.controller_id != b.controller_id) return false;
+	}
+	for (size_t i = 0; i<Tick.Attacks.size(); i++)
+	{
+		const ATTACK_INFO &a = Parser.Attacks[i], &b = Tick.Attacks[i];
+		if (a.attacker_id != b.attacker_id || !(a.attacker_pos == b.attacker_pos) ||
+			a.target_id != b.target_id || !(a.target_pos == b.target_pos)) return false;
+	}
+	for (size_t i = 0; i<Tick.Respawns.size(); i++)
+	{
+		const RESPAWN_INFO &a = Parser.Respawns[i], &b = Tick.Respawns[i];
+		if (a.hero_id != b.hero_id || a.side != b.side || a.tick != b.tick) return false;
+	}
+	return true;
+}
+
+// A whole match as one stream, received in chunks of random size, framed
+// and parsed the way CLIENT does it, against the old parser on the lines.
+static int TestParse(const char *map_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	int allocating_ticks = 0;
+	Hypno player;
+	if (!PlayMatch(map_file, 1, &player, frames, allocating_ticks)) return 1;
+	std::string stream;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		for (const std::string &line : frames[f]) stream += line + "\n";
+	}
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<size_t> chunk(1, 700);
+	FRAMER framer;
+	PARSER parser;
+	OLD_TICK old;
+	size_t parsed = 0, mismatches = 0;
+	for (size_t pos = 0; pos<stream.size();)
+	{
+		size_t room;
+		char *buffer = framer.GetWriteBuffer(4096, room);
+		size_t length = std::min(std::min(chunk(rng), room), stream.size() - pos);
+		memcpy(buffer, stream.data() + pos, length);
+		framer.CommitWrite(length);
+		pos += length;
+		LINE_VIEW line;
+		while (framer.NextLine(line))
+		{
+			framer.PushFrameLine(line);
+			if (line != ".") continue;
+			const std::vector<LINE_VIEW> &frame = framer.GetFrame();
+			bool same_lines = parsed<frames.size() && frame.size() == frames[parsed].size();
+			for (size_t i = 0; same_lines && i<frame.size(); i++) same_lines = frame[i] == frames[parsed][i];
+			parser.Parse(frame);
+			if (parsed<frames.size()) OldParse(frames[parsed], old);
+			if (!same_lines || !SameTick(parser, old))
+			{
+				if (mismatches++ == 0) std::cout << "DIFFER first at frame " << parsed << std::endl;
+			}
+			parsed++;
+			framer.ClearFrame();
+		}
+	}
+	if (parsed != frames.size()) mismatches++;
+	std::cout << parsed << " of " << frames.size() << " frames, " << stream.size() << " bytes, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Radius queries around every unit of every tick, and around cells off the
+// arena, against the scan over Units they replaced: the same units in the
+// same order.
+static int TestGrid(const char *map_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	int allocating_ticks = 0;
+	Hypno player;
+	if (!PlayMatch(map_file, 1, &player, frames, allocating_ticks)) return 1;
+	PARSER parser;
+	if (!LoadMap(map_file, parser)) return 1;
+	const int radii_sq[] = { 0, 2, MINION_RANGE_SQ, HERO_RANGE_SQ, 50, 400 };
+	TICK_VECTOR<int> near_units;
+	std::vector<int> scanned;
+	size_t queries = 0, found = 0, mismatches = 0;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		std::vector<LINE_VIEW> lines(frames[f].begin(), frames[f].end());
+		parser.Parse(lines);
+		std::vector<Position> centers;
+		for (const MAP_OBJECT &unit : parser.Units) centers.push_back(unit.pos);
+		centers.push_back(Position(-3, -3));
+		centers.push_back(Position(parser.w + 2, parser.h / 2));
+		for (const Position &center : centers)
+		{
+			for (int radius_sq : radii_sq)
+			{
+				scanned.clear();
+				for (const MAP_OBJECT &unit : parser.Units)
+				{
+					if (center.DistSquare(unit.pos) <= radius_sq) scanned.push_back(unit.id);
+				}
+				SPATIAL_GRID::UNIT_RANGE near = parser.GetUnitsNear(center, radius_sq, near_units);
+				size_t i = 0;
+				bool same = true;
+				for (const MAP_OBJECT &unit : near)
+				{
+					same = same && i<scanned.size() && unit.id == scanned[i];
+					i++;
+				}
+				if (!same || i != scanned.size()) mismatches++;
+				found += scanned.size();
+				queries++;
+			}
+		}
+	}
+	std::cout << frames.size() << " ticks, " << queries << " queries, " << found << " units found, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// the answer as CLIENT formatted it before COMMAND_WRITER, with the '\n'
+// SendMessage appended
+static std::string StreamAnswer(int tick, const std::vector<COMMAND> &Commands)
+{
+	std::stringstream ss;
+	ss << "tick "<<tick<<"\n";
+	for (size_t i = 0; i<Commands.size(); i++)
+	{
+		const COMMAND &command = Commands[i];
+		if (command.type==COMMAND::ATTACK)
+		{
+			ss << "attack " << command.hero_id << " " << command.target_id << "\n";
+		} else
+		{
+			ss << "move " << command.hero_id << " " << command.target_pos.x << " " << command.target_pos.y << "\n";
+		}
+	}
+	ss<<".";
+	return ss.str() + "\n";
+}
+
+// random answers, every 16th with values from the whole int range
+static int TestCommands(int answers)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> any(INT_MIN, INT_MAX), small(-5, 200), count(0, 12);
+	COMMAND_WRITER writer;
+	std::vector<COMMAND> commands;
+	int mismatches = 0;
+	for (int a = 0; a<answers; a++)
+	{
+		bool extreme = a%16 == 0;
+		int tick = a == 0 ? INT_MIN : a == 1 ? INT_MAX : extreme ? any(rng) : a;
+		commands.clear();
+		for (int n = count(rng); n>0; n--)
+		{
+			COMMAND command;
+			command.type = rng()%2 ? COMMAND::ATTACK : COMMAND::MOVE;
+			command.hero_id = extreme ? any(rng) : small(rng);
+			command.target_id = extreme ? any(rng) : small(rng);
+			command.target_pos = Position(extreme ? any(rng) : small(rng), extreme ? any(rng) : small(rng));
+			commands.push_back(command);
+		}
+		writer.Clear();
+		writer.Tick(tick);
+		for (size_t i = 0; i<commands.size(); i++)
+		{
+			if (commands[i].type == COMMAND::ATTACK) writer.Attack(commands[i].hero_id, commands[i].target_id);
+			else writer.Move(commands[i].hero_id, commands[i].target_pos.x, commands[i].target_pos.y);
+		}
+		writer.End();
+		if (std::string(writer.Data(), writer.Size()) != StreamAnswer(tick, commands))
+		{
+			if (mismatches++ == 0) std::cout << "DIFFER at answer " << a << ": " << std::string(writer.Data(), writer.Size());
+		}
+	}
+	std::cout << answers << " answers, wire bytes " << (mismatches == 0 ? "identical" : "DIFFER") << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// GetDist of a table with unreachable pairs as -2, the same for every storage
+static int Dist(const DISTCACHE &Cache, const Position &p0, const Position &p1)
+{
+	int d = Cache.GetDist(p0, p1);
+	return d == Cache.Unreachable() ? -2 : d;
+}
+
+// Tables of the bit-parallel kernel and of several threads against a scalar
+// search on one thread, the way the table used to be built: every pair of
+// cells, walls included.
+static int TestDistCache(const char *map_file)
+{
+	PARSER parser;
+	if (!LoadMap(map_file, parser)) return 1;
+	DISTCACHE reference;
+	reference.CreateFromParser(parser, DISTCACHE::SCALAR_BFS, 1);
+	const int thread_counts[] = { 1, 4 }; // several threads, whatever the box has
+	size_t pairs = 0, mismatches = 0;
+	for (int kernel = DISTCACHE::SCALAR_BFS; kernel<=DISTCACHE::BIT_PARALLEL_BFS; kernel++)
+	{
+		for (int threads : thread_counts)
+		{
+			if (kernel == DISTCACHE::SCALAR_BFS && threads == 1) continue; // the reference
+			DISTCACHE cache;
+			cache.CreateFromParser(parser, (DISTCACHE::BUILD_KERNEL)kernel, threads);
+			for (int y0 = 0; y0<parser.h; y0++)
+				for (int x0 = 0; x0<parser.w; x0++)
+					for (int y1 = 0; y1<parser.h; y1++)
+						for (int x1 = 0; x1<parser.w; x1++)
+						{
+							Position p0(x0, y0), p1(x1, y1);
+							if (Dist(cache, p0, p1) != Dist(reference, p0, p1)) mismatches++;
+							pairs++;
+						}
+		}
+	}
+	std::cout << pairs << " pairs in 3 tables, " << (mismatches == 0 ? "identical" : "DIFFER")
+		<< " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// The 16 bit tables against the byte table the arena used to get. Exact
+// storages on every pair of walkable cells; landmarks search each query, so
+// on a sample of them. Lower bounds of every storage must not exceed it.
+static int TestStorage(const char *map_file)
+{
+	PARSER parser;
+	if (!LoadMap(map_file, parser)) return 1;
+	DISTCACHE reference;
+	reference.CreateFromParser(parser, DISTCACHE::SCALAR_BFS, 1, DISTCACHE::DENSE8);
+	std::vector<Position> cells;
+	for (int y = 0; y<parser.h; y++)
+		for (int x = 0; x<parser.w; x++)
+			if (reference.mMap[x + y*parser.w]) cells.push_back(Position(x, y));
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<size_t> any_cell(0, cells.size() - 1);
+	std::vector<std::pair<Position, Position> > sample(2000);
+	for (auto &pair : sample) pair = std::make_pair(cells[any_cell(rng)], cells[any_cell(rng)]);
+	const char *names[] = { "dense8", "triangle16", "landmarks16" };
+	size_t mismatches = 0;
+	for (int storage = DISTCACHE::DENSE8; storage<DISTCACHE::AUTO; storage++)
+	{
+		DISTCACHE cache;
+		cache.CreateFromParser(parser, DISTCACHE::BIT_PARALLEL_BFS, 0, (DISTCACHE::STORAGE)storage);
+		size_t pairs = 0, storage_mismatches = 0;
+		if (storage != DISTCACHE::LANDMARKS16)
+		{
+			for (const Position &p0 : cells)
+				for (const Position &p1 : cells)
+				{
+					if (Dist(cache, p0, p1) != Dist(reference, p0, p1)) storage_mismatches++;
+					pairs++;
+				}
+		}
+		for (const auto &pair : sample)
+		{
+			int d = Dist(reference, pair.first, pair.second);
+			if (Dist(cache, pair.first, pair.second) != d) storage_mismatches++;
+			if (d >= 0 && cache.GetDistLowerBound(pair.first, pair.second)>d) storage_mismatches++;
+			pairs++;
+		}
+		std::cout << names[storage] << ": " << pairs << " pairs, " << storage_mismatches << " mismatches" << std::endl;
+		mismatches += storage_mismatches;
+	}
+	std::cout << (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// The first step of every walk between two walkable cells, from the next hop
+// table and from the search over the neighbours it replaced, for each exact
+// storage. A step must also bring the walk one cell closer.
+static int TestNextHops(const char *map_file)
+{
+	PARSER parser;
+	if (!LoadMap(map_file, parser)) return 1;
+	size_t mismatches = 0;
+	for (int storage = DISTCACHE::DENSE8; storage<=DISTCACHE::TRIANGLE16; storage++)
+	{
+		DISTCACHE table, search;
+		table.CreateFromParser(parser, DISTCACHE::BIT_PARALLEL_BFS, 0, (DISTCACHE::STORAGE)storage, true);
+		search.CreateFromParser(parser, DISTCACHE::BIT_PARALLEL_BFS, 0, (DISTCACHE::STORAGE)storage, false);
+		if (!table.HasNextHops() || search.HasNextHops())
+		{
+			std::cout << "storage " << storage << ": next hops not built as asked" << std::endl;
+			return 1;
+		}
+		std::vector<Position> cells;
+		for (int y = 0; y<parser.h; y++)
+			for (int x = 0; x<parser.w; x++)
+				if (table.mMap[x + y*parser.w]) cells.push_back(Position(x, y));
+		size_t walks = 0;
+		for (const Position &p0 : cells)
+			for (const Position &p1 : cells)
+			{
+				int d = Dist(table, p0, p1);
+				if (d<=0) continue;
+				Position next = table.GetNextTowards(p0, p1);
+				if (!(next == search.GetNextTowards(p0, p1)) || Dist(table, next, p1) != d - 1) mismatches++;
+				walks++;
+			}
+		std::cout << (storage == DISTCACHE::DENSE8 ? "dense8" : "triangle16") << ": " << walks << " walks" << std::endl;
+	}
+	std::cout << (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+template<typename T>
+static Matrix<T> RandomMatrix(std::mt19937 &rng, int width, int height)
+{
+	std::uniform_int_distribution<int> value(-1000, 1000);
+	Matrix<T> m(width, height);
+	for (int y = 0; y<height; y++)
+		for (int x = 0; x<width; x++)
+			m(x, y) = T(value(rng)) / (std::is_floating_point<T>::value ? T(7) : T(1));
+	return m;
+}
+
+// Mismatches of the fused expressions, assigned, constructed, added and
+// subtracted in place and aliasing their destination, against the same sums
+// written as loops over the elements.
+template<typename T>
+static size_t CheckMatrix(std::mt19937 &rng, int width, int height)
+{
+	Matrix<T> a = RandomMatrix<T>(rng, width, height), b = RandomMatrix<T>(rng, width, height);
+	Matrix<T> c = RandomMatrix<T>(rng, width, height), d = RandomMatrix<T>(rng, width, height);
+	Matrix<T> sum(a + b + c - d), assigned(1, 1), added(a), subtracted(b), aliased(a);
+	assigned = a + b + c - d;
+	added += b - c + d;
+	subtracted -= a + c;
+	aliased = aliased + aliased - b;
+	Matrix<T> copy(sum);
+	Matrix<T> moved(std::move(copy));
+	size_t mismatches = 0;
+	for (int y = 0; y<height; y++)
+		for (int x = 0; x<width; x++)
+		{
+			T expected = a(x, y) + b(x, y) + c(x, y) - d(x, y);
+			if (sum(x, y) != expected || assigned(x, y) != expected || moved(x, y) != expected) mismatches++;
+			if (added(x, y) != a(x, y) + (b(x, y) - c(x, y) + d(x, y))) mismatches++;
+			if (subtracted(x, y) != b(x, y) - (a(x, y) + c(x, y))) mismatches++;
+			if (aliased(x, y) != a(x, y) + a(x, y) - b(x, y)) mismatches++;
+		}
+	if ((int)sum.width() != width || (int)sum.height() != height || (int)assigned.width() != width ||
+		(int)assigned.height() != height || !(sum == assigned)) mismatches++;
+	return mismatches;
+}
+
+static int TestMatrix()
+{
+	std::mt19937 rng(1);
+	const int sizes[][2] = { { 0, 0 }, { 1, 1 }, { 3, 1 }, { 17, 5 }, { 39, 39 }, { 64, 63 } };
+	size_t mismatches = 0;
+	for (const auto &size : sizes)
+	{
+		mismatches += CheckMatrix<double>(rng, size[0], size[1]);
+		mismatches += CheckMatrix<std::int32_t>(rng, size[0], size[1]);
+	}
+	std::cout << "double and int32 matrices of " << sizeof(sizes) / sizeof(sizes[0]) << " sizes, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Hypno::IsNeighbourOfCircle as it was before RangeMasks: pos is within
+// radius_sq of center, or one of its eight neighbours is.
+static bool OldIsNeighbourOfCircle(const Position &pos, const Position &center, int radius_sq)
+{
+	if (pos.DistSquare(center) <= radius_sq) return true;
+	for (int y = pos.y - 1; y <= pos.y + 1; ++y)
+	{
+		for (int x = pos.x - 1; x <= pos.x + 1; ++x)
+		{
+			if (Position(x, y).DistSquare(center) <= radius_sq) return true;
+		}
+	}
+	return false;
+}
+
+// Every mask the bot builds, and a few wider ones, against the old test: each
+// cell of the arena around every center, then the boards of both sides' units
+// of every tick against the cells the old test accepts.
+static int TestRangeMasks(const char *map_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	int allocating_ticks = 0;
+	Hypno player;
+	if (!PlayMatch(map_file, 1, &player, frames, allocating_ticks)) return 1;
+	PARSER parser;
+	if (!LoadMap(map_file, parser)) return 1;
+	const int ranges_sq[] = { 0, 1, 2, MINION_RANGE_SQ, HERO_RANGE_SQ, 25 };
+	std::vector<RangeMasks> masks;
+	for (int range_sq : ranges_sq) masks.push_back(RangeMasks(range_sq, parser.w, parser.h));
+	size_t cells = 0, queries = 0, mismatches = 0;
+	for (const RangeMasks &mask : masks)
+	{
+		int range_sq = mask.GetRangeSq();
+		for (int cy = 0; cy<parser.h; cy++) for (int cx = 0; cx<parser.w; cx++)
+		{
+			Position center(cx, cy);
+			for (int y = 0; y<parser.h; y++)
+			{
+				Bitboard::Row row = 0;
+				for (int x = 0; x<parser.w; x++)
+				{
+					Position pos(x, y);
+					bool old = OldIsNeighbourOfCircle(pos, center, range_sq);
+					if (old) row |= Bitboard::Row(1) << x;
+					if (mask.Contains(center, pos) != old || RangeMasks::InGrownCircle(x - cx, y - cy, range_sq) != old) mismatches++;
+					cells++;
+				}
+				if (mask.GetRow(center, y) != row) mismatches++;
+			}
+		}
+	}
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		std::vector<LINE_VIEW> lines(frames[f].begin(), frames[f].end());
+		parser.Parse(lines);
+		Bitboard boards[2];
+		std::vector<Position> cells_of[2];
+		for (const MAP_OBJECT &unit : parser.Units)
+		{
+			if (!boards[unit.side].Test(unit.pos)) cells_of[unit.side].push_back(unit.pos);
+			boards[unit.side].Set(unit.pos);
+		}
+		for (const RangeMasks &mask : masks)
+		{
+			int range_sq = mask.GetRangeSq();
+			for (int side = 0; side<2; side++)
+			{
+				Bitboard covered, old_covered;
+				for (const Position &center : cells_of[side])
+				{
+					mask.OrInto(covered, center);
+					for (int y = std::max(center.y - mask.Reach(), 0); y<=std::min(center.y + mask.Reach(), parser.h - 1); y++)
+					{
+						for (int x = std::max(center.x - mask.Reach(), 0); x<=std::min(center.x + mask.Reach(), parser.w - 1); x++)
+						{
+							if (OldIsNeighbourOfCircle(Position(x, y), center, range_sq)) old_covered.Set(Position(x, y));
+						}
+					}
+					int count = 0;
+					for (const Position &enemy : cells_of[1 - side])
+					{
+						if (OldIsNeighbourOfCircle(enemy, center, range_sq)) count++;
+					}
+					if (mask.Count(center, boards[1 - side]) != count || mask.Intersects(center, boards[1 - side]) != (count>0)) mismatches++;
+					queries++;
+				}
+				for (int y = 0; y<Bitboard::MaxSide; y++) if (covered.GetRow(y) != old_covered.GetRow(y)) mismatches++;
+			}
+		}
+	}
+	std::cout << cells << " cells, " << frames.size() << " ticks, " << queries << " queries, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// a frame without its attacks section, which SIMULATOR::Load does not keep
+static std::vector<std::string> WithoutAttacks(const std::vector<std::string> &Frame)
+{
+	std::vector<std::string> lines;
+	for (size_t i = 0; i<Frame.size(); i++)
+	{
+		if (Frame[i].compare(0, 8, "attacks ") == 0) i += atoi(Frame[i].c_str() + 8);
+		else lines.push_back(Frame[i]);
+	}
+	return lines;
+}
+
+static bool SameUnit(const MAP_OBJECT &a, const MAP_OBJECT &b)
+{
+	return a.id == b.id && a.side == b.side && a.hp == b.hp && a.t == b.t && a.pos.x == b.pos.x && a.pos.y == b.pos.y;
+}
+
+// A match played twice with the same seed gives the same frames. Every frame
+// keeps the rules: one tick after the other, living units on walkable cells,
+// no two minions on a cell, side 1's view the mirror of side 0's, and a
+// result by MATCH_TICKS. A state loaded from either view writes both views
+// again, but for the attacks.
+static int TestSimulator(const char *map_file)
+{
+	std::vector<std::vector<std::string> > frames[2], replayed[2];
+	int allocating_ticks = 0;
+	{
+		Hypno player;
+		if (!PlayMatch(map_file, 7, &player, frames[0], allocating_ticks, &frames[1])) return 1;
+	}
+	{
+		Hypno player;
+		if (!PlayMatch(map_file, 7, &player, replayed[0], allocating_ticks, &replayed[1])) return 1;
+	}
+	PARSER parsers[2];
+	for (int side = 0; side<2; side++) if (!LoadMap(map_file, parsers[side])) return 1;
+	SIMULATOR sim;
+	if (!sim.Init(parsers[0])) return 1;
+	std::unique_ptr<SIM_STATE> loaded(new SIM_STATE);
+	std::vector<std::string> written;
+	std::vector<MAP_OBJECT> mirrored;
+	size_t units = 0, mismatches = 0;
+	if (frames[0] != replayed[0] || frames[1] != replayed[1]) mismatches++;
+	if (frames[0].size() != frames[1].size() || frames[0].size()>SIMULATOR::MATCH_TICKS + 1) mismatches++;
+	for (size_t f = 0; f<frames[0].size() && f<frames[1].size(); f++)
+	{
+		for (int side = 0; side<2; side++)
+		{
+			std::vector<LINE_VIEW> lines(frames[side][f].begin(), frames[side][f].end());
+			parsers[side].Parse(lines);
+		}
+		const PARSER &ours = parsers[0], &theirs = parsers[1];
+		bool last = f + 1 == frames[0].size();
+		if (ours.tick != (int)f + 1 || theirs.tick != ours.tick) mismatches++;
+		if ((ours.match_result == PARSER::ONGOING) != !last) mismatches++;
+		if (ours.level[0] != theirs.level[1] || ours.level[1] != theirs.level[0]) mismatches++;
+		std::map<std::pair<int, int>, int> minions_on;
+		for (const MAP_OBJECT &unit : ours.Units)
+		{
+			if (unit.hp<=0 || !sim.Walkable(unit.pos)) mismatches++;
+			if (unit.t == MINION && ++minions_on[std::make_pair(unit.pos.x, unit.pos.y)]>1) mismatches++;
+		}
+		mirrored.clear();
+		for (const MAP_OBJECT &unit : theirs.Units)
+		{
+			MAP_OBJECT back = unit;
+			back.id = SIMULATOR::MirrorId(unit.id);
+			back.side = 1 - unit.side;
+			back.pos = sim.Mirror(unit.pos);
+			mirrored.push_back(back);
+		}
+		std::sort(mirrored.begin(), mirrored.end(), [](const MAP_OBJECT &a, const MAP_OBJECT &b) { return a.id<b.id; });
+		std::vector<MAP_OBJECT> sorted(ours.Units.begin(), ours.Units.end());
+		std::sort(sorted.begin(), sorted.end(), [](const MAP_OBJECT &a, const MAP_OBJECT &b) { return a.id<b.id; });
+		bool same = sorted.size() == mirrored.size();
+		for (size_t i = 0; same && i<sorted.size(); i++) same = SameUnit(sorted[i], mirrored[i]);
+		if (!same) mismatches++;
+		units += sorted.size();
+		if (last) continue;
+		if (!sim.Load(ours, *loaded)) mismatches++;
+		else for (int side = 0; side<2; side++)
+		{
+			sim.WriteFrame(*loaded, side, 1, written);
+			if (WithoutAttacks(written) != WithoutAttacks(frames[side][f])) mismatches++;
+		}
+	}
+	std::cout << frames[0].size() << " ticks, " << units << " units, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// the debug.log text of what reader holds from its position on, as moba-pack
+// text writes it; frames only if frames_only. count frames at most.
+static std::string ReplayText(REPLAY_READER &Reader, bool frames_only, size_t count)
+{
+	REPLAY_FRAME frame;
+	std::string sent, text;
+	std::vector<std::string> lines;
+	while (count>0)
+	{
+		REPLAY_READER::ITEM item = Reader.Next(frame, sent);
+		if (item == REPLAY_READER::ITEM_END) break;
+		if (item == REPLAY_READER::ITEM_SENT)
+		{
+			if (!frames_only) text += "Sent: " + sent;
+			continue;
+		}
+		frame.WriteText(lines);
+		for (size_t i = 0; i<lines.size(); i++) text += lines[i] + '\n';
+		count--;
+	}
+	return text;
+}
+
+// Two matches with the answers sent, one frame in a spacing the parser does
+// not write back, packed into replay_file: the text read back is the log,
+// byte for byte; seeks to ticks of both matches, back and forth, give the
+// frames from there; a truncated file reads back a prefix and says so.
+static int TestReplay(const char *map_file, const char *replay_file)
+{
+	std::vector<std::vector<std::string> > frames[2];
+	std::vector<std::string> answers[2];
+	int allocating_ticks = 0;
+	for (int match = 0; match<2; match++)
+	{
+		Hypno player;
+		if (!PlayMatch(map_file, match + 1, &player, frames[match], allocating_ticks, NULL, &answers[match])) return 1;
+		for (size_t f = 0; f<frames[match].size(); f++) frames[match][f][1] = match == 0 ? "match 1 duel" : "match 2 duel";
+	}
+	frames[1][150][0] = "tick  151";
+	std::string log;
+	std::vector<std::string> frame_text[2]; // of each frame, by match and tick - 1
+	{
+		std::ofstream out(replay_file, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+		if (!out.is_open())
+		{
+			std::cout << "cannot write " << replay_file << std::endl;
+			return 1;
+		}
+		out.write(REPLAY_FORMAT::MAGIC, REPLAY_FORMAT::MAGIC_SIZE);
+		REPLAY_WRITER writer;
+		for (int match = 0; match<2; match++)
+		{
+			for (size_t f = 0; f<frames[match].size(); f++)
+			{
+				std::vector<LINE_VIEW> lines(frames[match][f].begin(), frames[match][f].end());
+				writer.AddFrame(lines);
+				writer.AddSent(answers[match][f]);
+				std::string text;
+				for (const std::string &line : frames[match][f]) text += line + '\n';
+				frame_text[match].push_back(text);
+				log += text + "Sent: " + answers[match][f];
+			}
+		}
+		out.write(writer.Buffer().data(), writer.Buffer().size());
+	}
+	size_t mismatches = 0, seeks = 0;
+	REPLAY_READER reader;
+	if (!reader.Open(replay_file) || ReplayText(reader, false, SIZE_MAX) != log || reader.Corrupt()) mismatches++;
+	// keyframe ticks and their neighbours, then anywhere, up to past the end
+	const int edge_ticks[] = { 0, 1, REPLAY_FORMAT::KEYFRAME_INTERVAL, REPLAY_FORMAT::KEYFRAME_INTERVAL + 1 };
+	std::mt19937 rng(1);
+	for (int i = 0; i<200; i++)
+	{
+		int match = rng() % 3;
+		int tick = i<4 ? edge_ticks[i] : (int)(rng() % 1300);
+		size_t count = 1 + rng() % 3;
+		bool found = reader.Seek(match + 1, tick);
+		int first = std::max(tick, 1) - 1;
+		if (match == 2 || first>=(int)frame_text[match].size())
+		{
+			if (found) mismatches++;
+		} else
+		{
+			std::string expected;
+			for (size_t f = first; f<first + count && f<frame_text[match].size(); f++) expected += frame_text[match][f];
+			if (!found || ReplayText(reader, true, std::min(count, frame_text[match].size() - first)) != expected) mismatches++;
+		}
+		seeks++;
+	}
+	std::string bytes;
+	{
+		std::ifstream in(replay_file, std::ifstream::in | std::ifstream::binary);
+		bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	size_t packed = bytes.size();
+	{
+		std::ofstream out(replay_file, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+		out.write(bytes.data(), bytes.size() - 5);
+	}
+	REPLAY_READER truncated;
+	std::string prefix;
+	if (!truncated.Open(replay_file) || (prefix = ReplayText(truncated, false, SIZE_MAX), !truncated.Corrupt()) || log.compare(0, prefix.size(), prefix) != 0) mismatches++;
+	std::cout << frames[0].size() + frames[1].size() << " frames, " << log.size() << " -> " << packed << " bytes, " << seeks << " seeks, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Every walkable cell against the goals Hypno heads for, once with the next
+// hop table and once with landmarks only, where the fields are searched.
+static int TestFlow(const char *map_file)
+{
+	PARSER parser;
+	if (!LoadMap(map_file, parser)) return 1;
+	int max_x = parser.w - 1, max_y = parser.h - 1;
+	Position goals[] = { Position(1, 11), Position(11, 1), Position(9, 9), Position(4, max_y - 4),
+		Position(max_x - 4, 4), Position(max_x - 1, max_y - 1) };
+	size_t mismatches = 0;
+	for (int mode = 0; mode<2; mode++)
+	{
+		std::shared_ptr<DISTCACHE> cache = std::make_shared<DISTCACHE>();
+		cache->CreateFromParser(parser, DISTCACHE::BIT_PARALLEL_BFS, 0,
+			mode == 0 ? DISTCACHE::AUTO : DISTCACHE::LANDMARKS16, mode == 0);
+		FLOW_FIELDS fields;
+		std::vector<Position> cells, walkable_goals;
+		for (int y = 0; y<cache->map_dy; y++)
+			for (int x = 0; x<cache->map_dx; x++)
+				if (cache->mMap[x + y*cache->map_dx]) cells.push_back(Position(x, y));
+		for (const Position &goal : goals)
+			if (cache->mMap[goal.x + goal.y*cache->map_dx]) walkable_goals.push_back(goal);
+		// a second tick reads the fields kept from the first
+		for (int tick = 0; tick<2; tick++)
+		{
+			fields.BeginTick(cache);
+			for (const Position &goal : walkable_goals)
+			{
+				FLOW_FIELD field = fields.Toward(goal);
+				for (const Position &p : cells)
+				{
+					if (field.Dist(p) != cache->GetDist(p, goal)) mismatches++;
+					if (!(p == goal) && !(field.Next(p) == cache->GetNextTowards(p, goal))) mismatches++;
+				}
+			}
+			FLOW_FIELD nearest = fields.TowardNearest(walkable_goals.data(), walkable_goals.size());
+			for (const Position &p : cells)
+			{
+				int d = cache->Unreachable();
+				for (const Position &goal : walkable_goals) d = std::min(d, cache->GetDist(p, goal));
+				if (nearest.Dist(p) != d) mismatches++;
+				if (d>0 && d<cache->Unreachable() && nearest.Dist(nearest.Next(p)) != d - 1) mismatches++;
+			}
+		}
+		std::cout << (mode == 0 ? "next hop table" : "landmarks") << ": " << cells.size() << " cells, "
+			<< walkable_goals.size() << " goals, " << fields.Searches() << " searches" << std::endl;
+	}
+	std::cout << (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Velocity and LastTarget of every unit against std::map bookkeeping of the
+// previous positions and the latest attacks, the way the trackers were
+// written before UnitHistory.
+static int TestHistory(const char *map_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	int allocating_ticks = 0;
+	Hypno player;
+	if (!PlayMatch(map_file, 1, &player, frames, allocating_ticks)) return 1;
+	PARSER parser;
+	UnitHistory history;
+	std::map<int, Position> last_pos;
+	std::map<int, int> appeared; // id -> tick it came on the map
+	std::map<int, std::pair<int, int> > last_target; // id -> (tick, target)
+	size_t checked = 0, mismatches = 0;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		std::vector<LINE_VIEW> lines(frames[f].begin(), frames[f].end());
+		parser.Parse(lines);
+		history.Update(parser);
+		std::map<int, Position> pos;
+		for (const MAP_OBJECT &unit : parser.Units)
+		{
+			pos[unit.id] = unit.pos;
+			if (!last_pos.count(unit.id)) appeared[unit.id] = parser.tick;
+		}
+		for (const ATTACK_INFO &attack : parser.Attacks)
+		{
+			if (pos.count(attack.attacker_id)) last_target[attack.attacker_id] = std::make_pair(parser.tick, attack.target_id);
+		}
+		for (const MAP_OBJECT &unit : parser.Units)
+		{
+			std::map<int, Position>::const_iterator prev = last_pos.find(unit.id);
+			Position v = prev == last_pos.end() ? Position(0, 0) : Position(unit.pos.x - prev->second.x, unit.pos.y - prev->second.y);
+			std::map<int, std::pair<int, int> >::const_iterator target = last_target.find(unit.id);
+			int expected_target = target != last_target.end() && parser.tick - target->second.first<UnitHistory::Depth &&
+				target->second.first>=appeared[unit.id] ? target->second.second : -1;
+			if (!(history.Velocity(unit.id) == v) || history.LastTarget(unit.id) != expected_target) mismatches++;
+			checked++;
+		}
+		// units that left the map start over, like the history does
+		for (std::map<int, std::pair<int, int> >::iterator it = last_target.begin(); it != last_target.end();)
+		{
+			if (pos.count(it->first)) ++it;
+			else it = last_target.erase(it);
+		}
+		last_pos.swap(pos);
+	}
+	std::cout << frames.size() << " frames, " << checked << " units checked, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Hypno that keeps what GetMostEvilEnemyHeroes said on every tick
+class EVIL_RECORDER : public Hypno
+{
+public:
+	std::map<int, std::map<int, int> > mEvil; // tick -> hero id -> count
+
+protected:
+	virtual void Process() override
+	{
+		Hypno::Process();
+		TICK_MAP<int, int> evil = GetMostEvilEnemyHeroes();
+		mEvil[mParser.tick] = std::map<int, int>(evil.begin(), evil.end());
+	}
+};
+
+// GetMostEvilEnemyHeroes against the tracker it replaced: our minions by id
+// with their last position, and a count per enemy hero that is set to 0 but
+// kept while the hero is off the map.
+static int TestEvilHeroes(const char *map_file)
+{
+	std::vector<std::vector<std::string> > frames;
+	int allocating_ticks = 0;
+	EVIL_RECORDER player;
+	if (!PlayMatch(map_file, 1, &player, frames, allocating_ticks)) return 1;
+	PARSER parser;
+	std::map<int, Position> last_minions;
+	std::map<int, int> counts;
+	size_t checked = 0, mismatches = 0, listed = 0;
+	for (size_t f = 0; f<frames.size(); f++)
+	{
+		std::vector<LINE_VIEW> lines(frames[f].begin(), frames[f].end());
+		parser.Parse(lines);
+		std::map<int, Position> minions;
+		std::map<int, int> heroes; // enemy heroes on the map
+		for (const MAP_OBJECT &unit : parser.Units)
+		{
+			if (unit.t == MINION && unit.side == 0) minions[unit.id] = unit.pos;
+			if (unit.t == HERO && unit.side != 0) heroes[unit.id] = 1;
+		}
+		for (std::map<int, int>::iterator it = counts.begin(); it != counts.end(); ++it)
+		{
+			if (!heroes.count(it->first)) it->second = 0;
+		}
+		for (std::map<int, Position>::const_iterator dead = last_minions.begin(); dead != last_minions.end(); ++dead)
+		{
+			if (minions.count(dead->first)) continue;
+			for (const MAP_OBJECT &unit : parser.Units)
+			{
+				if (unit.t == HERO && unit.side != 0 && unit.pos.DistSquare(dead->second) <= HERO_RANGE_SQ) counts[unit.id]++;
+			}
+		}
+		last_minions.swap(minions);
+		std::map<int, std::map<int, int> >::const_iterator got = player.mEvil.find(parser.tick);
+		if (got == player.mEvil.end()) continue; // the match was over
+		std::map<int, int> expected;
+		for (std::map<int, int>::const_iterator it = counts.begin(); it != counts.end(); ++it)
+		{
+			if (heroes.count(it->first)) expected.insert(*it);
+		}
+		if (got->second != expected)
+		{
+			if (mismatches++ == 0) std::cout << "DIFFER first at tick " << parser.tick << std::endl;
+		}
+		listed += expected.size();
+		checked++;
+	}
+	std::cout << checked << " ticks, " << listed << " heroes listed, "
+		<< (mismatches == 0 ? "identical" : "DIFFER") << " (" << mismatches << " mismatches)" << std::endl;
+	return checked>0 && mismatches == 0 ? 0 : 1;
+}
+
+// a few whole matches, each with its own spawns and respawns; with a
+// lookahead depth every tick also loads the simulator and searches ahead
+static int TestAllocations(const char *map_file, int lookahead_depth)
+{
+	if (!ALLOC_TRACKER::Enabled())
+	{
+		std::cout << "the allocation hook is not linked" << std::endl;
+		return 1;
+	}
+	HypnoParams params;
+	params.lookaheadDepth = lookahead_depth;
+	int failed = 0;
+	for (uint32_t seed = 1; seed<=3; seed++)
+	{
+		std::vector<std::vector<std::string> > frames;
+		int allocating_ticks = 0;
+		Hypno player("test", params);
+		if (!PlayMatch(map_file, seed, &player, frames, allocating_ticks)) return 1;
+		std::cout << "seed " << seed << ": " << frames.size() << " ticks, " << allocating_ticks
+			<< " allocating past tick " << TICK_ALLOCATIONS::WARMUP_TICKS << std::endl;
+		if (allocating_ticks>0) failed++;
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string what = argc>1 ? argv[1] : "";
+	if (what == "parse" && argc>2)
+	{
+		return TestParse(argv[2]);
+	}
+	if (what == "grid" && argc>2)
+	{
+		return TestGrid(argv[2]);
+	}
+	if (what == "commands")
+	{
+		return TestCommands(argc>2 ? atoi(argv[2]) : 100000);
+	}
+	if (what == "distcache" && argc>2)
+	{
+		return TestDistCache(argv[2]);
+	}
+	if (what == "storage" && argc>2)
+	{
+		return TestStorage(argv[2]);
+	}
+	if (what == "nexthop" && argc>2)
+	{
+		return TestNextHops(argv[2]);
+	}
+	if (what == "matrix")
+	{
+		return TestMatrix();
+	}
+	if (what == "rangemasks" && argc>2)
+	{
+		return TestRangeMasks(argv[2]);
+	}
+	if (what == "sim" && argc>2)
+	{
+		return TestSimulator(argv[2]);
+	}
+	if (what == "replay" && argc>3)
+	{
+		return TestReplay(argv[2], argv[3]);
+	}
+	if (what == "flow" && argc>2)
+	{
+		return TestFlow(argv[2]);
+	}
+	if (what == "history" && argc>2)
+	{
+		return TestHistory(argv[2]);
+	}
+	if (what == "evil" && argc>2)
+	{
+		return TestEvilHeroes(argv[2]);
+	}
+	if (what == "allocations" && argc>2)
+	{
+		return TestAllocations(argv[2], argc>3 ? atoi(argv[3]) : 0);
+	}
+	std::cout << "usage: " << argv[0] << " parse <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " grid <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " commands [answers]" << std::endl;
+	std::cout << "       " << argv[0] << " distcache <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " storage <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " nexthop <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " matrix" << std::endl;
+	std::cout << "       " << argv[0] << " rangemasks <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " sim <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " replay <map.txt> <replay.bin>" << std::endl;
+	std::cout << "       " << argv[0] << " flow <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " history <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " evil <map.txt>" << std::endl;
+	std::cout << "       " << argv[0] << " allocations <map.txt> [lookahead depth]" << std::endl;
+	return 1;
+}
@@ -0,0 +1,849 @@
+#include "stdafx.h"
+#include "sim.h"
+#include "Bitboard.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+
+static const char *TypeName(UNIT_TYPE t)
+{
+	switch (t)
+	{
+		case HERO: return "hero";
+		case BASE: return "base";
+		case TURRET: return "turret";
+		case MINION: return "minion";
+	}
+	return "?";
+}
+
+static bool Adjacent(const Position &a, const Position &b)
+{
+	return std::abs(a.x - b.x)<=1 && std::abs(a.y - b.y)<=1;
+}
+
+static int HeroMaxHp(int level)
+{
+	return HERO_MAX_HP_BASE + level*HERO_MAX_HP_PER_LEVEL;
+}
+
+static void ClearCell(Bitboard &board, const Position &pos)
+{
+	board.GetRow(pos.y) &= ~(Bitboard::Row(1)<<pos.x);
+}
+
+SIMULATOR::SIMULATOR()
+{
+	mWidth = mHeight = 0;
+	mMinions.reserve(SIM_STATE::MAX_UNITS);
+}
+
+bool SIMULATOR::Walkable(const Position &pos) const
+{
+	return pos.x>=0 && pos.x<mWidth && pos.y>=0 && pos.y<mHeight && mWalkable[pos.x + pos.y*mWidth];
+}
+
+bool SIMULATOR::OnLane(const Position &pos) const
+{
+	for (int lane = 0; lane<LANES; lane++)
+	{
+		if (std::find(mLanes[lane].begin(), mLanes[lane].end(), pos) != mLanes[lane].end()) return true;
+	}
+	return false;
+}
+
+int SIMULATOR::LanePenalty(int lane, const Position &pos) const
+{
+	switch (lane)
+	{
+		case LANE_TOP: return std::min(pos.x, mHeight - 1 - pos.y); // left and top edge
+		case LANE_DOWN: return std::min(pos.y, mWidth - 1 - pos.x); // bottom and right edge
+		default: return std::abs(pos.x*(mHeight - 1) - pos.y*(mWidth - 1)) / std::max(mWidth - 1, 1); // diagonal
+	}
+}
+
+std::vector<Position> SIMULATOR::FindPath(const Position &from, const Position &to, int lane) const
+{
+	// Dijkstra, a step costs more the farther it is from the lane's line
+	static const int dx[4] = { 0, 1, 0, -1 };
+	static const int dy[4] = { 1, 0, -1, 0 };
+	const int cells = mWidth*mHeight;
+	std::vector<int> cost(cells, INT32_MAX), parent(cells, -1);
+	typedef std::pair<int, int> ENTRY; // cost, cell
+	std::priority_queue<ENTRY, std::vector<ENTRY>, std::greater<ENTRY> > open;
+	int start = from.x + from.y*mWidth, goal = to.x + to.y*mWidth;
+	cost[start] = 0;
+	open.push(ENTRY(0, start));
+	while (!open.empty())
+	{
+		ENTRY e = open.top();
+		open.pop();
+		if (e.first != cost[e.second]) continue;
+		if (e.second == goal) break;
+		Position p(e.second%mWidth, e.second/mWidth);
+		for (int d = 0; d<4; d++)
+		{
+			Position n(p.x + dx[d], p.y + dy[d]);
+			if (!Walkable(n)) continue;
+			int c = n.x + n.y*mWidth;
+			int next_cost = e.first + 1 + 4*LanePenalty(lane, n);
+			if (next_cost<cost[c])
+			{
+				cost[c] = next_cost;
+				parent[c] = e.second;
+				open.push(ENTRY(next_cost, c));
+			}
+		}
+	}
+	std::vector<Position> path;
+	if (cost[goal] == INT32_MAX) return path;
+	for (int c = goal; c != -1; c = parent[c])
+	{
+		path.push_back(Position(c%mWidth, c/mWidth));
+	}
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
+bool SIMULATOR::Init(const PARSER &Parser)
+{
+	mWidth = Parser.w;
+	mHeight = Parser.h;
+	if (!Bitboard::Fits(mWidth, mHeight) || (int)Parser.Arena.size() != mWidth*mHeight) return false;
+	mWalkable.resize(mWidth*mHeight);
+	for (int i = 0; i<mWidth*mHeight; i++)
+	{
+		mWalkable[i] = Parser.Arena[i] == PARSER::EMPTY;
+	}
+	for (int y = 0; y<mHeight; y++)
+	{
+		for (int x = 0; x<mWidth; x++)
+		{
+			if (Walkable(Position(x, y)) != Walkable(Mirror(Position(x, y)))) return false;
+		}
+	}
+
+	// the base is the walkable cell closest to the bottom left corner
+	bool found = false;
+	for (int s = 0; s<mWidth + mHeight && !found; s++)
+	{
+		for (int y = 0; y<=s && !found; y++)
+		{
+			if (Walkable(Position(s - y, y)))
+			{
+				mBase[0] = Position(s - y, y);
+				found = true;
+			}
+		}
+	}
+	if (!found) return false;
+	mBase[1] = Mirror(mBase[0]);
+
+	// heroes (re)spawn around it
+	std::vector<std::pair<int, Position> > around;
+	for (int y = 0; y<mHeight; y++)
+	{
+		for (int x = 0; x<mWidth; x++)
+		{
+			Position p(x, y);
+			if (Walkable(p) && p != mBase[0]) around.push_back(std::make_pair(p.DistSquare(mBase[0]), p));
+		}
+	}
+	if (around.size()<5) return false;
+	std::sort(around.begin(), around.end());
+	for (int i = 0; i<5; i++)
+	{
+		mHeroSpawn[0][i] = around[i].second;
+		mHeroSpawn[1][i] = Mirror(around[i].second);
+	}
+
+	// The lanes run from base to base. The top lane rotated by 180 degrees
+	// is the down lane walked backwards, and the mid lane is built from two
+	// rotated halves, so both sides get the same arena.
+	mLanes[LANE_TOP] = FindPath(mBase[0], mBase[1], LANE_TOP);
+	mLanes[LANE_DOWN].clear();
+	for (int i = (int)mLanes[LANE_TOP].size() - 1; i>=0; i--)
+	{
+		mLanes[LANE_DOWN].push_back(Mirror(mLanes[LANE_TOP][i]));
+	}
+	Position center(mWidth/2, mHeight/2);
+	for (int r = 0; !Walkable(center) && r<mWidth; r++)
+	{
+		for (int y = mHeight/2 - r; y<=mHeight/2 + r && !Walkable(center); y++)
+		{
+			for (int x = mWidth/2 - r; x<=mWidth/2 + r && !Walkable(center); x++)
+			{
+				if (Walkable(Position(x, y))) center = Position(x, y);
+			}
+		}
+	}
+	std::vector<Position> half = FindPath(mBase[0], center, LANE_MID);
+	std::vector<Position> middle = FindPath(center, Mirror(center), LANE_MID);
+	std::vector<Position> &mid = mLanes[LANE_MID];
+	mid = half;
+	mid.insert(mid.end(), middle.begin() + std::min<size_t>(1, middle.size()), middle.end());
+	for (int i = (int)half.size() - 2; i>=0; i--)
+	{
+		mid.push_back(Mirror(half[i]));
+	}
+	if (half.empty() || middle.empty() || mLanes[LANE_TOP].empty()) return false;
+
+	// two turrets per lane on each side, next to the lane if there is room
+	for (int lane = 0; lane<LANES; lane++)
+	{
+		const std::vector<Position> &path = mLanes[lane];
+		for (int k = 0; k<2; k++)
+		{
+			Position cell = path[path.size()*(k == 0 ? 20 : 38)/100];
+			for (int d = 0; d<9; d++)
+			{
+				Position n(cell.x + d%3 - 1, cell.y + d/3 - 1);
+				if (Walkable(n) && !OnLane(n))
+				{
+					cell = n;
+					break;
+				}
+			}
+			mTurret[0][lane*2 + k] = cell;
+			mTurret[1][lane*2 + k] = Mirror(cell);
+		}
+	}
+	return true;
+}
+
+int SIMULATOR::MirrorId(int id)
+{
+	if (id>=1 && id<=10) return id<=5 ? id + 5 : id - 5;
+	if (id == 11 || id == 12) return 23 - id;
+	if (id>=13 && id<=24) return id<=18 ? id + 6 : id - 6;
+	return id;
+}
+
+uint32_t SIMULATOR::Random(SIM_STATE &state)
+{
+	uint32_t x = state.rng;
+	x ^= x<<13;
+	x ^= x>>17;
+	x ^= x<<5;
+	return state.rng = x;
+}
+
+void SIMULATOR::Reset(SIM_STATE &state, uint32_t seed) const
+{
+	state = SIM_STATE();
+	state.rng = seed;
+	for (int side = 0; side<2; side++)
+	{
+		int *slots = state.spawn_slot + side*5;
+		for (int i = 0; i<5; i++)
+		{
+			slots[i] = i;
+		}
+		for (int i = 4; i>0 && seed != 0; i--)
+		{
+			std::swap(slots[i], slots[Random(state)%(i + 1)]);
+		}
+	}
+	state.tick = 1;
+	state.result = PARSER::ONGOING;
+	state.next_minion_id = 100;
+	state.unit_count = SIM_STATE::FIXED_UNITS;
+	for (int id = 1; id<=SIM_STATE::FIXED_UNITS; id++)
+	{
+		SIM_UNIT &u = state.units[id - 1];
+		SetFixedUnit(u, id);
+		if (id<=10) u.unit.pos = mHeroSpawn[u.unit.side][state.spawn_slot[id - 1]];
+	}
+	SpawnWave(state);
+}
+
+void SIMULATOR::SetFixedUnit(SIM_UNIT &u, int id) const
+{
+	u.unit.id = id;
+	u.alive = true;
+	u.target_id = -1;
+	u.lane = -1;
+	u.path_index = -1;
+	u.respawn_tick = 0;
+	if (id<=10)
+	{
+		u.unit.t = HERO;
+		u.unit.side = id<=5 ? 0 : 1;
+		u.unit.hp = HeroMaxHp(0);
+		u.unit.pos = mHeroSpawn[u.unit.side][(id - 1)%5];
+	} else if (id<=12)
+	{
+		u.unit.t = BASE;
+		u.unit.side = id - 11;
+		u.unit.hp = BASE_MAX_HP;
+		u.unit.pos = mBase[u.unit.side];
+	} else
+	{
+		u.unit.t = TURRET;
+		u.unit.side = id<=18 ? 0 : 1;
+		u.unit.hp = TURRET_MAX_HP;
+		u.unit.pos = mTurret[u.unit.side][(id - 13)%TURRETS_PER_SIDE];
+	}
+}
+
+bool SIMULATOR::Load(const PARSER &Parser, SIM_STATE &state)
+{
+	state = SIM_STATE();
+	for (int i = 0; i<10; i++)
+	{
+		state.spawn_slot[i] = i%5;
+	}
+	state.tick = Parser.tick;
+	state.level[0] = Parser.level[0];
+	state.level[1] = Parser.level[1];
+	state.result = PARSER::ONGOING;
+	state.unit_count = SIM_STATE::FIXED_UNITS;
+	for (int id = 1; id<=SIM_STATE::FIXED_UNITS; id++)
+	{
+		SIM_UNIT &u = state.units[id - 1];
+		SetFixedUnit(u, id);
+		u.alive = false; // until the parser has it
+		if (id<=10) u.respawn_tick = state.tick + HERO_RESPAWN_TICKS;
+	}
+	for (size_t r = 0; r<Parser.Respawns.size(); r++)
+	{
+		int id = Parser.Respawns[r].hero_id;
+		if (id>=1 && id<=10) state.units[id - 1].respawn_tick = Parser.Respawns[r].tick;
+	}
+	// indices into Parser.Units; never past the reserve, so a tick does not allocate
+	std::vector<int> &minions = mMinions;
+	minions.clear();
+	for (size_t i = 0; i<Parser.Units.size(); i++)
+	{
+		const MAP_OBJECT &unit = Parser.Units[i];
+		if (unit.t == MINION)
+		{
+			if (SIM_STATE::FIXED_UNITS + minions.size() + 1>SIM_STATE::MAX_UNITS) return false;
+			minions.push_back((int)i);
+			continue;
+		}
+		if (unit.id<1 || unit.id>SIM_STATE::FIXED_UNITS) return false;
+		SIM_UNIT &u = state.units[unit.id - 1];
+		if (u.unit.t != unit.t || u.unit.side != unit.side) return false;
+		u.unit = unit;
+		u.alive = true;
+	}
+	std::sort(minions.begin(), minions.end(), [&Parser](int a, int b) { return Parser.Units[a].id<Parser.Units[b].id; });
+	state.next_minion_id = 0;
+	for (size_t i = 0; i<minions.size(); i++)
+	{
+		const MAP_OBJECT &unit = Parser.Units[minions[i]];
+		if (unit.id<=SIM_STATE::FIXED_UNITS) return false;
+		SIM_UNIT &m = state.units[state.unit_count++];
+		m.unit = unit;
+		m.alive = true;
+		m.target_id = -1;
+		m.respawn_tick = 0;
+		// the lane cell it is on or closest to, the first along its way
+		int best_dist = INT32_MAX;
+		for (int lane = 0; lane<LANES; lane++)
+		{
+			const std::vector<Position> &path = mLanes[lane];
+			for (int k = 0; k<(int)path.size(); k++)
+			{
+				int index = unit.side == 0 ? k : (int)path.size() - 1 - k;
+				int dist = unit.pos.DistSquare(path[index]);
+				if (dist<best_dist)
+				{
+					best_dist = dist;
+					m.lane = lane;
+					m.path_index = index;
+				}
+			}
+		}
+		state.next_minion_id = unit.id + 1;
+	}
+	// the targets shot last tick, kept while in range
+	for (size_t a = 0; a<Parser.Attacks.size(); a++)
+	{
+		int index = IndexOf(state, Parser.Attacks[a].attacker_id);
+		if (index != -1) state.units[index].target_id = Parser.Attacks[a].target_id;
+	}
+	return true;
+}
+
+void SIMULATOR::GreedyCommands(const SIM_STATE &state, int side, int skip_id, std::vector<COMMAND> &commands) const
+{
+	for (int id = side*5 + 1; id<=side*5 + 5; id++)
+	{
+		const SIM_UNIT &hero = state.units[id - 1];
+		if (!hero.alive || id == skip_id) continue;
+		SIM_UNIT shooter = hero;
+		shooter.target_id = -1;
+		int target = ChooseTarget(state, shooter, HERO_RANGE_SQ);
+		if (target == -1) continue;
+		COMMAND command;
+		command.type = COMMAND::ATTACK;
+		command.hero_id = side == 0 ? id : MirrorId(id);
+		int target_id = state.units[target].unit.id;
+		command.target_id = side == 0 ? target_id : MirrorId(target_id);
+		commands.push_back(command);
+	}
+}
+
+int SIMULATOR::IndexOf(const SIM_STATE &state, int id)
+{
+	if (id>=1 && id<=SIM_STATE::FIXED_UNITS) return state.units[id - 1].alive ? id - 1 : -1;
+	// minions are kept in id order
+	int lo = SIM_STATE::FIXED_UNITS, hi = state.unit_count;
+	while (lo<hi)
+	{
+		int m = (lo + hi)/2;
+		if (state.units[m].unit.id<id) lo = m + 1;
+		else hi = m;
+	}
+	return lo<state.unit_count && state.units[lo].unit.id == id && state.units[lo].alive ? lo : -1;
+}
+
+int SIMULATOR::Priority(UNIT_TYPE t)
+{
+	switch (t)
+	{
+		case MINION: return 0;
+		case BASE: return 1;
+		case TURRET: return 2;
+		default: return 3;
+	}
+}
+
+int SIMULATOR::GetDamage(const SIM_STATE &state, const MAP_OBJECT &unit) const
+{
+	switch (unit.t)
+	{
+		case HERO: return int(HERO_DAMAGE_BASE + state.level[unit.side]*HERO_DAMAGE_PER_LEVEL);
+		case MINION: return MINION_DAMAGE;
+		case TURRET: return TURRET_DAMAGE;
+		default: return 0;
+	}
+}
+
+int SIMULATOR::ChooseTarget(const SIM_STATE &state, const SIM_UNIT &shooter, int range_sq) const
+{
+	const MAP_OBJECT &me = shooter.unit;
+	if (shooter.target_id != -1)
+	{
+		// stays on the previous target while it is in range
+		int prev = IndexOf(state, shooter.target_id);
+		if (prev != -1 && me.pos.DistSquare(state.units[prev].unit.pos)<=range_sq) return prev;
+	}
+	// then minion, base, turret, hero; the closer, the weaker, the lower id
+	int best = -1, best_priority = 0, best_dist = 0;
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		const SIM_UNIT &u = state.units[i];
+		if (!u.alive || u.unit.side == me.side) continue;
+		int dist = me.pos.DistSquare(u.unit.pos);
+		if (dist>range_sq) continue;
+		int priority = Priority(u.unit.t);
+		if (best != -1)
+		{
+			const MAP_OBJECT &b = state.units[best].unit;
+			if (priority != best_priority ? priority>best_priority :
+				dist != best_dist ? dist>best_dist :
+				u.unit.hp != b.hp ? u.unit.hp>b.hp : u.unit.id>b.id) continue;
+		}
+		best = i;
+		best_priority = priority;
+		best_dist = dist;
+	}
+	return best;
+}
+
+bool SIMULATOR::EnemyInRange(const SIM_STATE &state, const Position *start, int side, const Position &pos) const
+{
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		const SIM_UNIT &u = state.units[i];
+		if (u.alive && u.unit.side != side && pos.DistSquare(start[i])<=MINION_RANGE_SQ) return true;
+	}
+	return false;
+}
+
+void SIMULATOR::AddAttack(SIM_STATE &state, const MAP_OBJECT &attacker, const MAP_OBJECT &target) const
+{
+	if (state.attack_count == SIM_STATE::MAX_ATTACKS) return;
+	ATTACK_INFO &a = state.attacks[state.attack_count++];
+	a.attacker_id = attacker.id;
+	a.attacker_pos = attacker.pos;
+	a.target_id = target.id;
+	a.target_pos = target.pos;
+}
+
+void SIMULATOR::Damage(SIM_STATE &state, const int *damage, bool by_heroes, int *gained) const
+{
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		SIM_UNIT &u = state.units[i];
+		if (damage[i] == 0 || !u.alive) continue;
+		u.unit.hp -= damage[i];
+		if (u.unit.hp>0) continue;
+		u.unit.hp = 0;
+		u.alive = false;
+		int killer = 1 - u.unit.side;
+		if (u.unit.t == HERO)
+		{
+			u.respawn_tick = state.tick + HERO_RESPAWN_TICKS;
+			if (state.rng != 0) u.respawn_tick += Random(state)%(RESPAWN_JITTER + 1);
+		}
+		if (u.unit.t == MINION && by_heroes) gained[killer] += MINION_KILL_LEVELS;
+		if (u.unit.t == TURRET) gained[killer] += TURRET_KILL_LEVELS;
+	}
+}
+
+void SIMULATOR::RemoveDead(SIM_STATE &state) const
+{
+	int kept = SIM_STATE::FIXED_UNITS;
+	for (int i = SIM_STATE::FIXED_UNITS; i<state.unit_count; i++)
+	{
+		if (!state.units[i].alive) continue;
+		if (kept != i) state.units[kept] = state.units[i];
+		kept++;
+	}
+	state.unit_count = kept;
+}
+
+bool SIMULATOR::NextStep(const SIM_UNIT &m, Position &step) const
+{
+	if (m.target_id != -1) return false; // shot this tick
+	const std::vector<Position> &path = mLanes[m.lane];
+	int next = m.path_index + (m.unit.side == 0 ? 1 : -1);
+	if (next<0 || next>=(int)path.size()) return false; // at the enemy base
+	// along the lane, or back onto it after a step aside
+	bool on_path = m.unit.pos == path[m.path_index];
+	step = on_path || Adjacent(m.unit.pos, path[next]) ? path[next] : path[m.path_index];
+	return true;
+}
+
+void SIMULATOR::MoveMinions(SIM_STATE &state) const
+{
+	Bitboard occupied;
+	Position start[SIM_STATE::MAX_UNITS]; // enemies are looked for where they stood
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		start[i] = state.units[i].unit.pos;
+		if (i>=SIM_STATE::FIXED_UNITS) occupied.Set(start[i]);
+	}
+	// a cell both sides step onto stays empty this tick, otherwise the lower
+	// minion ids (side 0's in every wave) would always get it
+	Bitboard wanted[2];
+	for (int i = SIM_STATE::FIXED_UNITS; i<state.unit_count; i++)
+	{
+		Position step;
+		if (NextStep(state.units[i], step)) wanted[state.units[i].unit.side].Set(step);
+	}
+	Bitboard contested = wanted[0] & wanted[1];
+	for (int i = SIM_STATE::FIXED_UNITS; i<state.unit_count; i++)
+	{
+		SIM_UNIT &m = state.units[i];
+		Position step;
+		if (!NextStep(m, step)) continue;
+		const std::vector<Position> &path = mLanes[m.lane];
+		int next = m.path_index + (m.unit.side == 0 ? 1 : -1);
+		bool on_path = m.unit.pos == path[m.path_index];
+		if (!occupied.Test(step) && !contested.Test(step))
+		{
+			ClearCell(occupied, m.unit.pos);
+			occupied.Set(step);
+			m.unit.pos = step;
+			if (step == path[next]) m.path_index = next;
+			continue;
+		}
+		if (!on_path) continue;
+		// stuck: one step off the lane, even diagonally, if it gets an enemy in range
+		for (int k = 0; k<9; k++)
+		{
+			int d = m.unit.side == 0 ? k : 8 - k; // the same choice in either view
+			Position n(m.unit.pos.x + d%3 - 1, m.unit.pos.y + d/3 - 1);
+			if (d == 4 || !Walkable(n) || occupied.Test(n) || contested.Test(n) || !EnemyInRange(state, start, m.unit.side, n)) continue;
+			ClearCell(occupied, m.unit.pos);
+			occupied.Set(n);
+			m.unit.pos = n;
+			break;
+		}
+	}
+}
+
+void SIMULATOR::SpawnWave(SIM_STATE &state) const
+{
+	Bitboard occupied;
+	for (int i = SIM_STATE::FIXED_UNITS; i<state.unit_count; i++)
+	{
+		occupied.Set(state.units[i].unit.pos);
+	}
+	for (int l = 0; l<LANES; l++)
+	{
+		for (int side = 0; side<2; side++)
+		{
+			// side 1's lanes in mirrored order, so where lanes share cells near
+			// the base both sides fill them the same way
+			int lane = side == 0 ? l : LANES - 1 - l;
+			const std::vector<Position> &path = mLanes[lane];
+			// on the first free cells of the lane, the base cell is left out
+			int spawned = 0;
+			for (int k = 1; k<(int)path.size() - 1 && spawned<MINION_WAVE_SIZE; k++)
+			{
+				int index = side == 0 ? k : (int)path.size() - 1 - k;
+				if (occupied.Test(path[index])) continue;
+				if (state.unit_count == SIM_STATE::MAX_UNITS) return;
+				SIM_UNIT &m = state.units[state.unit_count++];
+				m.unit.id = state.next_minion_id++;
+				m.unit.side = side;
+				m.unit.hp = MINION_MAX_HP;
+				m.unit.pos = path[index];
+				m.unit.t = MINION;
+				m.alive = true;
+				m.target_id = -1;
+				m.lane = lane;
+				m.path_index = index;
+				m.respawn_tick = 0;
+				occupied.Set(path[index]);
+				spawned++;
+			}
+		}
+	}
+}
+
+void SIMULATOR::Step(SIM_STATE &state, const std::vector<COMMAND> commands[2]) const
+{
+	if (state.result != PARSER::ONGOING) return;
+	state.attack_count = 0;
+	int gained[2] = { 0, 0 };
+	int damage[SIM_STATE::MAX_UNITS];
+	bool acted[11] = {}; // by hero id, one order per hero and tick
+
+	// hero attacks, against where everything stood when the tick started
+	memset(damage, 0, sizeof(damage));
+	for (int side = 0; side<2; side++)
+	{
+		for (size_t c = 0; c<commands[side].size(); c++)
+		{
+			const COMMAND &command = commands[side][c];
+			if (command.type != COMMAND::ATTACK) continue;
+			int hero_id = side == 0 ? command.hero_id : MirrorId(command.hero_id);
+			int target = IndexOf(state, side == 0 ? command.target_id : MirrorId(command.target_id));
+			int hero = IndexOf(state, hero_id);
+			if (hero_id<1 || hero_id>10 || acted[hero_id] || hero == -1 || target == -1 ||
+				state.units[hero].unit.side != side || state.units[target].unit.side == side ||
+				state.units[hero].unit.pos.DistSquare(state.units[target].unit.pos)>HERO_RANGE_SQ)
+			{
+				state.dropped_commands++;
+				continue;
+			}
+			acted[hero_id] = true;
+			damage[target] += GetDamage(state, state.units[hero].unit);
+			AddAttack(state, state.units[hero].unit, state.units[target].unit);
+		}
+	}
+	Damage(state, damage, true, gained);
+	RemoveDead(state);
+
+	// hero moves, one step to a free or occupied cell, only walls block
+	for (int side = 0; side<2; side++)
+	{
+		for (size_t c = 0; c<commands[side].size(); c++)
+		{
+			const COMMAND &command = commands[side][c];
+			if (command.type != COMMAND::MOVE) continue;
+			int hero_id = side == 0 ? command.hero_id : MirrorId(command.hero_id);
+			Position to = side == 0 ? command.target_pos : Mirror(command.target_pos);
+			int hero = IndexOf(state, hero_id);
+			if (hero_id<1 || hero_id>10 || acted[hero_id] || hero == -1 ||
+				state.units[hero].unit.side != side || !Adjacent(state.units[hero].unit.pos, to) || !Walkable(to))
+			{
+				state.dropped_commands++;
+				continue;
+			}
+			acted[hero_id] = true;
+			state.units[hero].unit.pos = to;
+		}
+	}
+
+	// minions and turrets fire at once
+	memset(damage, 0, sizeof(damage));
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		SIM_UNIT &u = state.units[i];
+		if (!u.alive || (u.unit.t != MINION && u.unit.t != TURRET)) continue;
+		int target = ChooseTarget(state, u, u.unit.t == MINION ? MINION_RANGE_SQ : TURRET_RANGE_SQ);
+		if (target == -1)
+		{
+			u.target_id = -1;
+			continue;
+		}
+		u.target_id = state.units[target].unit.id;
+		damage[target] += GetDamage(state, u.unit);
+		AddAttack(state, u.unit, state.units[target].unit);
+	}
+	Damage(state, damage, false, gained);
+	RemoveDead(state);
+	MoveMinions(state);
+
+	// levels of the tick, the heroes get the extra hp
+	for (int side = 0; side<2; side++)
+	{
+		if (gained[side] == 0) continue;
+		state.level[side] += gained[side];
+		for (int id = side*5 + 1; id<=side*5 + 5; id++)
+		{
+			SIM_UNIT &hero = state.units[id - 1];
+			if (hero.alive) hero.unit.hp += gained[side]*HERO_MAX_HP_PER_LEVEL;
+		}
+	}
+
+	for (int id = 1; id<=10; id++)
+	{
+		SIM_UNIT &hero = state.units[id - 1];
+		if (hero.alive || hero.respawn_tick>state.tick) continue;
+		hero.alive = true;
+		hero.unit.hp = HeroMaxHp(state.level[hero.unit.side]);
+		hero.unit.pos = mHeroSpawn[hero.unit.side][state.spawn_slot[id - 1]];
+		hero.target_id = -1;
+	}
+
+	bool lost[2] = { !state.units[10].alive, !state.units[11].alive };
+	if (lost[0] || lost[1])
+	{
+		state.result = lost[0] && lost[1] ? PARSER::DRAW : lost[0] ? PARSER::DEFEAT : PARSER::VICTORY;
+	} else if (state.tick>=MATCH_TICKS)
+	{
+		int hp0 = state.units[10].unit.hp, hp1 = state.units[11].unit.hp;
+		state.result = hp0 == hp1 ? PARSER::DRAW : hp0<hp1 ? PARSER::DEFEAT : PARSER::VICTORY;
+	}
+	state.tick++;
+	if (state.result == PARSER::ONGOING && (state.tick - 1)%MINION_WAVE_TICKS == 0) SpawnWave(state);
+}
+
+PARSER::MATCH_RESULT SIMULATOR::Play(SIM_STATE &state, CLIENT *clients[2], int match_id, std::ostream *log, double *step_seconds) const
+{
+	typedef std::chrono::steady_clock CLOCK;
+	std::vector<std::string> frame;
+	std::vector<COMMAND> commands[2];
+	for (;;)
+	{
+		for (int side = 0; side<2; side++)
+		{
+			WriteFrame(state, side, match_id, frame);
+			std::string answer = clients[side]->DebugResponse(frame);
+			ParseCommands(answer, commands[side]);
+			if (side == 0 && log != NULL)
+			{
+				for (size_t l = 0; l<frame.size(); l++) *log << frame[l] << "\n";
+				if (answer.compare(0, 4, "tick") == 0) *log << "Sent: " << answer << "\n";
+			}
+		}
+		if (state.result != PARSER::ONGOING) return state.result;
+		CLOCK::time_point start = CLOCK::now();
+		Step(state, commands);
+		if (step_seconds != NULL) *step_seconds += std::chrono::duration<double>(CLOCK::now() - start).count();
+	}
+}
+
+MAP_OBJECT SIMULATOR::ToView(const MAP_OBJECT &unit, int side) const
+{
+	MAP_OBJECT view = unit;
+	if (side == 1)
+	{
+		view.id = MirrorId(unit.id);
+		view.side = 1 - unit.side;
+		view.pos = Mirror(unit.pos);
+	}
+	return view;
+}
+
+void SIMULATOR::WriteFrame(const SIM_STATE &state, int side, int match_id, std::vector<std::string> &lines) const
+{
+	char line[128];
+	lines.clear();
+	sprintf(line, "tick %d", state.tick);
+	lines.push_back(line);
+	sprintf(line, "match %d duel", match_id);
+	lines.push_back(line);
+	lines.push_back("controllers 10");
+	for (int id = 1; id<=10; id++)
+	{
+		sprintf(line, "%d %d", id, id<=5 ? 0 : OPPONENT_ID);
+		lines.push_back(line);
+	}
+	sprintf(line, "level %d %d", state.level[side], state.level[1 - side]);
+	lines.push_back(line);
+
+	size_t units_line = lines.size();
+	lines.push_back(std::string());
+	int units = 0;
+	for (int i = 0; i<state.unit_count; i++)
+	{
+		// the fixed ids in the order of the view, then the minions
+		int index = i<SIM_STATE::FIXED_UNITS && side == 1 ? MirrorId(i + 1) - 1 : i;
+		if (!state.units[index].alive) continue;
+		MAP_OBJECT u = ToView(state.units[index].unit, side);
+		sprintf(line, "%s %d %d %d %d %d", TypeName(u.t), u.id, u.side, u.hp, u.pos.x, u.pos.y);
+		lines.push_back(line);
+		units++;
+	}
+	sprintf(line, "units %d", units);
+	lines[units_line] = line;
+
+	sprintf(line, "attacks %d", state.attack_count);
+	lines.push_back(line);
+	for (int i = 0; i<state.attack_count; i++)
+	{
+		const ATTACK_INFO &a = state.attacks[i];
+		Position from = side == 1 ? Mirror(a.attacker_pos) : a.attacker_pos;
+		Position to = side == 1 ? Mirror(a.target_pos) : a.target_pos;
+		sprintf(line, "%d %d %d %d %d %d", side == 1 ? MirrorId(a.attacker_id) : a.attacker_id, from.x, from.y,
+			side == 1 ? MirrorId(a.target_id) : a.target_id, to.x, to.y);
+		lines.push_back(line);
+	}
+
+	size_t respawns_line = lines.size();
+	lines.push_back(std::string());
+	int respawns = 0;
+	for (int v = 1; v<=10; v++)
+	{
+		const SIM_UNIT &hero = state.units[(side == 1 ? MirrorId(v) : v) - 1];
+		if (hero.alive) continue;
+		sprintf(line, "%d %d %d", v, v<=5 ? 0 : 1, hero.respawn_tick);
+		lines.push_back(line);
+		respawns++;
+	}
+	sprintf(line, "respawns %d", respawns);
+	lines[respawns_line] = line;
+
+	if (state.result != PARSER::ONGOING)
+	{
+		PARSER::MATCH_RESULT result = state.result;
+		if (side == 1 && result != PARSER::DRAW) result = result == PARSER::VICTORY ? PARSER::DEFEAT : PARSER::VICTORY;
+		lines.push_back(result == PARSER::VICTORY ? "finished victory" : result == PARSER::DRAW ? "finished draw" : "finished defeat");
+	}
+	lines.push_back(".");
+}
+
+void SIMULATOR::ParseCommands(const std::string &answer, std::vector<COMMAND> &commands)
+{
+	commands.clear();
+	size_t begin = 0;
+	while (begin<answer.size())
+	{
+		size_t end = answer.find('\n', begin);
+		if (end == std::string::npos) end = answer.size();
+		std::string line = answer.substr(begin, end - begin);
+		begin = end + 1;
+		COMMAND command;
+		if (sscanf(line.c_str(), "attack %d %d", &command.hero_id, &command.target_id) == 2)
+		{
+			command.type = COMMAND::ATTACK;
+			commands.push_back(command);
+		} else if (sscanf(line.c_str(), "move %d %d %d", &command.hero_id, &command.target_pos.x, &command.target_pos.y) == 3)
+		{
+			command.type = COMMAND::MOVE;
+			commands.push_back(command);
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "parser.h"
+#include "Client.h"
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <ostream>
+#include <cstdint>
+
+// A unit of the simulated match. Heroes, bases and turrets keep their unit
+// while dead (alive is false), minions are dropped when they die.
+struct SIM_UNIT
+{
+	MAP_OBJECT unit; // in side 0's view
+	bool alive;
+	int target_id; // shot in the previous tick, -1 if none
+	int lane; // minions: the lane path they walk
+	int path_index; // minions: last lane cell they stood on
+	int respawn_tick; // dead heroes
+};
+
+// Everything that changes while a match is played, in fixed arrays so a
+// state can be copied with memcpy, e.g. to try moves ahead. Units 0..23 are
+// the heroes, bases and turrets by id (id - 1), the minions follow in id
+// order.
+struct SIM_STATE
+{
+	static const int FIXED_UNITS = 24;
+	static const int MAX_UNITS = 256;
+	static const int MAX_ATTACKS = MAX_UNITS;
+
+	int tick; // waiting for the commands of this tick
+	int level[2];
+	PARSER::MATCH_RESULT result; // for side 0
+	int next_minion_id;
+	int unit_count;
+	SIM_UNIT units[MAX_UNITS];
+	int attack_count;
+	ATTACK_INFO attacks[MAX_ATTACKS]; // done in the previous tick
+	int dropped_commands; // invalid ones, since the match started
+	uint32_t rng; // 0 keeps the match free of chance
+	int spawn_slot[10]; // of each hero around its base
+};
+static_assert(std::is_trivially_copyable<SIM_STATE>::value, "SIM_STATE is copied as raw memory");
+
+// Headless, deterministic implementation of the tick rules in game.html.
+// Each tick runs: hero attacks, removals, hero moves, minion and turret fire,
+// removals, minion moves, levels, respawns. Frames are written in the
+// server's text format from either side's view (side 1 sees the arena
+// rotated by 180 degrees, with hero, base and turret ids swapped), so any
+// CLIENT can play through DebugResponse, and the commands it answers are
+// read back the same way.
+//
+// The server's unit placement and timings are not in the tree; bases sit in
+// the corners, turrets on the three lanes, and the lanes are the straight
+// edges and the diagonal of the arena. The constants below are our best
+// guesses where game.html is silent.
+class SIMULATOR
+{
+public:
+	static const int MATCH_TICKS = 1200;
+	static const int MINION_DAMAGE = 10;
+	static const int TURRET_DAMAGE = 100;
+	static const int MINION_WAVE_TICKS = 30; // a wave on every lane this often
+	static const int MINION_WAVE_SIZE = 3;
+	static const int HERO_RESPAWN_TICKS = 20;
+	static const int RESPAWN_JITTER = 4;
+	static const int MINION_KILL_LEVELS = 1; // if a hero hit it last
+	static const int TURRET_KILL_LEVELS = 10;
+	static const int OPPONENT_ID = 1; // controller id of the other side's heroes
+
+	enum LANE
+	{
+		LANE_TOP,
+		LANE_MID,
+		LANE_DOWN,
+		LANES
+	};
+	static const int TURRETS_PER_SIDE = 2 * LANES; // ids 13..18 and 19..24
+
+	SIMULATOR();
+	// lays out bases, turrets and lanes on the map held by the parser; false
+	// if the arena is not point symmetric or too large for a Bitboard
+	bool Init(const PARSER &Parser);
+	// tick 1 of a new match. A seed other than 0 shuffles where the heroes
+	// spawn and adds up to RESPAWN_JITTER ticks to their respawns, so
+	// matches between the same clients differ.
+	void Reset(SIM_STATE &state, uint32_t seed = 0) const;
+	// simulates state.tick; commands[side] as that side answered them, in
+	// its own view. Invalid commands are dropped.
+	void Step(SIM_STATE &state, const std::vector<COMMAND> commands[2]) const;
+
+	// the tick the parser holds as a state, in the parser's view (ours is side
+	// 0), for trying moves ahead. False if the units do not fit the id layout
+	// above; minions go on the lane cell closest to them.
+	bool Load(const PARSER &Parser, SIM_STATE &state);
+	// attack orders for side's living heroes other than skip_id: the target
+	// a turret would choose within HERO_RANGE_SQ, in side's view
+	void GreedyCommands(const SIM_STATE &state, int side, int skip_id, std::vector<COMMAND> &commands) const;
+
+	// plays state to the end, clients[side] answering the frames of side;
+	// side 0's frames and answers go to log in debug.log format
+	PARSER::MATCH_RESULT Play(SIM_STATE &state, CLIENT *clients[2], int match_id, std::ostream *log = NULL, double *step_seconds = NULL) const;
+
+	// the frame of state.tick as the server sends it to side, ending with "."
+	void WriteFrame(const SIM_STATE &state, int side, int match_id, std::vector<std::string> &lines) const;
+	// the commands of a "tick ..." answer of CLIENT::HandleServerResponse
+	static void ParseCommands(const std::string &answer, std::vector<COMMAND> &commands);
+
+	Position Mirror(const Position &pos) const { return Position(mWidth - 1 - pos.x, mHeight - 1 - pos.y); }
+	static int MirrorId(int id); // hero, base and turret ids of the other view
+	bool Walkable(const Position &pos) const;
+	const std::vector<Position> &GetLanePath(int lane) const { return mLanes[lane]; } // side 0 base to side 1 base
+
+private:
+	int mWidth, mHeight;
+	std::vector<unsigned char> mWalkable;
+	std::vector<Position> mLanes[LANES];
+	Position mBase[2];
+	Position mHeroSpawn[2][5];
+	Position mTurret[2][TURRETS_PER_SIDE];
+	std::vector<int> mMinions; // scratch of Load, reserved for MAX_UNITS
+
+	int LanePenalty(int lane, const Position &pos) const;
+	// 4-connected, cheapest path hugging the lane; from and to included
+	std::vector<Position> FindPath(const Position &from, const Position &to, int lane) const;
+
+	static int Priority(UNIT_TYPE t);
+	int GetDamage(const SIM_STATE &state, const MAP_OBJECT &unit) const;
+	int ChooseTarget(const SIM_STATE &state, const SIM_UNIT &shooter, int range_sq) const;
+	bool EnemyInRange(const SIM_STATE &state, const Position *start, int side, const Position &pos) const;
+	void AddAttack(SIM_STATE &state, const MAP_OBJECT &attacker, const MAP_OBJECT &target) const;
+	void Damage(SIM_STATE &state, const int *damage, bool by_heroes, int *gained) const;
+	void RemoveDead(SIM_STATE &state) const;
+	bool NextStep(const SIM_UNIT &minion, Position &step) const; // false if it stands
+	void MoveMinions(SIM_STATE &state) const; // those that did not shoot
+	void SpawnWave(SIM_STATE &state) const;
+	static uint32_t Random(SIM_STATE &state); // xorshift, state.rng must not be 0
+	static int IndexOf(const SIM_STATE &state, int id); // -1 if not on the map
+	void SetFixedUnit(SIM_UNIT &u, int id) const; // type, side and start of ids 1..24
+	bool OnLane(const Position &pos) const;
+	MAP_OBJECT ToView(const MAP_OBJECT &unit, int side) const;
+};
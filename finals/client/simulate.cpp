@@ -0,0 +1,122 @@
+// Plays whole matches offline on the SIMULATOR: the default client (Hypno)
+// is side 0, the opponent side 1. Both answer the text frames through
+// DebugResponse, exactly as they would answer the server.
+//   moba-sim [options] <map.txt>
+//     -o <opponent>  hypno (default), rush or idle
+//     -n <matches>   matches to play, 1 by default
+//     -s <seed>      seed of the first match, the next ones count up from
+//                    it; 0 (default) plays every match the same way
+//     -l <out.log>   write side 0's frames and answers as a debug.log,
+//                    which moba-replay can play again
+#include "stdafx.h"
+#include "Client.h"
+#include "sim.h"
+#include "bots.h"
+#include "debuglog.h"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+typedef std::chrono::steady_clock CLOCK;
+
+static CLIENT *CreateOpponent(const std::string &name)
+{
+	if (name == "hypno") return CreateClient();
+	return CreateBot(name);
+}
+
+static int Usage(const char *argv0)
+{
+	std::cout << "usage: " << argv0 << " [-o hypno|rush|idle] [-n matches] [-s seed] [-l out.log] <map.txt>" << std::endl;
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout.sync_with_stdio(false);
+	std::string opponent = "hypno";
+	const char *log_file = NULL;
+	int matches = 1;
+	uint32_t seed = 0;
+	std::vector<const char *> positional;
+	for (int i = 1; i<argc; i++)
+	{
+		if (argv[i][0] == '-' && argv[i][1] != 0 && argv[i][2] == 0 && i + 1<argc)
+		{
+			const char *value = argv[++i];
+			switch (argv[i - 1][1])
+			{
+				case 'o': opponent = value; break;
+				case 'n': matches = atoi(value); break;
+				case 'l': log_file = value; break;
+				case 's': seed = (uint32_t)strtoul(value, NULL, 10); break;
+				default: return Usage(argv[0]);
+			}
+		} else
+		{
+			positional.push_back(argv[i]);
+		}
+	}
+	if (positional.size() != 1 || matches<1) return Usage(argv[0]);
+
+	std::vector<std::string> map;
+	if (!LoadLines(positional[0], map))
+	{
+		std::cout << "Error: cannot read " << positional[0] << std::endl;
+		return 1;
+	}
+	std::ofstream log;
+	if (log_file != NULL)
+	{
+		log.open(log_file);
+		if (!log.is_open())
+		{
+			std::cout << "Error: cannot write " << log_file << std::endl;
+			return 1;
+		}
+	}
+	std::unique_ptr<CLIENT> clients[2];
+	clients[0].reset(CreateClient());
+	clients[1].reset(CreateOpponent(opponent));
+	if (!clients[1])
+	{
+		std::cout << "Error: unknown opponent " << opponent << std::endl;
+		return Usage(argv[0]);
+	}
+	for (int side = 0; side<2; side++)
+	{
+		clients[side]->SetTickBudget(0); // the same decisions on any machine
+		clients[side]->mParser.ParseMap(map);
+		clients[side]->UpdateDistCache(false); // both read the same table
+	}
+	SIMULATOR sim;
+	if (!sim.Init(clients[0]->mParser))
+	{
+		std::cout << "Error: the arena of " << positional[0] << " cannot be simulated" << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<SIM_STATE> state(new SIM_STATE);
+	CLIENT *players[2] = { clients[0].get(), clients[1].get() };
+	int wins[3] = { 0, 0, 0 }; // victory, draw, defeat of side 0
+	int64_t ticks = 0;
+	double step_seconds = 0;
+	CLOCK::time_point start = CLOCK::now();
+	for (int match = 1; match<=matches; match++)
+	{
+		sim.Reset(*state, seed == 0 ? 0 : seed + match - 1);
+		sim.Play(*state, players, match, log.is_open() ? &log : NULL, &step_seconds);
+		ticks += state->tick - 1;
+		const MAP_OBJECT &base0 = state->units[10].unit, &base1 = state->units[11].unit;
+		const char *result = state->result == PARSER::VICTORY ? "victory" : state->result == PARSER::DRAW ? "draw" : "defeat";
+		wins[state->result == PARSER::VICTORY ? 0 : state->result == PARSER::DRAW ? 1 : 2]++;
+		std::cout << "match " << match << ": " << result << " at tick " << state->tick - 1 << ", bases "
+			<< base0.hp << " vs " << base1.hp << ", levels " << state->level[0] << " vs " << state->level[1]
+			<< ", " << state->dropped_commands << " commands dropped" << std::endl;
+	}
+	double seconds = std::chrono::duration<double>(CLOCK::now() - start).count();
+	std::cout << "hypno vs " << opponent << ": " << wins[0] << " won, " << wins[1] << " drawn, " << wins[2] << " lost" << std::endl;
+	std::cout << ticks << " ticks in " << seconds << "s, " << ticks/seconds << " ticks/s played, "
+		<< ticks/step_seconds << " ticks/s simulated" << std::endl;
+	return 0;
+}
@@ -0,0 +1,315 @@
+// Self-play tournaments for tuning HypnoParams: many matches on the
+// SIMULATOR at once, one per core, and win rates with 95% confidence
+// intervals per candidate.
+//   moba-tournament <map.txt> <config>
+// The config has one setting per line, '#' starts a comment:
+//   matches 200                 per candidate, half of them on either side
+//   threads 0                   0 uses every core
+//   seed 1                      matches 2k and 2k+1 are played with seed + k
+//   opponent hypno              hypno (default params), rush or idle
+//   set <name> <value>          a HypnoParams value of every candidate
+//   sweep <name> <values...>    candidates: every combination of the swept
+//                               values, next to the params as set
+//   optimize <name> <min> <max> <step>
+//                               coordinate search over these params instead
+//   rounds 3                    passes of the coordinate search
+// Every candidate plays the same seeds, so differences between candidates
+// are not down to luck of the draw.
+#include "stdafx.h"
+#include "Hypno.h"
+#include "sim.h"
+#include "bots.h"
+#include "debuglog.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock CLOCK;
+
+struct TOURNAMENT_CONFIG
+{
+	int matches;
+	int threads;
+	uint32_t seed;
+	std::string opponent;
+	HypnoParams base;
+	std::vector<std::pair<std::string, std::vector<int> > > sweeps;
+	struct RANGE
+	{
+		std::string name;
+		int min, max, step;
+	};
+	std::vector<RANGE> optimize;
+	int rounds;
+	TOURNAMENT_CONFIG() : matches(100), threads(0), seed(1), opponent("hypno"), rounds(3) {}
+};
+
+struct SCORE
+{
+	int wins, draws, losses;
+	SCORE() : wins(0), draws(0), losses(0) {}
+	int Matches() const { return wins + draws + losses; }
+	double Rate() const { return Matches() ? (wins + 0.5*draws) / Matches() : 0; } // draws count half
+	// Wilson score interval of Rate
+	void Interval(double &low, double &high) const
+	{
+		const double z = 1.96;
+		double n = Matches(), p = Rate();
+		if (n == 0)
+		{
+			low = 0;
+			high = 1;
+			return;
+		}
+		double center = (p + z*z/(2*n)) / (1 + z*z/n);
+		double half = z*std::sqrt(p*(1 - p)/n + z*z/(4*n*n)) / (1 + z*z/n);
+		low = center - half;
+		high = center + half;
+	}
+};
+
+// swallows the clients' match banners and latency dumps while playing
+class NULL_BUFFER : public std::streambuf
+{
+protected:
+	virtual int overflow(int c) { return traits_type::not_eof(c); }
+	virtual std::streamsize xsputn(const char *, std::streamsize n) { return n; }
+};
+
+static bool ParseConfig(const std::vector<std::string> &lines, TOURNAMENT_CONFIG &config)
+{
+	for (size_t l = 0; l<lines.size(); l++)
+	{
+		std::string line = lines[l].substr(0, lines[l].find('#'));
+		std::istringstream ss(line);
+		std::string key, name;
+		if (!(ss >> key)) continue;
+		bool ok = true;
+		int value;
+		if (key == "matches") ok = !!(ss >> config.matches) && config.matches>0;
+		else if (key == "threads") ok = !!(ss >> config.threads);
+		else if (key == "seed") ok = !!(ss >> config.seed);
+		else if (key == "opponent") ok = !!(ss >> config.opponent);
+		else if (key == "rounds") ok = !!(ss >> config.rounds);
+		else if (key == "set") ok = (ss >> name >> value) && config.base.Set(name, value);
+		else if (key == "sweep")
+		{
+			std::vector<int> values;
+			ok = (ss >> name) && config.base.Get(name, value);
+			while (ok && ss >> value) values.push_back(value);
+			ok = ok && !values.empty();
+			if (ok) config.sweeps.push_back(std::make_pair(name, values));
+		} else if (key == "optimize")
+		{
+			TOURNAMENT_CONFIG::RANGE range;
+			ok = (ss >> range.name >> range.min >> range.max >> range.step) && config.base.Get(range.name, value) &&
+				range.step>0 && range.min<=range.max;
+			if (ok) config.optimize.push_back(range);
+		} else ok = false;
+		if (!ok)
+		{
+			std::cout << "Error: config line " << l + 1 << ": " << lines[l] << std::endl;
+			return false;
+		}
+	}
+	std::unique_ptr<CLIENT> bot(CreateBot(config.opponent));
+	if (config.opponent != "hypno" && !bot)
+	{
+		std::cout << "Error: unknown opponent " << config.opponent << std::endl;
+		return false;
+	}
+	return true;
+}
+
+class TOURNAMENT
+{
+public:
+	TOURNAMENT(const SIMULATOR &sim, const std::vector<std::string> &map, const TOURNAMENT_CONFIG &config) :
+		mSim(sim), mMap(map), mConfig(config), mMatchesPlayed(0) {}
+
+	// every candidate plays config.matches; results in candidate order
+	std::vector<SCORE> Evaluate(const std::vector<HypnoParams> &candidates)
+	{
+		mCandidates = &candidates;
+		mScores.assign(candidates.size(), SCORE());
+		mNextJob = 0;
+		int threads = mConfig.threads>0 ? mConfig.threads : std::max(1u, std::thread::hardware_concurrency());
+		NULL_BUFFER discard;
+		std::streambuf *saved = std::cout.rdbuf(&discard);
+		std::vector<std::thread> workers;
+		for (int t = 0; t<threads; t++)
+		{
+			workers.push_back(std::thread(&TOURNAMENT::Work, this));
+		}
+		for (size_t t = 0; t<workers.size(); t++)
+		{
+			workers[t].join();
+		}
+		std::cout.rdbuf(saved);
+		return mScores;
+	}
+
+	int64_t GetMatchesPlayed() const { return mMatchesPlayed; }
+
+private:
+	const SIMULATOR &mSim;
+	const std::vector<std::string> &mMap;
+	const TOURNAMENT_CONFIG &mConfig;
+	const std::vector<HypnoParams> *mCandidates;
+	std::vector<SCORE> mScores;
+	std::mutex mScoreMutex;
+	std::atomic<int> mNextJob;
+	std::atomic<int64_t> mMatchesPlayed;
+
+	CLIENT *CreatePlayer(CLIENT *client) const
+	{
+		client->SetTickBudget(0); // the same decisions however loaded the cores are
+		client->mParser.ParseMap(mMap);
+		client->UpdateDistCache(false); // the table main shared, never a copy
+		return client;
+	}
+
+	void Work()
+	{
+		std::unique_ptr<SIM_STATE> state(new SIM_STATE);
+		const int jobs = (int)mCandidates->size()*mConfig.matches;
+		for (int job = mNextJob++; job<jobs; job = mNextJob++)
+		{
+			int candidate = job / mConfig.matches, match = job % mConfig.matches;
+			int side = match % 2; // of the candidate
+			std::unique_ptr<CLIENT> clients[2];
+			clients[side].reset(CreatePlayer(new Hypno("test", (*mCandidates)[candidate])));
+			clients[1 - side].reset(CreatePlayer(mConfig.opponent == "hypno" ? new Hypno() : CreateBot(mConfig.opponent)));
+			CLIENT *players[2] = { clients[0].get(), clients[1].get() };
+			mSim.Reset(*state, mConfig.seed + match/2);
+			PARSER::MATCH_RESULT result = mSim.Play(*state, players, job + 1);
+			if (side == 1 && result != PARSER::DRAW) result = result == PARSER::VICTORY ? PARSER::DEFEAT : PARSER::VICTORY;
+			std::lock_guard<std::mutex> lock(mScoreMutex);
+			SCORE &score = mScores[candidate];
+			if (result == PARSER::VICTORY) score.wins++;
+			else if (result == PARSER::DRAW) score.draws++;
+			else score.losses++;
+			mMatchesPlayed++;
+		}
+	}
+};
+
+static void PrintScore(const std::string &name, const SCORE &score)
+{
+	double low, high;
+	score.Interval(low, high);
+	std::cout << name << ": " << score.Matches() << " matches, " << score.wins << "/" << score.draws << "/"
+		<< score.losses << " won/drawn/lost, score " << score.Rate() << " [" << low << ", " << high << "]" << std::endl;
+}
+
+static void Sweep(TOURNAMENT &tournament, const TOURNAMENT_CONFIG &config)
+{
+	// the params as set, then every combination of the swept values
+	std::vector<HypnoParams> combinations(1, config.base);
+	for (size_t s = 0; s<config.sweeps.size(); s++)
+	{
+		std::vector<HypnoParams> next;
+		for (size_t c = 0; c<combinations.size(); c++)
+		{
+			for (size_t v = 0; v<config.sweeps[s].second.size(); v++)
+			{
+				next.push_back(combinations[c]);
+				next.back().Set(config.sweeps[s].first, config.sweeps[s].second[v]);
+			}
+		}
+		combinations.swap(next);
+	}
+	std::vector<HypnoParams> candidates(1, config.base);
+	for (size_t c = 0; c<combinations.size(); c++)
+	{
+		// a combination that is the params as set is played once
+		if (combinations[c].ToString() != config.base.ToString()) candidates.push_back(combinations[c]);
+	}
+	std::vector<SCORE> scores = tournament.Evaluate(candidates);
+	std::vector<int> order;
+	for (size_t c = 0; c<candidates.size(); c++) order.push_back((int)c);
+	std::stable_sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a].Rate()>scores[b].Rate(); });
+	for (size_t i = 0; i<order.size(); i++)
+	{
+		PrintScore(candidates[order[i]].ToString() + (order[i] == 0 ? " (as set)" : ""), scores[order[i]]);
+	}
+}
+
+static void Optimize(TOURNAMENT &tournament, const TOURNAMENT_CONFIG &config)
+{
+	HypnoParams current = config.base;
+	SCORE current_score = tournament.Evaluate(std::vector<HypnoParams>(1, current))[0];
+	PrintScore("start " + current.ToString(), current_score);
+	for (int round = 0; round<config.rounds; round++)
+	{
+		bool improved = false;
+		for (size_t r = 0; r<config.optimize.size(); r++)
+		{
+			const TOURNAMENT_CONFIG::RANGE &range = config.optimize[r];
+			int value;
+			current.Get(range.name, value);
+			std::vector<HypnoParams> candidates;
+			for (int v = value - range.step; v<=value + range.step; v += 2*range.step)
+			{
+				if (v<range.min || v>range.max) continue;
+				candidates.push_back(current);
+				candidates.back().Set(range.name, v);
+			}
+			if (candidates.empty()) continue;
+			std::vector<SCORE> scores = tournament.Evaluate(candidates);
+			size_t best = 0;
+			for (size_t c = 1; c<scores.size(); c++)
+			{
+				if (scores[c].Rate()>scores[best].Rate()) best = c;
+			}
+			if (scores[best].Rate()<=current_score.Rate()) continue;
+			current = candidates[best];
+			current_score = scores[best];
+			improved = true;
+			PrintScore("round " + std::to_string(round + 1) + " " + current.ToString(), current_score);
+		}
+		if (!improved) break;
+	}
+	PrintScore("best " + current.ToString(), current_score);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: " << argv[0] << " <map.txt> <config>" << std::endl;
+		return 1;
+	}
+	std::vector<std::string> map, config_lines;
+	if (!LoadLines(argv[1], map) || !LoadLines(argv[2], config_lines))
+	{
+		std::cout << "Error: cannot read " << argv[1] << " or " << argv[2] << std::endl;
+		return 1;
+	}
+	TOURNAMENT_CONFIG config;
+	if (!ParseConfig(config_lines, config)) return 1;
+
+	PARSER parser;
+	parser.ParseMap(map);
+	SIMULATOR sim;
+	if (!sim.Init(parser))
+	{
+		std::cout << "Error: the arena of " << argv[1] << " cannot be simulated" << std::endl;
+		return 1;
+	}
+	// every player reads this one table, load or build it up front
+	DISTCACHE::GetShared(parser, "distcache.bin", true);
+
+	TOURNAMENT tournament(sim, map, config);
+	CLOCK::time_point start = CLOCK::now();
+	if (config.optimize.empty()) Sweep(tournament, config);
+	else Optimize(tournament, config);
+	double seconds = std::chrono::duration<double>(CLOCK::now() - start).count();
+	std::cout << tournament.GetMatchesPlayed() << " matches in " << seconds << "s, "
+		<< tournament.GetMatchesPlayed()/seconds << " matches/s" << std::endl;
+	return 0;
+}